@@ -0,0 +1,218 @@
+#include "../src/bridge/counting_pool.h"
+#include "../src/bridge/statement.h"
+#include "../src/bridge/statement_batch_reader.h"
+#include "arrow/builder.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures how many cells per second statement_batch_reader converts from SQLite
+// into Arrow, and how often it goes to the allocator per batch. "legacy" is the
+// previous per-cell type switch with fresh builders for every batch, kept here
+// only as a baseline; "appender" is the current reader.
+
+constexpr int kRows = 200000;
+constexpr int kColumns = 8;
+constexpr int kRuns = 5;
+constexpr int32_t kLegacyBatchSize = 16384;
+
+using arrow_sql_bridge::counting_pool;
+
+struct scan_result {
+  int64_t cells = 0;
+  int64_t batches = 0;
+};
+
+arrow::Status legacy_append(arrow::ArrayBuilder* builder, const arrow::DataType& type, sqlite3_stmt* stmt, int col) {
+  if (sqlite3_column_type(stmt, col) == SQLITE_NULL) {
+    return builder->AppendNull();
+  }
+
+  switch (type.id()) {
+  case arrow::Type::INT64:
+    return static_cast<arrow::Int64Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::UINT64:
+    return static_cast<arrow::UInt64Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::INT32:
+    return static_cast<arrow::Int32Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::UINT32:
+    return static_cast<arrow::UInt32Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::INT16:
+    return static_cast<arrow::Int16Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::UINT16:
+    return static_cast<arrow::UInt16Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::INT8:
+    return static_cast<arrow::Int8Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::UINT8:
+    return static_cast<arrow::UInt8Builder*>(builder)->Append(sqlite3_column_int64(stmt, col));
+  case arrow::Type::DOUBLE:
+    return static_cast<arrow::DoubleBuilder*>(builder)->Append(sqlite3_column_double(stmt, col));
+  case arrow::Type::FLOAT:
+    return static_cast<arrow::FloatBuilder*>(builder)->Append(sqlite3_column_double(stmt, col));
+  case arrow::Type::BINARY: {
+    auto blob = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+    return static_cast<arrow::BinaryBuilder*>(builder)->Append(blob, sqlite3_column_bytes(stmt, col));
+  }
+  case arrow::Type::STRING: {
+    auto text = reinterpret_cast<const uint8_t*>(sqlite3_column_text(stmt, col));
+    return static_cast<arrow::StringBuilder*>(builder)->Append(text, sqlite3_column_bytes(stmt, col));
+  }
+  default:
+    return arrow::Status::NotImplemented("Not implemented SQLite data conversion to ", type.name());
+  }
+}
+
+arrow::Result<scan_result> legacy_scan(
+    const std::shared_ptr<arrow_sql_bridge::statement>& statement,
+    const std::shared_ptr<counting_pool>& pool
+) {
+  ARROW_ASSIGN_OR_RAISE(auto schema, statement->get_schema());
+  sqlite3_stmt* stmt = statement->get_sqlite3_statement();
+  ARROW_RETURN_NOT_OK(statement->reset());
+  ARROW_ASSIGN_OR_RAISE(int rc, statement->step());
+
+  scan_result result;
+  while (rc == SQLITE_ROW) {
+    std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders(schema->num_fields());
+    for (int i = 0; i < schema->num_fields(); i++) {
+      ARROW_RETURN_NOT_OK(MakeBuilder(pool.get(), schema->field(i)->type(), &builders[i]));
+    }
+
+    int64_t rows = 0;
+    while (rows < kLegacyBatchSize && rc == SQLITE_ROW) {
+      rows++;
+      for (int i = 0; i < schema->num_fields(); i++) {
+        ARROW_RETURN_NOT_OK(legacy_append(builders[i].get(), *schema->field(i)->type(), stmt, i));
+      }
+      ARROW_ASSIGN_OR_RAISE(rc, statement->step());
+    }
+
+    for (auto& builder : builders) {
+      std::shared_ptr<arrow::Array> array;
+      ARROW_RETURN_NOT_OK(builder->Finish(&array));
+    }
+    result.cells += rows * schema->num_fields();
+    result.batches++;
+  }
+  return result;
+}
+
+arrow::Result<scan_result> appender_scan(
+    const std::shared_ptr<arrow_sql_bridge::statement>& statement,
+    const std::shared_ptr<counting_pool>& pool
+) {
+  ARROW_ASSIGN_OR_RAISE(
+      auto reader,
+      arrow_sql_bridge::statement_batch_reader::make(statement, arrow_sql_bridge::batch_limits(), pool)
+  );
+
+  scan_result result;
+  std::shared_ptr<arrow::RecordBatch> batch;
+  while (true) {
+    ARROW_RETURN_NOT_OK(reader->ReadNext(&batch));
+    if (batch == nullptr) {
+      break;
+    }
+    result.cells += batch->num_rows() * batch->num_columns();
+    result.batches++;
+  }
+  return result;
+}
+
+arrow::Status populate(
+    arrow_sql_bridge::connection& conn,
+    const std::string& table,
+    const std::string& column_type,
+    const std::string& value
+) {
+  std::string columns, values;
+  for (int i = 0; i < kColumns; i++) {
+    columns += (i ? ", c" : "c") + std::to_string(i) + " " + column_type;
+    values += (i ? ", " : "") + value;
+  }
+
+  ARROW_RETURN_NOT_OK(conn.exec("create table " + table + " (" + columns + ");"));
+  ARROW_RETURN_NOT_OK(conn.exec("begin;"));
+  ARROW_RETURN_NOT_OK(conn.exec(
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < " + std::to_string(kRows) +
+          ") insert into " + table + " select " + values + " from seq;"
+  ));
+  return conn.exec("commit;");
+}
+
+struct measurement {
+  double cells_per_second = 0;
+  double allocations_per_batch = 0;
+  double grows_per_batch = 0;
+  double shrinks_per_batch = 0;
+};
+
+using scan_function = std::function<arrow::Result<scan_result>(
+    const std::shared_ptr<arrow_sql_bridge::statement>&,
+    const std::shared_ptr<counting_pool>&
+)>;
+
+arrow::Result<measurement> measure(
+    const std::shared_ptr<arrow_sql_bridge::connection>& conn,
+    const std::string& table,
+    const scan_function& scan
+) {
+  ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(conn, "select * from " + table + ";"));
+
+  measurement best;
+  for (int run = 0; run < kRuns; run++) {
+    auto pool = std::make_shared<counting_pool>();
+    auto start = std::chrono::steady_clock::now();
+    ARROW_ASSIGN_OR_RAISE(scan_result result, scan(statement, pool));
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best.cells_per_second = std::max(best.cells_per_second, static_cast<double>(result.cells) / elapsed.count());
+    // Every run allocates the same
+    const auto batches = static_cast<double>(std::max<int64_t>(result.batches, 1));
+    best.allocations_per_batch = static_cast<double>(pool->allocations) / batches;
+    best.grows_per_batch = static_cast<double>(pool->grows) / batches;
+    best.shrinks_per_batch = static_cast<double>(pool->shrinks) / batches;
+  }
+  return best;
+}
+
+arrow::Status run() {
+  ARROW_ASSIGN_OR_RAISE(
+      std::shared_ptr<arrow_sql_bridge::connection> conn,
+      arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)
+  );
+
+  const std::vector<std::pair<std::string, std::pair<std::string, std::string>>> tables{
+      {"int_table", {"int", "x * 7"}},
+      {"double_table", {"real", "x * 0.5"}},
+      {"text_table", {"text", "printf('row-%08d', x)"}},
+      {"blob_table", {"blob", "randomblob(24)"}},
+  };
+
+  std::cout << "rows=" << kRows << " columns=" << kColumns << " runs=" << kRuns << " (best run reported)\n";
+  for (const auto& [table, spec] : tables) {
+    ARROW_RETURN_NOT_OK(populate(*conn, table, spec.first, spec.second));
+    ARROW_ASSIGN_OR_RAISE(auto legacy, measure(conn, table, legacy_scan));
+    ARROW_ASSIGN_OR_RAISE(auto appender, measure(conn, table, appender_scan));
+
+    std::cout << table << ": legacy " << legacy.cells_per_second / 1e6 << " Mcells/s, appender "
+              << appender.cells_per_second / 1e6 << " Mcells/s, speedup x"
+              << appender.cells_per_second / legacy.cells_per_second << std::endl;
+    for (const auto& [name, result] : {std::pair{"legacy", legacy}, std::pair{"appender", appender}}) {
+      std::cout << "  " << name << " per batch: " << result.allocations_per_batch << " allocations, "
+                << result.grows_per_batch << " grows, " << result.shrinks_per_batch << " shrinks" << std::endl;
+    }
+  }
+  return arrow::Status::OK();
+}
+
+int main() {
+  auto status = run();
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.ToString() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include "../src/client/client.h"
+#include "../src/server/server.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+// Small-query throughput of a single client, dialing a new channel per query versus
+// reusing the pooled one.
+
+namespace fs = std::filesystem;
+namespace flight = arrow::flight;
+
+constexpr int kPort = 31420;
+constexpr int kQueries = 2000;
+const std::string kHostname = "localhost";
+const std::string kQuery = "select id, name from items where id = 7;";
+
+template <typename PoolFactory>
+arrow::Result<double> measure_qps(const flight::Location& location, PoolFactory&& pool_for_query) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kQueries; i++) {
+    ARROW_ASSIGN_OR_RAISE(auto pool, pool_for_query());
+    ARROW_ASSIGN_OR_RAISE(auto table, execute_sql_query(pool, location, kQuery));
+    if (table->num_rows() != 1) {
+      return arrow::Status::ExecutionError("Unexpected result of ", table->num_rows(), " rows");
+    }
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return kQueries / elapsed.count();
+}
+
+arrow::Status run(fs::path db_path) {
+  ARROW_ASSIGN_OR_RAISE(auto server, create_server(db_path, kHostname, kPort));
+  std::thread server_thread([&] { ARROW_UNUSED(server->Serve()); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  auto status = [&]() -> arrow::Status {
+    ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(kHostname, kPort));
+    ARROW_ASSIGN_OR_RAISE(auto setup_pool, client_pool::make());
+    ARROW_RETURN_NOT_OK(execute_sql_query(setup_pool, location, "create table items (id int, name text);").status());
+    ARROW_RETURN_NOT_OK(
+        execute_sql_query(
+            setup_pool,
+            location,
+            "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 100) "
+            "insert into items select x, 'item ' || x from seq;"
+        )
+            .status()
+    );
+
+    // A fresh pool per query is exactly the old connect-per-query path
+    ARROW_ASSIGN_OR_RAISE(auto connect_qps, measure_qps(location, [] { return client_pool::make(); }));
+    std::cout << "connect per query: " << connect_qps << " queries/s" << std::endl;
+
+    ARROW_ASSIGN_OR_RAISE(auto pool, client_pool::make());
+    ARROW_ASSIGN_OR_RAISE(
+        auto pooled_qps,
+        measure_qps(location, [&pool]() -> arrow::Result<std::shared_ptr<client_pool>> { return pool; })
+    );
+    std::cout << "pooled client: " << pooled_qps << " queries/s, x" << pooled_qps / connect_qps << std::endl;
+    return arrow::Status::OK();
+  }();
+
+  ARROW_RETURN_NOT_OK(server->Shutdown());
+  server_thread.join();
+  return status;
+}
+
+int main() {
+  const fs::path db_path = "client-pool-bench.db";
+  auto status = run(db_path);
+
+  std::remove(db_path.c_str());
+  std::remove((db_path.string() + "-wal").c_str());
+  std::remove((db_path.string() + "-shm").c_str());
+
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.ToString() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include "../src/bridge/connection.h"
+#include "../src/server/server.h"
+#include "arrow/flight/sql/client.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Read throughput of a single node as the number of concurrent clients grows,
+// once with a single pooled connection and once with one connection per core.
+
+namespace fs = std::filesystem;
+namespace flight = arrow::flight;
+
+constexpr int kRows = 200000;
+constexpr int kBasePort = 31400;
+constexpr std::chrono::seconds kDuration{2};
+const std::string kHostname = "localhost";
+const std::string kQuery = "select sum(v) from items where id % 7 = 3;";
+
+arrow::Status populate(const fs::path& db_path) {
+  ARROW_ASSIGN_OR_RAISE(
+      auto conn,
+      arrow_sql_bridge::connection::make(db_path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)
+  );
+  ARROW_RETURN_NOT_OK(conn->exec("create table items (id int, v int);"));
+  return conn->exec(
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < " + std::to_string(kRows) +
+      ") insert into items select x, x * 3 from seq;"
+  );
+}
+
+arrow::Status run_query(flight::sql::FlightSqlClient& client) {
+  flight::FlightCallOptions call_options;
+  ARROW_ASSIGN_OR_RAISE(auto info, client.Execute(call_options, kQuery));
+  for (const auto& endpoint : info->endpoints()) {
+    ARROW_ASSIGN_OR_RAISE(auto stream, client.DoGet(call_options, endpoint.ticket));
+    ARROW_RETURN_NOT_OK(stream->ToTable().status());
+  }
+  return arrow::Status::OK();
+}
+
+arrow::Result<double> measure_qps(int port, int threads) {
+  ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(kHostname, port));
+
+  std::vector<std::unique_ptr<flight::sql::FlightSqlClient>> clients;
+  for (int i = 0; i < threads; i++) {
+    ARROW_ASSIGN_OR_RAISE(auto client, flight::FlightClient::Connect(location));
+    clients.push_back(std::make_unique<flight::sql::FlightSqlClient>(std::move(client)));
+  }
+
+  std::atomic<bool> stop(false);
+  std::atomic<int64_t> queries(0);
+  std::atomic<int64_t> failures(0);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back([&, i] {
+      while (!stop.load()) {
+        if (run_query(*clients[i]).ok()) {
+          queries++;
+        } else {
+          failures++;
+        }
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(kDuration);
+  stop.store(true);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  if (failures.load() > 0) {
+    return arrow::Status::ExecutionError(failures.load(), " queries failed");
+  }
+  return static_cast<double>(queries.load()) / std::chrono::duration<double>(kDuration).count();
+}
+
+arrow::Status run_with_pool(fs::path db_path, size_t pool_size, int port, int max_threads) {
+  arrow_sql_bridge::server_options options;
+  options.pool_size = pool_size;
+  ARROW_ASSIGN_OR_RAISE(auto server, create_server(db_path, kHostname, port, options));
+
+  std::thread server_thread([&] { ARROW_UNUSED(server->Serve()); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  arrow::Status status;
+  double single_thread_qps = 0;
+  for (int threads = 1; threads <= max_threads && status.ok(); threads *= 2) {
+    auto qps = measure_qps(port, threads);
+    if (!qps.ok()) {
+      status = qps.status();
+      break;
+    }
+    if (threads == 1) {
+      single_thread_qps = *qps;
+    }
+    std::cout << "pool=" << pool_size << " threads=" << threads << ": " << *qps << " queries/s, scaling x"
+              << *qps / single_thread_qps << std::endl;
+  }
+
+  ARROW_RETURN_NOT_OK(server->Shutdown());
+  server_thread.join();
+  return status;
+}
+
+int main() {
+  const fs::path db_path = "concurrency-bench.db";
+  const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+  auto status = populate(db_path);
+  if (status.ok()) {
+    status = run_with_pool(db_path, 1, kBasePort, cores);
+  }
+  if (status.ok()) {
+    status = run_with_pool(db_path, cores, kBasePort + 1, cores);
+  }
+
+  std::remove(db_path.c_str());
+  std::remove((db_path.string() + "-wal").c_str());
+  std::remove((db_path.string() + "-shm").c_str());
+
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.ToString() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include "../src/server/server.h"
+#include "arrow/builder.h"
+#include "arrow/flight/sql/client.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Bulk ingestion throughput of a narrow two-integer table into an on-disk database,
+// for a few transaction chunk sizes.
+
+namespace fs = std::filesystem;
+namespace flight = arrow::flight;
+
+constexpr int64_t kRows = 1000000;
+constexpr int64_t kBatchRows = 65536;
+constexpr int kBasePort = 31410;
+const std::string kHostname = "localhost";
+
+arrow::Result<std::vector<std::shared_ptr<arrow::RecordBatch>>> make_batches() {
+  auto schema = arrow::schema({arrow::field("id", arrow::int64()), arrow::field("v", arrow::int64())});
+  std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+  for (int64_t offset = 0; offset < kRows; offset += kBatchRows) {
+    const int64_t rows = std::min(kBatchRows, kRows - offset);
+    arrow::Int64Builder ids;
+    arrow::Int64Builder values;
+    ARROW_RETURN_NOT_OK(ids.Reserve(rows));
+    ARROW_RETURN_NOT_OK(values.Reserve(rows));
+    for (int64_t i = offset; i < offset + rows; i++) {
+      ids.UnsafeAppend(i);
+      values.UnsafeAppend(i * 3);
+    }
+    ARROW_ASSIGN_OR_RAISE(auto id_array, ids.Finish());
+    ARROW_ASSIGN_OR_RAISE(auto value_array, values.Finish());
+    batches.push_back(arrow::RecordBatch::Make(schema, rows, {id_array, value_array}));
+  }
+  return batches;
+}
+
+arrow::Result<double>
+measure_ingest(int port, const std::vector<std::shared_ptr<arrow::RecordBatch>>& batches) {
+  ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(kHostname, port));
+  ARROW_ASSIGN_OR_RAISE(auto flight_client, flight::FlightClient::Connect(location));
+  flight::sql::FlightSqlClient client(std::move(flight_client));
+
+  flight::sql::TableDefinitionOptions table_options;
+  table_options.if_not_exist = flight::sql::TableDefinitionOptionsTableNotExistOption::kCreate;
+  table_options.if_exists = flight::sql::TableDefinitionOptionsTableExistsOption::kReplace;
+  ARROW_ASSIGN_OR_RAISE(auto reader, arrow::RecordBatchReader::Make(batches));
+
+  const auto start = std::chrono::steady_clock::now();
+  ARROW_ASSIGN_OR_RAISE(int64_t rows, client.ExecuteIngest(flight::FlightCallOptions(), reader, table_options, "items"));
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  if (rows != kRows) {
+    return arrow::Status::ExecutionError("Ingested ", rows, " rows instead of ", kRows);
+  }
+  return static_cast<double>(rows) / elapsed.count();
+}
+
+arrow::Status run_with_chunk(
+    fs::path db_path,
+    size_t chunk_rows,
+    int port,
+    const std::vector<std::shared_ptr<arrow::RecordBatch>>& batches
+) {
+  arrow_sql_bridge::server_options options;
+  options.ingest_chunk_rows = chunk_rows;
+  ARROW_ASSIGN_OR_RAISE(auto server, create_server(db_path, kHostname, port, options));
+
+  std::thread server_thread([&] { ARROW_UNUSED(server->Serve()); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  auto rows_per_second = measure_ingest(port, batches);
+  if (rows_per_second.ok()) {
+    std::cout << "chunk=" << chunk_rows << ": " << *rows_per_second << " rows/s" << std::endl;
+  }
+
+  ARROW_RETURN_NOT_OK(server->Shutdown());
+  server_thread.join();
+  return rows_per_second.status();
+}
+
+int main() {
+  const fs::path db_path = "ingest-bench.db";
+
+  auto batches = make_batches();
+  arrow::Status status = batches.status();
+  const std::vector<size_t> chunk_sizes = {1000, 100000, 0};
+  for (size_t i = 0; i < chunk_sizes.size() && status.ok(); i++) {
+    status = run_with_chunk(db_path, chunk_sizes[i], kBasePort + static_cast<int>(i), *batches);
+  }
+
+  std::remove(db_path.c_str());
+  std::remove((db_path.string() + "-wal").c_str());
+  std::remove((db_path.string() + "-shm").c_str());
+
+  if (!status.ok()) {
+    std::cerr << "Error: " << status.ToString() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
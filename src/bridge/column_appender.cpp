@@ -0,0 +1,482 @@
+#include "column_appender.h"
+
+#include "arrow/builder.h"
+#include "arrow/type_traits.h"
+#include "arrow/util/value_parsing.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#define INT_APPENDER_CASE(TYPE_CLASS)                                                                                  \
+  case arrow::TYPE_CLASS##Type::type_id:                                                                               \
+    return make_appender<numeric_appender<arrow::TYPE_CLASS##Type, int_reader>>(type, pool);
+
+#define FLOAT_APPENDER_CASE(TYPE_CLASS)                                                                                \
+  case arrow::TYPE_CLASS##Type::type_id:                                                                               \
+    return make_appender<numeric_appender<arrow::TYPE_CLASS##Type, float_reader>>(type, pool);
+
+#define TEMPORAL_APPENDER_CASE(TYPE_CLASS)                                                                             \
+  case arrow::TYPE_CLASS##Type::type_id:                                                                               \
+    return make_appender<temporal_appender<arrow::TYPE_CLASS##Type>>(type, pool);
+
+#define STRING_APPENDER_CASE(TYPE_CLASS)                                                                               \
+  case arrow::TYPE_CLASS##Type::type_id:                                                                               \
+    return make_appender<binary_appender<arrow::TYPE_CLASS##Type, text_reader>>(type, pool);
+
+#define BINARY_APPENDER_CASE(TYPE_CLASS)                                                                               \
+  case arrow::TYPE_CLASS##Type::type_id:                                                                               \
+    return make_appender<binary_appender<arrow::TYPE_CLASS##Type, blob_reader>>(type, pool);
+
+struct int_reader {
+  static sqlite3_int64 read(sqlite3_stmt* stmt, int col) {
+    return sqlite3_column_int64(stmt, col);
+  }
+};
+
+struct bool_reader {
+  static bool read(sqlite3_stmt* stmt, int col) {
+    return sqlite3_column_int64(stmt, col) != 0;
+  }
+};
+
+struct float_reader {
+  static double read(sqlite3_stmt* stmt, int col) {
+    return sqlite3_column_double(stmt, col);
+  }
+};
+
+struct text_reader {
+  static const uint8_t* read(sqlite3_stmt* stmt, int col) {
+    return reinterpret_cast<const uint8_t*>(sqlite3_column_text(stmt, col));
+  }
+};
+
+struct blob_reader {
+  static const uint8_t* read(sqlite3_stmt* stmt, int col) {
+    return reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+  }
+};
+
+// Fixed-width columns are staged in a plain vector and handed to the builder in a
+// single AppendValues call. The validity bytes are only materialized once the first
+// NULL shows up, so all-valid batches skip the bitmap work entirely.
+template <typename ArrowType, typename Reader>
+class numeric_appender final : public arrow_sql_bridge::column_appender {
+public:
+  using builder_type = typename arrow::TypeTraits<ArrowType>::BuilderType;
+  // Booleans are staged one per byte, the builder packs them into bits
+  using c_type = std::conditional_t<std::is_same_v<ArrowType, arrow::BooleanType>, uint8_t, typename ArrowType::c_type>;
+
+  numeric_appender(const std::shared_ptr<arrow::DataType>& type, arrow::MemoryPool* pool)
+      : builder(type, pool) {}
+
+  arrow::Status reserve(int64_t rows) override {
+    values.reserve(rows);
+    return builder.Reserve(rows);
+  }
+
+  arrow::Status append(sqlite3_stmt* stmt, int col) override {
+    if (sqlite3_column_type(stmt, col) == SQLITE_NULL) {
+      if (validity.empty()) {
+        validity.assign(values.size(), 1);
+      }
+      values.push_back(c_type{});
+      validity.push_back(0);
+      return arrow::Status::OK();
+    }
+
+    const auto value = Reader::read(stmt, col);
+    // Integers narrowed from the declared type must still fit, SQLite does not enforce it
+    if constexpr (std::is_same_v<Reader, int_reader> && sizeof(c_type) < sizeof(sqlite3_int64)) {
+      if (value < std::numeric_limits<c_type>::min() || value > std::numeric_limits<c_type>::max()) {
+        return arrow::Status::Invalid("Value ", value, " does not fit a column of type ", builder.type()->ToString());
+      }
+    }
+    values.push_back(static_cast<c_type>(value));
+    if (!validity.empty()) {
+      validity.push_back(1);
+    }
+    return arrow::Status::OK();
+  }
+
+  int64_t bytes() const override {
+    return static_cast<int64_t>(values.size() * sizeof(c_type));
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Array>> finish() override {
+    const int64_t length = static_cast<int64_t>(values.size());
+    ARROW_RETURN_NOT_OK(builder.AppendValues(values.data(), length, validity.empty() ? nullptr : validity.data()));
+    values.clear();
+    validity.clear();
+
+    std::shared_ptr<arrow::Array> array;
+    ARROW_RETURN_NOT_OK(builder.Finish(&array));
+    return array;
+  }
+
+private:
+  builder_type builder;
+  std::vector<c_type> values;
+  std::vector<uint8_t> validity;
+};
+
+template <typename ArrowType, typename Reader>
+class binary_appender final : public arrow_sql_bridge::column_appender {
+public:
+  using builder_type = typename arrow::TypeTraits<ArrowType>::BuilderType;
+
+  binary_appender(const std::shared_ptr<arrow::DataType>&, arrow::MemoryPool* pool)
+      : builder(pool) {}
+
+  // Value bytes are reserved for the average value of the previous batch, so a steady scan fills
+  // the buffers without growing them, and one whose values widen is behind by a batch at most
+  arrow::Status reserve(int64_t rows) override {
+    ARROW_RETURN_NOT_OK(builder.Reserve(rows));
+    if (last_values > 0) {
+      ARROW_RETURN_NOT_OK(builder.ReserveData(rows * (last_value_bytes / last_values + 1)));
+    }
+    return arrow::Status::OK();
+  }
+
+  arrow::Status append(sqlite3_stmt* stmt, int col) override {
+    const uint8_t* value = Reader::read(stmt, col);
+    if (value == nullptr) {
+      return builder.AppendNull();
+    }
+    const int bytes = sqlite3_column_bytes(stmt, col);
+    return builder.Append(value, bytes);
+  }
+
+  int64_t bytes() const override {
+    return builder.value_data_length() + builder.length() * sizeof(typename builder_type::offset_type);
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Array>> finish() override {
+    last_values = builder.length();
+    last_value_bytes = builder.value_data_length();
+    std::shared_ptr<arrow::Array> array;
+    ARROW_RETURN_NOT_OK(builder.Finish(&array));
+    return array;
+  }
+
+private:
+  builder_type builder;
+  int64_t last_values = 0;
+  int64_t last_value_bytes = 0;
+};
+
+// Dates and times are stored as ISO 8601 text, as unix seconds or as Julian day numbers,
+// whichever the application chose. Every value is converted to microseconds since the epoch
+// first, dates are then cut down to whole days.
+template <typename ArrowType>
+class temporal_appender final : public arrow_sql_bridge::column_appender {
+public:
+  using builder_type = typename arrow::TypeTraits<ArrowType>::BuilderType;
+  using c_type = typename ArrowType::c_type;
+
+  temporal_appender(const std::shared_ptr<arrow::DataType>& type, arrow::MemoryPool* pool)
+      : builder(type, pool)
+      , parser(arrow::TimestampParser::MakeISO8601()) {}
+
+  arrow::Status reserve(int64_t rows) override {
+    values.reserve(rows);
+    return builder.Reserve(rows);
+  }
+
+  arrow::Status append(sqlite3_stmt* stmt, int col) override {
+    int64_t micros = 0;
+    switch (sqlite3_column_type(stmt, col)) {
+    case SQLITE_NULL:
+      if (validity.empty()) {
+        validity.assign(values.size(), 1);
+      }
+      values.push_back(c_type{});
+      validity.push_back(0);
+      return arrow::Status::OK();
+    case SQLITE_INTEGER: {
+      const sqlite3_int64 seconds = sqlite3_column_int64(stmt, col);
+      if (seconds > kMaxSeconds || seconds < -kMaxSeconds) {
+        return arrow::Status::Invalid("Unix time ", seconds, " is out of range for ", builder.type()->ToString());
+      }
+      micros = seconds * kMicrosPerSecond;
+      break;
+    }
+    case SQLITE_FLOAT: {
+      const double seconds = (sqlite3_column_double(stmt, col) - kUnixEpochJulianDay) * kSecondsPerDay;
+      if (!std::isfinite(seconds) || std::abs(seconds) > static_cast<double>(kMaxSeconds)) {
+        return arrow::Status::Invalid("Julian day is out of range for ", builder.type()->ToString());
+      }
+      micros = std::llround(seconds * kMicrosPerSecond);
+      break;
+    }
+    case SQLITE_TEXT: {
+      const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+      const size_t length = sqlite3_column_bytes(stmt, col);
+      if (!(*parser)(text, length, arrow::TimeUnit::MICRO, &micros)) {
+        return arrow::Status::Invalid(
+            "Can't parse '", std::string_view(text, length), "' as ", builder.type()->ToString()
+        );
+      }
+      break;
+    }
+    default:
+      return arrow::Status::Invalid("Can't convert a BLOB to ", builder.type()->ToString());
+    }
+
+    if constexpr (std::is_same_v<ArrowType, arrow::Date32Type>) {
+      constexpr int64_t micros_per_day = kSecondsPerDay * kMicrosPerSecond;
+      // Rounds towards the earlier day, so times before the epoch keep their date
+      values.push_back(static_cast<c_type>(micros / micros_per_day - (micros % micros_per_day < 0 ? 1 : 0)));
+    } else {
+      values.push_back(micros);
+    }
+    if (!validity.empty()) {
+      validity.push_back(1);
+    }
+    return arrow::Status::OK();
+  }
+
+  int64_t bytes() const override {
+    return static_cast<int64_t>(values.size() * sizeof(c_type));
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Array>> finish() override {
+    const int64_t length = static_cast<int64_t>(values.size());
+    ARROW_RETURN_NOT_OK(builder.AppendValues(values.data(), length, validity.empty() ? nullptr : validity.data()));
+    values.clear();
+    validity.clear();
+
+    std::shared_ptr<arrow::Array> array;
+    ARROW_RETURN_NOT_OK(builder.Finish(&array));
+    return array;
+  }
+
+private:
+  static constexpr int64_t kMicrosPerSecond = 1000000;
+  static constexpr int64_t kSecondsPerDay = 86400;
+  static constexpr int64_t kMaxSeconds = std::numeric_limits<int64_t>::max() / kMicrosPerSecond;
+  static constexpr double kUnixEpochJulianDay = 2440587.5;
+
+  builder_type builder;
+  std::shared_ptr<arrow::TimestampParser> parser;
+  std::vector<c_type> values;
+  std::vector<uint8_t> validity;
+};
+
+// Text columns that repeat a few values. The dictionary grows over the whole scan, so the values
+// every batch adds are sent as a delta of the one before (see dictionary_delta_stream) and the
+// indices of earlier batches stay valid.
+class dictionary_appender final : public arrow_sql_bridge::column_appender {
+public:
+  dictionary_appender(const std::shared_ptr<arrow::DataType>&, arrow::MemoryPool* pool)
+      : builder(arrow::utf8(), pool) {}
+
+  arrow::Status reserve(int64_t rows) override {
+    return builder.Reserve(rows);
+  }
+
+  arrow::Status append(sqlite3_stmt* stmt, int col) override {
+    const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+    if (text == nullptr) {
+      return builder.AppendNull();
+    }
+    const int64_t dictionary_length = builder.dictionary_length();
+    const int bytes = sqlite3_column_bytes(stmt, col);
+    ARROW_RETURN_NOT_OK(builder.Append(std::string_view(text, bytes)));
+    if (builder.dictionary_length() > dictionary_length) {
+      dictionary_bytes += bytes + static_cast<int64_t>(sizeof(int32_t));
+    }
+    return arrow::Status::OK();
+  }
+
+  int64_t bytes() const override {
+    return builder.length() * static_cast<int64_t>(sizeof(int32_t)) + dictionary_bytes;
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Array>> finish() override {
+    std::shared_ptr<arrow::Array> array;
+    ARROW_RETURN_NOT_OK(builder.Finish(&array));
+    dictionary_bytes = 0;
+    return array;
+  }
+
+private:
+  arrow::StringDictionary32Builder builder;
+  int64_t dictionary_bytes = 0;
+};
+
+// Untyped expressions (aggregates, arithmetic, ...) are described by a dense union of
+// string, bytes, bigint and double. Each value goes to the child matching its storage
+// class, so a column may legitimately mix kinds from row to row.
+class dense_union_appender final : public arrow_sql_bridge::column_appender {
+public:
+  dense_union_appender(const arrow::UnionType& type, std::unique_ptr<arrow::ArrayBuilder> builder)
+      : builder(static_cast<arrow::DenseUnionBuilder*>(builder.release())) {
+    // Maps SQLite storage classes to union children, -1 when the union has no matching child
+    children.fill(-1);
+    for (int i = 0; i < type.num_fields(); i++) {
+      int storage_class = SQLITE_NULL;
+      switch (type.field(i)->type()->id()) {
+      case arrow::Type::INT64:
+        storage_class = SQLITE_INTEGER;
+        break;
+      case arrow::Type::DOUBLE:
+        storage_class = SQLITE_FLOAT;
+        break;
+      case arrow::Type::STRING:
+        storage_class = SQLITE_TEXT;
+        break;
+      case arrow::Type::BINARY:
+        storage_class = SQLITE_BLOB;
+        break;
+      default:
+        continue;
+      }
+      children[storage_class] = i;
+      type_codes[storage_class] = type.type_codes()[i];
+    }
+  }
+
+  arrow::Status reserve(int64_t rows) override {
+    return builder->Reserve(rows);
+  }
+
+  arrow::Status append(sqlite3_stmt* stmt, int col) override {
+    const int storage_class = sqlite3_column_type(stmt, col);
+    if (storage_class == SQLITE_NULL) {
+      return builder->AppendNull();
+    }
+
+    const int child = children[storage_class];
+    if (child < 0) {
+      return arrow::Status::NotImplemented("Untyped column can't hold SQLite type ", storage_class);
+    }
+    ARROW_RETURN_NOT_OK(builder->Append(type_codes[storage_class]));
+
+    arrow::ArrayBuilder* child_builder = builder->child_builder(child).get();
+    value_bytes += storage_class == SQLITE_INTEGER || storage_class == SQLITE_FLOAT ? sizeof(int64_t)
+                                                                                    : sqlite3_column_bytes(stmt, col);
+    switch (storage_class) {
+    case SQLITE_INTEGER:
+      return static_cast<arrow::Int64Builder*>(child_builder)->Append(sqlite3_column_int64(stmt, col));
+    case SQLITE_FLOAT:
+      return static_cast<arrow::DoubleBuilder*>(child_builder)->Append(sqlite3_column_double(stmt, col));
+    case SQLITE_TEXT:
+      return static_cast<arrow::StringBuilder*>(child_builder)
+          ->Append(sqlite3_column_text(stmt, col), sqlite3_column_bytes(stmt, col));
+    default:
+      return static_cast<arrow::BinaryBuilder*>(child_builder)
+          ->Append(static_cast<const uint8_t*>(sqlite3_column_blob(stmt, col)), sqlite3_column_bytes(stmt, col));
+    }
+  }
+
+  int64_t bytes() const override {
+    // Every row, NULL or not, has a type code and an offset
+    return builder->length() * static_cast<int64_t>(sizeof(int8_t) + sizeof(int32_t)) + value_bytes;
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Array>> finish() override {
+    value_bytes = 0;
+    std::shared_ptr<arrow::Array> array;
+    ARROW_RETURN_NOT_OK(builder->Finish(&array));
+    return array;
+  }
+
+private:
+  static constexpr int kStorageClasses = SQLITE_NULL + 1;
+
+  int64_t value_bytes = 0;
+
+  std::unique_ptr<arrow::DenseUnionBuilder> builder;
+  std::array<int, kStorageClasses> children;
+  std::array<int8_t, kStorageClasses> type_codes{};
+};
+
+// Fallback for types we can describe in the schema but not decode. NULLs are still
+// accepted so that such columns do not fail until an actual value has to be converted.
+class unsupported_appender final : public arrow_sql_bridge::column_appender {
+public:
+  explicit unsupported_appender(std::unique_ptr<arrow::ArrayBuilder> builder)
+      : builder(std::move(builder)) {}
+
+  arrow::Status reserve(int64_t rows) override {
+    return builder->Reserve(rows);
+  }
+
+  arrow::Status append(sqlite3_stmt* stmt, int col) override {
+    if (sqlite3_column_type(stmt, col) == SQLITE_NULL) {
+      return builder->AppendNull();
+    }
+    return arrow::Status::NotImplemented("Not implemented SQLite data conversion to ", builder->type()->name());
+  }
+
+  // Only NULLs get this far
+  int64_t bytes() const override {
+    return 0;
+  }
+
+  arrow::Result<std::shared_ptr<arrow::Array>> finish() override {
+    std::shared_ptr<arrow::Array> array;
+    ARROW_RETURN_NOT_OK(builder->Finish(&array));
+    return array;
+  }
+
+private:
+  std::unique_ptr<arrow::ArrayBuilder> builder;
+};
+
+template <typename AppenderType>
+arrow::Result<std::unique_ptr<arrow_sql_bridge::column_appender>>
+make_appender(const std::shared_ptr<arrow::DataType>& type, arrow::MemoryPool* pool) {
+  try {
+    return std::make_unique<AppenderType>(type, pool);
+  } catch (...) {
+    return arrow::Status::OutOfMemory("Failed to create column_appender, allocation failed");
+  }
+}
+
+namespace arrow_sql_bridge {
+arrow::Result<std::unique_ptr<column_appender>>
+column_appender::make(const std::shared_ptr<arrow::DataType>& type, arrow::MemoryPool* pool) {
+  switch (type->id()) {
+    INT_APPENDER_CASE(Int64)
+    INT_APPENDER_CASE(UInt64)
+    INT_APPENDER_CASE(Int32)
+    INT_APPENDER_CASE(UInt32)
+    INT_APPENDER_CASE(Int16)
+    INT_APPENDER_CASE(UInt16)
+    INT_APPENDER_CASE(Int8)
+    INT_APPENDER_CASE(UInt8)
+    TEMPORAL_APPENDER_CASE(Date32)
+    TEMPORAL_APPENDER_CASE(Timestamp)
+    FLOAT_APPENDER_CASE(Double)
+    FLOAT_APPENDER_CASE(Float)
+    FLOAT_APPENDER_CASE(HalfFloat)
+    BINARY_APPENDER_CASE(Binary)
+    BINARY_APPENDER_CASE(LargeBinary)
+    STRING_APPENDER_CASE(String)
+    STRING_APPENDER_CASE(LargeString)
+  case arrow::Type::BOOL:
+    return make_appender<numeric_appender<arrow::BooleanType, bool_reader>>(type, pool);
+  case arrow::Type::DICTIONARY: {
+    const auto& dictionary = static_cast<const arrow::DictionaryType&>(*type);
+    if (dictionary.index_type()->id() == arrow::Type::INT32 && dictionary.value_type()->id() == arrow::Type::STRING) {
+      return make_appender<dictionary_appender>(type, pool);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+
+  std::unique_ptr<arrow::ArrayBuilder> builder;
+  ARROW_RETURN_NOT_OK(MakeBuilder(pool, type, &builder));
+  if (type->id() == arrow::Type::DENSE_UNION) {
+    return std::make_unique<dense_union_appender>(static_cast<const arrow::UnionType&>(*type), std::move(builder));
+  }
+  return std::make_unique<unsupported_appender>(std::move(builder));
+}
+} // namespace arrow_sql_bridge
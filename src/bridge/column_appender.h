@@ -0,0 +1,33 @@
+#pragma once
+
+#include "arrow/array.h"
+#include "arrow/memory_pool.h"
+#include "arrow/result.h"
+#include "arrow/type.h"
+#include "sqlite3.h"
+
+#include <memory>
+
+namespace arrow_sql_bridge {
+// Converts one result column of a SQLite statement into an Arrow array.
+// The concrete appender is picked once per column from the Arrow type, so the
+// hot loop only pays a single virtual call per cell.
+class column_appender {
+public:
+  virtual ~column_appender() = default;
+
+  static arrow::Result<std::unique_ptr<column_appender>>
+  make(const std::shared_ptr<arrow::DataType>& type, arrow::MemoryPool* pool);
+
+  // Makes room for the rows of the next batch. Every finish() hands the buffers over to the array,
+  // so each batch starts from empty ones.
+  virtual arrow::Status reserve(int64_t rows) = 0;
+
+  virtual arrow::Status append(sqlite3_stmt* stmt, int column) = 0;
+
+  // Size of the values appended since the last finish(), offsets included, validity not
+  virtual int64_t bytes() const = 0;
+
+  virtual arrow::Result<std::shared_ptr<arrow::Array>> finish() = 0;
+};
+} // namespace arrow_sql_bridge
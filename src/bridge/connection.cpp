@@ -0,0 +1,107 @@
+#include "connection.h"
+
+#include "shard_hash.h"
+
+#include <string_view>
+
+// shard_hash(value): placement hash of a shard key, lets nodes select the rows of a hash range
+void shard_hash_function(sqlite3_context* context, int, sqlite3_value** argv) {
+  switch (sqlite3_value_type(argv[0])) {
+  case SQLITE_NULL:
+    sqlite3_result_null(context);
+    return;
+  case SQLITE_INTEGER: {
+    const int64_t value = sqlite3_value_int64(argv[0]);
+    sqlite3_result_int64(context, arrow_sql_bridge::sql_shard_hash(arrow_sql_bridge::shard_hash(value)));
+    return;
+  }
+  default: {
+    // The text of any other value, as SQLite renders it
+    const auto* text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+    const std::string_view value(text, sqlite3_value_bytes(argv[0]));
+    sqlite3_result_int64(context, arrow_sql_bridge::sql_shard_hash(arrow_sql_bridge::shard_hash(value)));
+    return;
+  }
+  }
+}
+
+namespace arrow_sql_bridge {
+arrow::Result<std::unique_ptr<connection>> connection::make(
+    const std::string& path,
+    int flags,
+    size_t statement_cache_size,
+    const type_inference& types
+) {
+  sqlite3* db = nullptr;
+  const char* db_location = path.empty() ? ":memory:" : path.c_str();
+
+  if (sqlite3_open_v2(db_location, &db, flags, nullptr)) {
+    std::string err_msg = "Can't open database: ";
+    if (db != nullptr) {
+      err_msg += sqlite3_errmsg(db);
+      sqlite3_close(db);
+    } else {
+      err_msg += "Unable to start SQLite. Insufficient memory";
+    }
+
+    return arrow::Status::Invalid(err_msg);
+  }
+
+  const int function_flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+  const int rc = sqlite3_create_function_v2(
+      db,
+      "shard_hash",
+      1,
+      function_flags,
+      nullptr,
+      shard_hash_function,
+      nullptr,
+      nullptr,
+      nullptr
+  );
+  if (rc != SQLITE_OK) {
+    std::string err_msg = "Can't register shard_hash: ";
+    err_msg += sqlite3_errmsg(db);
+    sqlite3_close(db);
+    return arrow::Status::Invalid(err_msg);
+  }
+
+  try {
+    return std::unique_ptr<connection>(new connection(db, statement_cache_size, types));
+  } catch (...) {
+    sqlite3_close(db);
+    std::string err_msg("Failed to create connection, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+}
+
+arrow::Status connection::exec(const std::string& sql) {
+  char* err = nullptr;
+  if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+    std::string err_msg = "A SQLite runtime error has occurred: ";
+    err_msg += err != nullptr ? err : sqlite3_errmsg(db);
+    sqlite3_free(err);
+    return arrow::Status::ExecutionError(err_msg);
+  }
+
+  return arrow::Status::OK();
+}
+
+sqlite3* connection::get_sqlite3_db() const {
+  return db;
+}
+
+statement_cache& connection::get_statement_cache() {
+  return cache;
+}
+
+const type_inference& connection::get_type_inference() const {
+  return types;
+}
+
+connection::~connection() noexcept {
+  // Cached statements have to be finalized before the database can be closed
+  cache.clear();
+  sqlite3_close(db);
+}
+} // namespace arrow_sql_bridge
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "arrow/result.h"
+#include "server_options.h"
+#include "sqlite3.h"
+#include "statement_cache.h"
+
+#include <memory>
+#include <string>
+
+namespace arrow_sql_bridge {
+// Owns a single SQLite connection. A connection must only be used by one thread
+// at a time: the pool hands it out exclusively and statements keep it leased
+// for as long as they are alive.
+class connection {
+public:
+  static arrow::Result<std::unique_ptr<connection>> make(
+      const std::string& path,
+      int flags,
+      size_t statement_cache_size = 0,
+      const type_inference& types = type_inference()
+  );
+
+  arrow::Status exec(const std::string& sql);
+
+  sqlite3* get_sqlite3_db() const;
+
+  statement_cache& get_statement_cache();
+
+  // How statements of the connection type their result columns
+  const type_inference& get_type_inference() const;
+
+  ~connection() noexcept;
+
+private:
+  sqlite3* db;
+  statement_cache cache;
+  type_inference types;
+
+  connection(sqlite3* db, size_t statement_cache_size, const type_inference& types)
+      : db(db)
+      , cache(statement_cache_size)
+      , types(types) {}
+};
+} // namespace arrow_sql_bridge
@@ -0,0 +1,103 @@
+#include "connection_pool.h"
+
+namespace arrow_sql_bridge {
+arrow::Result<std::shared_ptr<connection_pool>>
+connection_pool::make(const std::string& path, const server_options& options) {
+  if (options.pool_size == 0) {
+    return arrow::Status::Invalid("Connection pool size must be positive");
+  }
+
+  // Every ":memory:" connection is a separate database, so sharing one is the only option
+  const bool in_memory = path.empty();
+  const size_t pool_size = in_memory ? 1 : options.pool_size;
+  const int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI | SQLITE_OPEN_NOMUTEX;
+
+  std::vector<std::unique_ptr<connection>> connections;
+  for (size_t i = 0; i < pool_size; i++) {
+    ARROW_ASSIGN_OR_RAISE(auto conn, connection::make(path, flags, options.statement_cache_size, options.types));
+    sqlite3_busy_timeout(conn->get_sqlite3_db(), static_cast<int>(options.busy_timeout.count()));
+    if (!in_memory) {
+      ARROW_RETURN_NOT_OK(conn->exec("PRAGMA journal_mode=WAL;"));
+      ARROW_RETURN_NOT_OK(conn->exec("PRAGMA synchronous=NORMAL;"));
+    }
+    connections.push_back(std::move(conn));
+  }
+
+  try {
+    return std::shared_ptr<connection_pool>(new connection_pool(std::move(connections), options.acquire_timeout));
+  } catch (...) {
+    std::string err_msg("Failed to create connection_pool, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+}
+
+arrow::Result<std::shared_ptr<connection>> connection_pool::acquire() {
+  std::unique_lock lock(mutex);
+  while (idle.empty() && reclaimer) {
+    // Dropping a connection releases it, which takes the lock
+    std::function<bool()> reclaim = reclaimer;
+    lock.unlock();
+    const bool reclaimed = reclaim();
+    lock.lock();
+    if (!reclaimed) {
+      break;
+    }
+  }
+  if (!released.wait_for(lock, acquire_timeout, [this] { return !idle.empty(); })) {
+    return arrow::Status::IOError("Timed out waiting for a free SQLite connection");
+  }
+
+  connection* conn = idle.back().release();
+  idle.pop_back();
+  lock.unlock();
+
+  std::weak_ptr<connection_pool> pool = weak_from_this();
+  return std::shared_ptr<connection>(conn, [pool](connection* conn) {
+    if (auto owner = pool.lock()) {
+      owner->release(conn);
+    } else {
+      delete conn;
+    }
+  });
+}
+
+void connection_pool::set_reclaimer(std::function<bool()> reclaimer) {
+  std::lock_guard lock(mutex);
+  this->reclaimer = std::move(reclaimer);
+}
+
+size_t connection_pool::size() const {
+  return pool_size;
+}
+
+statement_cache_stats connection_pool::get_statement_cache_stats() const {
+  statement_cache_stats total;
+  for (connection* conn : connections) {
+    statement_cache_stats stats = conn->get_statement_cache().stats();
+    total.hits += stats.hits;
+    total.misses += stats.misses;
+    total.evictions += stats.evictions;
+  }
+  return total;
+}
+
+connection_pool::connection_pool(
+    std::vector<std::unique_ptr<connection>> connections,
+    std::chrono::milliseconds acquire_timeout
+)
+    : idle(std::move(connections))
+    , pool_size(idle.size())
+    , acquire_timeout(acquire_timeout) {
+  for (const auto& conn : idle) {
+    this->connections.push_back(conn.get());
+  }
+}
+
+void connection_pool::release(connection* conn) {
+  {
+    std::lock_guard lock(mutex);
+    idle.emplace_back(conn);
+  }
+  released.notify_one();
+}
+} // namespace arrow_sql_bridge
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "arrow/result.h"
+#include "connection.h"
+#include "server_options.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace arrow_sql_bridge {
+// Bounded set of SQLite connections opened in multi-thread mode (SQLITE_OPEN_NOMUTEX)
+// with WAL journaling, so concurrent readers do not serialize on a single handle.
+// acquire() hands out a connection exclusively; it returns to the pool when the
+// last shared_ptr to it is dropped.
+class connection_pool : public std::enable_shared_from_this<connection_pool> {
+public:
+  static arrow::Result<std::shared_ptr<connection_pool>> make(const std::string& path, const server_options& options);
+
+  arrow::Result<std::shared_ptr<connection>> acquire();
+
+  // Called by acquire() when no connection is idle, before it starts waiting. It should drop a
+  // connection someone is holding on to without using it and return true, or return false when
+  // there is none. It runs without the pool lock held.
+  void set_reclaimer(std::function<bool()> reclaimer);
+
+  size_t size() const;
+
+  // Sum of the statement cache counters of all connections
+  statement_cache_stats get_statement_cache_stats() const;
+
+private:
+  std::mutex mutex;
+  std::condition_variable released;
+  std::vector<std::unique_ptr<connection>> idle;
+  std::vector<connection*> connections;
+  size_t pool_size;
+  std::chrono::milliseconds acquire_timeout;
+  std::function<bool()> reclaimer;
+
+  connection_pool(std::vector<std::unique_ptr<connection>> connections, std::chrono::milliseconds acquire_timeout);
+
+  void release(connection* conn);
+};
+} // namespace arrow_sql_bridge
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "arrow/memory_pool.h"
+
+#include <cstdint>
+#include <string>
+
+namespace arrow_sql_bridge {
+// Counts what a scan asks of Arrow's default pool, for the benches and the tests
+class counting_pool : public arrow::MemoryPool {
+public:
+  using arrow::MemoryPool::Allocate;
+  using arrow::MemoryPool::Free;
+  using arrow::MemoryPool::Reallocate;
+
+  int64_t allocations = 0;
+  // Growing copies the buffer, shrinking (what builders do when they finish) usually does not
+  int64_t grows = 0;
+  int64_t shrinks = 0;
+
+  arrow::Status Allocate(int64_t size, int64_t alignment, uint8_t** out) override {
+    allocations++;
+    return pool->Allocate(size, alignment, out);
+  }
+
+  arrow::Status Reallocate(int64_t old_size, int64_t new_size, int64_t alignment, uint8_t** ptr) override {
+    (new_size > old_size ? grows : shrinks)++;
+    return pool->Reallocate(old_size, new_size, alignment, ptr);
+  }
+
+  void Free(uint8_t* buffer, int64_t size, int64_t alignment) override {
+    pool->Free(buffer, size, alignment);
+  }
+
+  int64_t bytes_allocated() const override {
+    return pool->bytes_allocated();
+  }
+
+  int64_t total_bytes_allocated() const override {
+    return pool->total_bytes_allocated();
+  }
+
+  int64_t num_allocations() const override {
+    return allocations;
+  }
+
+  std::string backend_name() const override {
+    return pool->backend_name();
+  }
+
+private:
+  arrow::MemoryPool* pool = arrow::default_memory_pool();
+};
+} // namespace arrow_sql_bridge
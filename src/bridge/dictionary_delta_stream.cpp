@@ -0,0 +1,81 @@
+#include "dictionary_delta_stream.h"
+
+#include "arrow/array.h"
+
+#include <string>
+
+namespace arrow_sql_bridge {
+arrow::Result<std::unique_ptr<dictionary_delta_stream>>
+dictionary_delta_stream::make(std::shared_ptr<arrow::RecordBatchReader> reader) {
+  try {
+    return std::unique_ptr<dictionary_delta_stream>(new dictionary_delta_stream(std::move(reader)));
+  } catch (...) {
+    std::string err_msg("Failed to create dictionary_delta_stream, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+}
+
+dictionary_delta_stream::dictionary_delta_stream(std::shared_ptr<arrow::RecordBatchReader> reader)
+    : reader(std::move(reader))
+    , stream_schema(this->reader->schema())
+    , mapper(*stream_schema) {}
+
+std::shared_ptr<arrow::Schema> dictionary_delta_stream::schema() {
+  return stream_schema;
+}
+
+arrow::Result<arrow::flight::FlightPayload> dictionary_delta_stream::GetSchemaPayload() {
+  arrow::flight::FlightPayload payload;
+  ARROW_RETURN_NOT_OK(arrow::ipc::GetSchemaPayload(*stream_schema, options, mapper, &payload.ipc_message));
+  return payload;
+}
+
+arrow::Result<arrow::flight::FlightPayload> dictionary_delta_stream::Next() {
+  if (pending.empty()) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ARROW_RETURN_NOT_OK(reader->ReadNext(&batch));
+    if (batch == nullptr) {
+      // Null IPC metadata ends the stream
+      return arrow::flight::FlightPayload();
+    }
+
+    // Inner dictionaries come before the dictionaries of the columns they are nested in
+    ARROW_ASSIGN_OR_RAISE(auto dictionaries, arrow::ipc::CollectDictionaries(*batch, mapper));
+    for (const auto& [id, dictionary] : dictionaries) {
+      std::shared_ptr<arrow::Array>& sent = this->sent[id];
+      if (dictionary == sent) {
+        continue;
+      }
+      const int64_t sent_length = sent == nullptr ? 0 : sent->length();
+      const bool delta = sent != nullptr && sent_length <= dictionary->length() &&
+                         dictionary->RangeEquals(0, sent_length, 0, *sent);
+      if (delta && sent_length == dictionary->length()) {
+        sent = dictionary;
+        continue;
+      }
+      arrow::flight::FlightPayload payload;
+      ARROW_RETURN_NOT_OK(arrow::ipc::GetDictionaryPayload(
+          id,
+          delta,
+          delta ? dictionary->Slice(sent_length) : dictionary,
+          options,
+          &payload.ipc_message
+      ));
+      pending.push_back(std::move(payload));
+      sent = dictionary;
+    }
+
+    arrow::flight::FlightPayload payload;
+    ARROW_RETURN_NOT_OK(arrow::ipc::GetRecordBatchPayload(*batch, options, &payload.ipc_message));
+    pending.push_back(std::move(payload));
+  }
+
+  auto payload = std::move(pending.front());
+  pending.pop_front();
+  return payload;
+}
+
+arrow::Status dictionary_delta_stream::Close() {
+  return reader->Close();
+}
+} // namespace arrow_sql_bridge
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "arrow/flight/server.h"
+#include "arrow/ipc/dictionary.h"
+#include "arrow/ipc/writer.h"
+#include "arrow/record_batch.h"
+#include "arrow/result.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+namespace arrow_sql_bridge {
+// Sends the batches of a reader as flight::RecordBatchStream does, which only ever sends the
+// dictionaries of the first batch. Here every batch is preceded by the dictionaries it changed:
+// the values added since the last batch as a delta when the sent dictionary is a prefix of the new
+// one, the whole dictionary as a replacement otherwise.
+class dictionary_delta_stream : public arrow::flight::FlightDataStream {
+public:
+  static arrow::Result<std::unique_ptr<dictionary_delta_stream>> make(std::shared_ptr<arrow::RecordBatchReader> reader);
+
+  dictionary_delta_stream(const dictionary_delta_stream&) = delete;
+
+  dictionary_delta_stream& operator=(const dictionary_delta_stream&) = delete;
+
+  std::shared_ptr<arrow::Schema> schema() override;
+
+  arrow::Result<arrow::flight::FlightPayload> GetSchemaPayload() override;
+
+  arrow::Result<arrow::flight::FlightPayload> Next() override;
+
+  arrow::Status Close() override;
+
+private:
+  std::shared_ptr<arrow::RecordBatchReader> reader;
+  std::shared_ptr<arrow::Schema> stream_schema;
+  arrow::ipc::DictionaryFieldMapper mapper;
+  arrow::ipc::IpcWriteOptions options = arrow::ipc::IpcWriteOptions::Defaults();
+  // What the client holds, by dictionary id
+  std::unordered_map<int64_t, std::shared_ptr<arrow::Array>> sent;
+  // The dictionaries and the record batch of the batch read last
+  std::deque<arrow::flight::FlightPayload> pending;
+
+  explicit dictionary_delta_stream(std::shared_ptr<arrow::RecordBatchReader> reader);
+};
+} // namespace arrow_sql_bridge
@@ -1,34 +1,442 @@
 #include "flight_sql_server.h"
 
+#include <algorithm>
+#include <charconv>
+#include <deque>
+
 namespace flight = arrow::flight;
 
+const std::string kBatchMaxRowsHeader = "x-batch-max-rows";
+const std::string kBatchTargetBytesHeader = "x-batch-target-bytes";
+const std::string kTypeNarrowingHeader = "x-type-narrowing";
+
+std::string quote_identifier(const std::string& identifier) {
+  std::string quoted = "\"";
+  for (char c : identifier) {
+    if (c == '"') {
+      quoted.push_back('"');
+    }
+    quoted.push_back(c);
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+// Declared types are picked so that statement::get_schema maps them back to the same Arrow type family
+arrow::Result<std::string> arrow_to_sqlite_type(const arrow::DataType& type) {
+  switch (type.id()) {
+  case arrow::Type::BOOL:
+  case arrow::Type::INT8:
+  case arrow::Type::INT16:
+  case arrow::Type::INT32:
+  case arrow::Type::INT64:
+  case arrow::Type::UINT8:
+  case arrow::Type::UINT16:
+  case arrow::Type::UINT32:
+  case arrow::Type::UINT64:
+    return "INTEGER";
+  case arrow::Type::FLOAT:
+  case arrow::Type::DOUBLE:
+    return "REAL";
+  case arrow::Type::STRING:
+  case arrow::Type::LARGE_STRING:
+    return "TEXT";
+  case arrow::Type::BINARY:
+  case arrow::Type::LARGE_BINARY:
+  case arrow::Type::FIXED_SIZE_BINARY:
+    return "BLOB";
+  default:
+    return arrow::Status::NotImplemented("Can't create a SQLite column of type ", type.ToString());
+  }
+}
+
+arrow::Result<std::string> build_create_table(const std::string& table, const arrow::Schema& schema) {
+  std::string sql = "create table " + table + " (";
+  for (int i = 0; i < schema.num_fields(); i++) {
+    const auto& field = schema.field(i);
+    ARROW_ASSIGN_OR_RAISE(auto column_type, arrow_to_sqlite_type(*field->type()));
+    sql += (i == 0 ? "" : ", ") + quote_identifier(field->name()) + " " + column_type;
+    if (!field->nullable()) {
+      sql += " not null";
+    }
+  }
+  return sql + ");";
+}
+
+std::string build_insert(const std::string& table, const arrow::Schema& schema) {
+  std::string columns;
+  std::string placeholders;
+  for (int i = 0; i < schema.num_fields(); i++) {
+    columns += (i == 0 ? "" : ", ") + quote_identifier(schema.field(i)->name());
+    placeholders += i == 0 ? "?" : ", ?";
+  }
+  return "insert into " + table + " (" + columns + ") values (" + placeholders + ");";
+}
+
+arrow::Result<bool> table_exists(sqlite3* db, const std::string& database, const std::string& table) {
+  const std::string sql = "select 1 from " + quote_identifier(database) + ".sqlite_master where type = 'table' and name = ?;";
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+    return arrow::Status::Invalid("Can't look up table ", table, ": ", sqlite3_errmsg(db));
+  }
+
+  sqlite3_bind_text(stmt, 1, table.c_str(), static_cast<int>(table.size()), SQLITE_STATIC);
+  const int rc = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+    return arrow::Status::ExecutionError("Can't look up table ", table, ": ", sqlite3_errmsg(db));
+  }
+  return rc == SQLITE_ROW;
+}
+
+// Appended rows have to name every column of the existing table, and nothing else
+arrow::Status check_ingest_columns(
+    sqlite3* db,
+    const std::string& database,
+    const std::string& table,
+    const arrow::Schema& schema
+) {
+  const std::string sql = "select name from pragma_table_info(?, ?);";
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr) != SQLITE_OK) {
+    return arrow::Status::Invalid("Can't look up the columns of ", table, ": ", sqlite3_errmsg(db));
+  }
+
+  sqlite3_bind_text(stmt, 1, table.c_str(), static_cast<int>(table.size()), SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, database.c_str(), static_cast<int>(database.size()), SQLITE_STATIC);
+  std::vector<std::string> columns;
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    columns.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+  }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    return arrow::Status::ExecutionError("Can't look up the columns of ", table, ": ", sqlite3_errmsg(db));
+  }
+
+  if (columns.size() != static_cast<size_t>(schema.num_fields())) {
+    return arrow::Status::Invalid(
+        "Table ", table, " has ", columns.size(), " columns, the ingested data has ", schema.num_fields()
+    );
+  }
+  for (const auto& field : schema.fields()) {
+    auto column = std::find_if(columns.begin(), columns.end(), [&](const std::string& name) {
+      return sqlite3_stricmp(name.c_str(), field->name().c_str()) == 0;
+    });
+    if (column == columns.end()) {
+      return arrow::Status::Invalid("Table ", table, " has no column ", field->name());
+    }
+    columns.erase(column);
+  }
+  return arrow::Status::OK();
+}
+
+arrow::Result<int64_t> parse_batch_limit(std::string_view header, std::string_view value) {
+  int64_t limit = 0;
+  auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), limit);
+  if (error != std::errc() || end != value.data() + value.size() || limit <= 0) {
+    return arrow::Status::Invalid("Header ", header, " must be a positive integer, got '", value, "'");
+  }
+  return limit;
+}
+
+arrow::Result<arrow_sql_bridge::type_narrowing> parse_type_narrowing(std::string_view header, std::string_view value) {
+  if (value == "none") {
+    return arrow_sql_bridge::type_narrowing::none;
+  } else if (value == "declared") {
+    return arrow_sql_bridge::type_narrowing::declared;
+  } else if (value == "sampled") {
+    return arrow_sql_bridge::type_narrowing::sampled;
+  }
+  return arrow::Status::Invalid("Header ", header, " must be none, declared or sampled, got '", value, "'");
+}
+
 namespace arrow_sql_bridge {
 class flight_sql_server::impl {
 private:
-  sqlite3* db;
+  // A client-side prepared statement. Only the SQL is kept: every execution leases a
+  // connection and gets the compiled statement back from that connection's cache.
+  struct prepared_statement {
+    std::string sql;
+    std::shared_ptr<arrow::Schema> dataset_schema;
+    std::shared_ptr<arrow::Schema> parameter_schema;
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<arrow::RecordBatch>> parameters;
+  };
+
+  std::shared_ptr<connection_pool> pool;
+  std::shared_ptr<memory_tracker> memory;
+  size_t ingest_chunk_rows;
+  size_t prefetch_depth;
+  batch_limits batch;
+  // A query planned by GetFlightInfo and waiting for the matching DoGet, which runs the statement
+  // GetFlightInfo prepared on the connection it still leases. When the pool runs dry that connection
+  // is taken back, and DoGet prepares the SQL again on whichever connection it gets.
+  struct pending_statement {
+    std::string sql;
+    std::shared_ptr<arrow::Schema> schema;
+
+    std::mutex mutex;
+    std::shared_ptr<statement> prepared;
+  };
+
+  // Pending statements that may still lease a connection, oldest first. The pool's reclaimer
+  // takes the connection of the oldest one, so planning a query never waits for tickets
+  // nobody has redeemed yet.
+  struct parked_statements {
+    std::mutex mutex;
+    std::deque<std::weak_ptr<pending_statement>> queue;
+
+    void park(const std::shared_ptr<pending_statement>& pending) {
+      std::lock_guard lock(mutex);
+      std::erase_if(queue, [](const auto& parked) { return parked.expired(); });
+      queue.push_back(pending);
+    }
+
+    bool reclaim() {
+      while (true) {
+        std::shared_ptr<pending_statement> oldest;
+        {
+          std::lock_guard lock(mutex);
+          if (queue.empty()) {
+            return false;
+          }
+          oldest = queue.front().lock();
+          queue.pop_front();
+        }
+        if (oldest == nullptr) {
+          continue;
+        }
+
+        std::shared_ptr<statement> prepared;
+        {
+          std::lock_guard lock(oldest->mutex);
+          prepared = std::move(oldest->prepared);
+        }
+        if (prepared != nullptr) {
+          // Dropping the statement gives its connection back to the pool
+          return true;
+        }
+      }
+    }
+  };
+
+  std::shared_ptr<prefetch_counters> prefetch = std::make_shared<prefetch_counters>();
+  std::shared_ptr<parked_statements> parked = std::make_shared<parked_statements>();
+  handle_registry<pending_statement> pending_statements;
+  handle_registry<prepared_statement> prepared_statements;
 
-  static arrow::Result<flight::Ticket> make_ticket(const std::string& query) {
-    ARROW_ASSIGN_OR_RAISE(auto ticket_string, flight::sql::CreateStatementQueryTicket(query));
+  static arrow::Result<flight::Ticket> make_ticket(const std::string& handle) {
+    ARROW_ASSIGN_OR_RAISE(auto ticket_string, flight::sql::CreateStatementQueryTicket(handle));
     return flight::Ticket{std::move(ticket_string)};
   }
 
-public:
-  explicit impl(sqlite3* db)
-      : db(db) {}
+  arrow::Result<std::shared_ptr<prepared_statement>> find_prepared_statement(const std::string& handle) {
+    auto prepared = prepared_statements.find(handle);
+    if (prepared == nullptr) {
+      return arrow::Status::Invalid("Unknown or expired prepared statement handle");
+    }
+    return prepared;
+  }
+
+  // The server's batch limits with the overrides the call carries in its headers
+  arrow::Result<batch_limits> limits_for(const flight::ServerCallContext& context) const {
+    batch_limits limits = batch;
+    for (const auto& [header, value] : context.incoming_headers()) {
+      if (header == kBatchMaxRowsHeader) {
+        ARROW_ASSIGN_OR_RAISE(limits.max_rows, parse_batch_limit(header, value));
+      } else if (header == kBatchTargetBytesHeader) {
+        ARROW_ASSIGN_OR_RAISE(limits.target_bytes, parse_batch_limit(header, value));
+      }
+    }
+    return limits;
+  }
+
+  // Callers merging the results of several nodes (the router) cap the narrowing, so that no
+  // node picks its types from a sample of its own rows
+  arrow::Status cap_narrowing(const flight::ServerCallContext& context, statement& statement) const {
+    for (const auto& [header, value] : context.incoming_headers()) {
+      if (header == kTypeNarrowingHeader) {
+        ARROW_ASSIGN_OR_RAISE(auto narrowing, parse_type_narrowing(header, value));
+        statement.cap_type_narrowing(narrowing);
+      }
+    }
+    return arrow::Status::OK();
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightDataStream>>
+  make_stream(std::shared_ptr<statement_batch_reader> reader) {
+    if (prefetch_depth == 0) {
+      return dictionary_delta_stream::make(std::move(reader));
+    }
+    ARROW_ASSIGN_OR_RAISE(auto prefetched, prefetching_reader::make(std::move(reader), prefetch_depth, prefetch));
+    return dictionary_delta_stream::make(std::move(prefetched));
+  }
+
+  static arrow::Result<std::vector<std::shared_ptr<arrow::RecordBatch>>>
+  read_parameters(flight::FlightMessageReader* reader) {
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+    while (true) {
+      ARROW_ASSIGN_OR_RAISE(flight::FlightStreamChunk chunk, reader->Next());
+      if (!chunk.data) {
+        break;
+      }
+      batches.push_back(std::move(chunk.data));
+    }
+    return batches;
+  }
+
+  // Runs a data-modifying statement once, or once per parameter row inside a single
+  // transaction, and returns the number of changed rows.
+  static arrow::Result<int64_t> execute_update(
+      const std::shared_ptr<connection>& conn,
+      const std::shared_ptr<statement>& statement,
+      const std::vector<std::shared_ptr<arrow::RecordBatch>>& parameters
+  ) {
+    sqlite3* db = conn->get_sqlite3_db();
+    sqlite3_stmt* stmt = statement->get_sqlite3_statement();
 
-  ~impl() {
-    sqlite3_close(db);
+    if (parameters.empty()) {
+      ARROW_RETURN_NOT_OK(statement->reset());
+      ARROW_ASSIGN_OR_RAISE(int rc, statement->step());
+      while (rc == SQLITE_ROW) {
+        ARROW_ASSIGN_OR_RAISE(rc, statement->step());
+      }
+      return sqlite3_changes64(db);
+    }
+
+    ARROW_RETURN_NOT_OK(conn->exec("BEGIN;"));
+    auto apply = [&]() -> arrow::Result<int64_t> {
+      int64_t changes = 0;
+      for (const auto& batch : parameters) {
+        ARROW_ASSIGN_OR_RAISE(auto binder, parameter_binder::make(*batch->schema(), stmt));
+        for (int64_t row = 0; row < batch->num_rows(); row++) {
+          ARROW_RETURN_NOT_OK(statement->reset());
+          ARROW_RETURN_NOT_OK(binder.bind(stmt, *batch, row));
+          ARROW_ASSIGN_OR_RAISE(int rc, statement->step());
+          while (rc == SQLITE_ROW) {
+            ARROW_ASSIGN_OR_RAISE(rc, statement->step());
+          }
+          changes += sqlite3_changes64(db);
+        }
+      }
+      ARROW_RETURN_NOT_OK(statement->reset());
+      return changes;
+    };
+
+    auto changes = apply();
+    if (!changes.ok()) {
+      ARROW_UNUSED(statement->reset());
+      ARROW_UNUSED(conn->exec("ROLLBACK;"));
+      return changes.status();
+    }
+    ARROW_RETURN_NOT_OK(conn->exec("COMMIT;"));
+    return changes;
+  }
+
+  // Makes sure the ingestion target exists and has the right shape, following the
+  // table definition options of the request.
+  static arrow::Status prepare_ingest_table(
+      const std::shared_ptr<connection>& conn,
+      const flight::sql::StatementIngest& command,
+      const std::string& database,
+      const arrow::Schema& schema
+  ) {
+    using if_exists = flight::sql::TableDefinitionOptionsTableExistsOption;
+    using if_not_exist = flight::sql::TableDefinitionOptionsTableNotExistOption;
+
+    const std::string table = quote_identifier(database) + "." + quote_identifier(command.table);
+    ARROW_ASSIGN_OR_RAISE(bool exists, table_exists(conn->get_sqlite3_db(), database, command.table));
+    if (exists) {
+      switch (command.table_definition_options.if_exists) {
+      case if_exists::kAppend:
+        return check_ingest_columns(conn->get_sqlite3_db(), database, command.table, schema);
+      case if_exists::kReplace:
+        ARROW_RETURN_NOT_OK(conn->exec("drop table " + table + ";"));
+        break;
+      default:
+        return arrow::Status::AlreadyExists("Table ", command.table, " already exists");
+      }
+    } else if (command.table_definition_options.if_not_exist != if_not_exist::kCreate) {
+      return arrow::Status::Invalid("Table ", command.table, " does not exist");
+    }
+
+    ARROW_ASSIGN_OR_RAISE(auto create_table, build_create_table(table, schema));
+    return conn->exec(create_table);
+  }
+
+  // Inserts every row of the stream, committing each ingest_chunk_rows rows so a huge
+  // upload neither autocommits per row nor holds one unbounded transaction.
+  arrow::Result<int64_t> ingest(
+      const std::shared_ptr<connection>& conn,
+      const flight::sql::StatementIngest& command,
+      const std::string& database,
+      flight::FlightMessageReader* reader
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto schema, reader->GetSchema());
+    ARROW_RETURN_NOT_OK(prepare_ingest_table(conn, command, database, *schema));
+
+    const std::string table = quote_identifier(database) + "." + quote_identifier(command.table);
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(conn, build_insert(table, *schema)));
+    sqlite3_stmt* stmt = statement->get_sqlite3_statement();
+    ARROW_ASSIGN_OR_RAISE(auto binder, parameter_binder::make(*schema, stmt));
+
+    int64_t rows = 0;
+    size_t chunk_rows = 0;
+    while (true) {
+      ARROW_ASSIGN_OR_RAISE(flight::FlightStreamChunk chunk, reader->Next());
+      if (!chunk.data) {
+        break;
+      }
+
+      const arrow::RecordBatch& batch = *chunk.data;
+      for (int64_t row = 0; row < batch.num_rows(); row++) {
+        ARROW_RETURN_NOT_OK(binder.bind(stmt, batch, row));
+        ARROW_ASSIGN_OR_RAISE(int rc, statement->step());
+        if (rc != SQLITE_DONE) {
+          return arrow::Status::ExecutionError("Insert into ", command.table, " returned rows");
+        }
+        ARROW_RETURN_NOT_OK(statement->reset());
+
+        rows++;
+        if (++chunk_rows == ingest_chunk_rows) {
+          ARROW_RETURN_NOT_OK(conn->exec("COMMIT; BEGIN IMMEDIATE;"));
+          chunk_rows = 0;
+        }
+      }
+    }
+    return rows;
+  }
+
+public:
+  impl(std::shared_ptr<connection_pool> pool, std::shared_ptr<memory_tracker> memory, const server_options& options)
+      : pool(std::move(pool))
+      , memory(std::move(memory))
+      , ingest_chunk_rows(options.ingest_chunk_rows)
+      , prefetch_depth(options.prefetch_depth)
+      , batch(options.batch)
+      , pending_statements(options.statement_handle_ttl)
+      , prepared_statements(options.prepared_statement_ttl) {
+    this->pool->set_reclaimer([parked = parked] { return parked->reclaim(); });
   }
 
   arrow::Result<std::unique_ptr<flight::FlightInfo>> GetFlightInfoStatement(
-      const flight::ServerCallContext&,
+      const flight::ServerCallContext& context,
       const flight::sql::StatementQuery& command,
       const flight::FlightDescriptor& descriptor
   ) {
     const std::string& query = command.query;
-    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(db, query));
+    ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(std::move(conn), query));
+    ARROW_RETURN_NOT_OK(cap_narrowing(context, *statement));
     ARROW_ASSIGN_OR_RAISE(auto schema, statement->get_schema());
-    ARROW_ASSIGN_OR_RAISE(auto ticket, make_ticket(query));
+    auto pending = std::make_shared<pending_statement>();
+    pending->sql = query;
+    pending->schema = schema;
+    pending->prepared = std::move(statement);
+    parked->park(pending);
+    ARROW_ASSIGN_OR_RAISE(auto ticket, make_ticket(pending_statements.put(std::move(pending))));
     std::vector<flight::FlightEndpoint> endpoints{flight::FlightEndpoint{std::move(ticket), {}, std::nullopt, ""}};
     const bool ordered = false;
     ARROW_ASSIGN_OR_RAISE(auto result, flight::FlightInfo::Make(*schema, descriptor, endpoints, -1, -1, ordered));
@@ -37,43 +445,203 @@ public:
   }
 
   arrow::Result<std::unique_ptr<flight::FlightDataStream>>
-  DoGetStatement(const flight::ServerCallContext&, const flight::sql::StatementQueryTicket& command) {
-    const std::string& sql = command.statement_handle;
+  DoGetStatement(const flight::ServerCallContext& context, const flight::sql::StatementQueryTicket& command) {
+    std::shared_ptr<pending_statement> pending = pending_statements.take(command.statement_handle);
+    if (pending == nullptr) {
+      return arrow::Status::Invalid("Unknown or expired statement handle");
+    }
 
+    ARROW_ASSIGN_OR_RAISE(auto limits, limits_for(context));
     std::shared_ptr<arrow_sql_bridge::statement> statement;
-    ARROW_ASSIGN_OR_RAISE(statement, arrow_sql_bridge::statement::make(db, sql));
+    {
+      std::lock_guard lock(pending->mutex);
+      statement = std::move(pending->prepared);
+    }
+    if (statement == nullptr) {
+      ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+      ARROW_ASSIGN_OR_RAISE(statement, arrow_sql_bridge::statement::make(std::move(conn), pending->sql));
+      statement->set_schema(pending->schema);
+    }
+    std::shared_ptr<arrow_sql_bridge::statement_batch_reader> reader;
+    ARROW_ASSIGN_OR_RAISE(
+        reader,
+        arrow_sql_bridge::statement_batch_reader::make(statement, limits, memory->open(context.peer()))
+    );
+
+    return make_stream(std::move(reader));
+  }
+
+  // Only prepares the statement: nothing runs and no handle is kept, and the compiled
+  // statement goes back to the connection's cache for the GetFlightInfo that usually follows
+  arrow::Result<std::unique_ptr<flight::SchemaResult>> GetSchemaStatement(
+      const flight::ServerCallContext& context,
+      const flight::sql::StatementQuery& command,
+      const flight::FlightDescriptor&
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(std::move(conn), command.query));
+    ARROW_RETURN_NOT_OK(cap_narrowing(context, *statement));
+    ARROW_ASSIGN_OR_RAISE(auto schema, statement->get_schema());
+    return flight::SchemaResult::Make(*schema);
+  }
+
+  arrow::Result<flight::sql::ActionCreatePreparedStatementResult> CreatePreparedStatement(
+      const flight::ServerCallContext& context,
+      const flight::sql::ActionCreatePreparedStatementRequest& request
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(std::move(conn), request.query));
+    ARROW_RETURN_NOT_OK(cap_narrowing(context, *statement));
+
+    auto prepared = std::make_shared<prepared_statement>();
+    prepared->sql = request.query;
+    ARROW_ASSIGN_OR_RAISE(prepared->dataset_schema, statement->get_schema());
+    prepared->parameter_schema = statement->get_parameter_schema();
+
+    flight::sql::ActionCreatePreparedStatementResult result{
+        prepared->dataset_schema,
+        prepared->parameter_schema,
+        prepared_statements.put(prepared)
+    };
+    return result;
+  }
+
+  arrow::Status
+  ClosePreparedStatement(const flight::ServerCallContext&, const flight::sql::ActionClosePreparedStatementRequest& request) {
+    if (!prepared_statements.erase(request.prepared_statement_handle)) {
+      return arrow::Status::Invalid("Unknown or expired prepared statement handle");
+    }
+    return arrow::Status::OK();
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> GetFlightInfoPreparedStatement(
+      const flight::ServerCallContext&,
+      const flight::sql::PreparedStatementQuery& command,
+      const flight::FlightDescriptor& descriptor
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto prepared, find_prepared_statement(command.prepared_statement_handle));
+
+    // The descriptor already is a CommandPreparedStatementQuery, so it doubles as the ticket
+    std::vector<flight::FlightEndpoint> endpoints{
+        flight::FlightEndpoint{flight::Ticket{descriptor.cmd}, {}, std::nullopt, ""}
+    };
+    const bool ordered = false;
+    ARROW_ASSIGN_OR_RAISE(
+        auto result,
+        flight::FlightInfo::Make(*prepared->dataset_schema, descriptor, endpoints, -1, -1, ordered)
+    );
+
+    return std::make_unique<flight::FlightInfo>(result);
+  }
+
+  arrow::Result<std::unique_ptr<flight::SchemaResult>> GetSchemaPreparedStatement(
+      const flight::ServerCallContext&,
+      const flight::sql::PreparedStatementQuery& command,
+      const flight::FlightDescriptor&
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto prepared, find_prepared_statement(command.prepared_statement_handle));
+    return flight::SchemaResult::Make(*prepared->dataset_schema);
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightDataStream>>
+  DoGetPreparedStatement(const flight::ServerCallContext& context, const flight::sql::PreparedStatementQuery& command) {
+    ARROW_ASSIGN_OR_RAISE(auto prepared, find_prepared_statement(command.prepared_statement_handle));
+    ARROW_ASSIGN_OR_RAISE(auto limits, limits_for(context));
+    std::vector<std::shared_ptr<arrow::RecordBatch>> parameters;
+    {
+      std::lock_guard lock(prepared->mutex);
+      parameters = prepared->parameters;
+    }
+
+    ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(std::move(conn), prepared->sql));
+    statement->set_schema(prepared->dataset_schema);
 
     std::shared_ptr<arrow_sql_bridge::statement_batch_reader> reader;
-    ARROW_ASSIGN_OR_RAISE(reader, arrow_sql_bridge::statement_batch_reader::make(statement));
+    ARROW_ASSIGN_OR_RAISE(
+        reader,
+        arrow_sql_bridge::statement_batch_reader::make(
+            statement,
+            std::move(parameters),
+            limits,
+            memory->open(context.peer())
+        )
+    );
 
-    return std::make_unique<flight::RecordBatchStream>(reader);
+    return make_stream(std::move(reader));
   }
-};
 
-arrow::Result<std::shared_ptr<flight_sql_server>> flight_sql_server::make(const std::string& path) {
-  sqlite3* db = nullptr;
-  char* db_location;
-  bool in_memory = path.empty();
+  arrow::Result<std::string> DoPutPreparedStatementQuery(
+      const flight::ServerCallContext&,
+      const flight::sql::PreparedStatementQuery& command,
+      flight::FlightMessageReader* reader,
+      flight::FlightMetadataWriter*
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto prepared, find_prepared_statement(command.prepared_statement_handle));
+    ARROW_ASSIGN_OR_RAISE(auto parameters, read_parameters(reader));
 
-  if (in_memory) {
-    db_location = (char*) ":memory:";
-  } else {
-    db_location = (char*) path.c_str();
+    std::lock_guard lock(prepared->mutex);
+    prepared->parameters = std::move(parameters);
+    return command.prepared_statement_handle;
   }
 
-  if (sqlite3_open_v2(db_location, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, nullptr)) {
-    std::string err_msg = "Can't open database: ";
-    if (db != nullptr) {
-      err_msg += sqlite3_errmsg(db);
-      sqlite3_close(db);
-    } else {
-      err_msg += "Unable to start SQLite. Insufficient memory";
+  arrow::Result<int64_t> DoPutPreparedStatementUpdate(
+      const flight::ServerCallContext&,
+      const flight::sql::PreparedStatementUpdate& command,
+      flight::FlightMessageReader* reader
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto prepared, find_prepared_statement(command.prepared_statement_handle));
+    ARROW_ASSIGN_OR_RAISE(auto parameters, read_parameters(reader));
+
+    ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(conn, prepared->sql));
+    return execute_update(conn, statement, parameters);
+  }
+
+  arrow::Result<int64_t> DoPutCommandStatementIngest(
+      const flight::ServerCallContext&,
+      const flight::sql::StatementIngest& command,
+      flight::FlightMessageReader* reader
+  ) {
+    if (command.transaction_id.has_value()) {
+      return arrow::Status::NotImplemented("Transactions are not supported");
+    }
+    if (command.catalog.has_value()) {
+      return arrow::Status::NotImplemented("Catalogs are not supported");
+    }
+    // SQLite has no schemas, the closest thing is the name of an attached database
+    const std::string database = command.temporary ? "temp" : command.schema.value_or("main");
+
+    ARROW_ASSIGN_OR_RAISE(auto conn, pool->acquire());
+    ARROW_RETURN_NOT_OK(conn->exec("BEGIN IMMEDIATE;"));
+    auto rows = ingest(conn, command, database, reader);
+    if (!rows.ok()) {
+      // Chunks committed before the failure stay in the table
+      ARROW_UNUSED(conn->exec("ROLLBACK;"));
+      return rows.status();
     }
+    ARROW_RETURN_NOT_OK(conn->exec("COMMIT;"));
+    return rows;
+  }
+
+  statement_cache_stats get_statement_cache_stats() const {
+    return pool->get_statement_cache_stats();
+  }
+
+  prefetch_stats get_prefetch_stats() const {
+    return prefetch->stats();
+  }
 
-    return arrow::Status::Invalid(err_msg);
+  memory_stats get_memory_stats() const {
+    return memory->stats();
   }
+};
 
-  auto impl_ptr = std::make_shared<impl>(db);
+arrow::Result<std::shared_ptr<flight_sql_server>>
+flight_sql_server::make(const std::string& path, const server_options& options) {
+  ARROW_ASSIGN_OR_RAISE(auto pool, connection_pool::make(path, options));
+  ARROW_ASSIGN_OR_RAISE(auto memory, memory_tracker::make(options));
+  auto impl_ptr = std::make_shared<impl>(std::move(pool), std::move(memory), options);
 
   try {
     return std::shared_ptr<flight_sql_server>(new flight_sql_server(std::move(impl_ptr)));
@@ -98,6 +666,88 @@ arrow::Result<std::unique_ptr<flight::FlightDataStream>> flight_sql_server::DoGe
   return impl_ptr->DoGetStatement(context, command);
 }
 
+arrow::Result<std::unique_ptr<flight::SchemaResult>> flight_sql_server::GetSchemaStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::StatementQuery& command,
+    const flight::FlightDescriptor& descriptor
+) {
+  return impl_ptr->GetSchemaStatement(context, command, descriptor);
+}
+
+arrow::Result<flight::sql::ActionCreatePreparedStatementResult> flight_sql_server::CreatePreparedStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::ActionCreatePreparedStatementRequest& request
+) {
+  return impl_ptr->CreatePreparedStatement(context, request);
+}
+
+arrow::Status flight_sql_server::ClosePreparedStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::ActionClosePreparedStatementRequest& request
+) {
+  return impl_ptr->ClosePreparedStatement(context, request);
+}
+
+arrow::Result<std::unique_ptr<flight::FlightInfo>> flight_sql_server::GetFlightInfoPreparedStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::PreparedStatementQuery& command,
+    const flight::FlightDescriptor& descriptor
+) {
+  return impl_ptr->GetFlightInfoPreparedStatement(context, command, descriptor);
+}
+
+arrow::Result<std::unique_ptr<flight::SchemaResult>> flight_sql_server::GetSchemaPreparedStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::PreparedStatementQuery& command,
+    const flight::FlightDescriptor& descriptor
+) {
+  return impl_ptr->GetSchemaPreparedStatement(context, command, descriptor);
+}
+
+arrow::Result<std::unique_ptr<flight::FlightDataStream>> flight_sql_server::DoGetPreparedStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::PreparedStatementQuery& command
+) {
+  return impl_ptr->DoGetPreparedStatement(context, command);
+}
+
+arrow::Result<std::string> flight_sql_server::DoPutPreparedStatementQuery(
+    const flight::ServerCallContext& context,
+    const flight::sql::PreparedStatementQuery& command,
+    flight::FlightMessageReader* reader,
+    flight::FlightMetadataWriter* writer
+) {
+  return impl_ptr->DoPutPreparedStatementQuery(context, command, reader, writer);
+}
+
+arrow::Result<int64_t> flight_sql_server::DoPutPreparedStatementUpdate(
+    const flight::ServerCallContext& context,
+    const flight::sql::PreparedStatementUpdate& command,
+    flight::FlightMessageReader* reader
+) {
+  return impl_ptr->DoPutPreparedStatementUpdate(context, command, reader);
+}
+
+arrow::Result<int64_t> flight_sql_server::DoPutCommandStatementIngest(
+    const flight::ServerCallContext& context,
+    const flight::sql::StatementIngest& command,
+    flight::FlightMessageReader* reader
+) {
+  return impl_ptr->DoPutCommandStatementIngest(context, command, reader);
+}
+
+statement_cache_stats flight_sql_server::get_statement_cache_stats() const {
+  return impl_ptr->get_statement_cache_stats();
+}
+
+prefetch_stats flight_sql_server::get_prefetch_stats() const {
+  return impl_ptr->get_prefetch_stats();
+}
+
+memory_stats flight_sql_server::get_memory_stats() const {
+  return impl_ptr->get_memory_stats();
+}
+
 flight_sql_server::flight_sql_server(std::shared_ptr<impl> impl)
     : impl_ptr(std::move(impl)) {}
 
@@ -2,6 +2,12 @@
 
 #include "arrow/flight/sql/server.h"
 #include "arrow/result.h"
+#include "connection_pool.h"
+#include "dictionary_delta_stream.h"
+#include "handle_registry.h"
+#include "memory_tracker.h"
+#include "prefetching_reader.h"
+#include "server_options.h"
 #include "sqlite3.h"
 #include "statement.h"
 #include "statement_batch_reader.h"
@@ -11,7 +17,8 @@ class flight_sql_server : public arrow::flight::sql::FlightSqlServerBase {
 public:
   ~flight_sql_server() override = default;
 
-  static arrow::Result<std::shared_ptr<flight_sql_server>> make(const std::string& path);
+  static arrow::Result<std::shared_ptr<flight_sql_server>>
+  make(const std::string& path, const server_options& options = server_options());
 
   arrow::Result<std::unique_ptr<arrow::flight::FlightInfo>> GetFlightInfoStatement(
       const arrow::flight::ServerCallContext& context,
@@ -24,6 +31,64 @@ public:
       const arrow::flight::sql::StatementQueryTicket& command
   ) override;
 
+  arrow::Result<std::unique_ptr<arrow::flight::SchemaResult>> GetSchemaStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::StatementQuery& command,
+      const arrow::flight::FlightDescriptor& descriptor
+  ) override;
+
+  arrow::Result<arrow::flight::sql::ActionCreatePreparedStatementResult> CreatePreparedStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::ActionCreatePreparedStatementRequest& request
+  ) override;
+
+  arrow::Status ClosePreparedStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::ActionClosePreparedStatementRequest& request
+  ) override;
+
+  arrow::Result<std::unique_ptr<arrow::flight::FlightInfo>> GetFlightInfoPreparedStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::PreparedStatementQuery& command,
+      const arrow::flight::FlightDescriptor& descriptor
+  ) override;
+
+  arrow::Result<std::unique_ptr<arrow::flight::SchemaResult>> GetSchemaPreparedStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::PreparedStatementQuery& command,
+      const arrow::flight::FlightDescriptor& descriptor
+  ) override;
+
+  arrow::Result<std::unique_ptr<arrow::flight::FlightDataStream>> DoGetPreparedStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::PreparedStatementQuery& command
+  ) override;
+
+  arrow::Result<std::string> DoPutPreparedStatementQuery(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::PreparedStatementQuery& command,
+      arrow::flight::FlightMessageReader* reader,
+      arrow::flight::FlightMetadataWriter* writer
+  ) override;
+
+  arrow::Result<int64_t> DoPutPreparedStatementUpdate(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::PreparedStatementUpdate& command,
+      arrow::flight::FlightMessageReader* reader
+  ) override;
+
+  arrow::Result<int64_t> DoPutCommandStatementIngest(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::StatementIngest& command,
+      arrow::flight::FlightMessageReader* reader
+  ) override;
+
+  statement_cache_stats get_statement_cache_stats() const;
+
+  prefetch_stats get_prefetch_stats() const;
+
+  memory_stats get_memory_stats() const;
+
 private:
   class impl;
   std::shared_ptr<impl> impl_ptr;
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace arrow_sql_bridge {
+// Maps opaque random handles to server-side objects that outlive a single call
+// (prepared statements, pending result sets). Entries expire after `ttl` without
+// being looked up; expired entries are dropped lazily on the next access.
+template <typename T>
+class handle_registry {
+public:
+  explicit handle_registry(std::chrono::milliseconds ttl)
+      : ttl(ttl)
+      , generator(std::random_device{}()) {}
+
+  std::string put(std::shared_ptr<T> value) {
+    std::vector<std::shared_ptr<T>> expired;
+    std::lock_guard lock(mutex);
+    const auto now = clock::now();
+    collect_expired(now, expired);
+
+    std::string handle = next_handle();
+    entries[handle] = entry{std::move(value), now + ttl};
+    expiry_queue.emplace_back(handle, now + ttl);
+    return handle;
+  }
+
+  // Removes the entry: the handle cannot be used again.
+  std::shared_ptr<T> take(const std::string& handle) {
+    std::vector<std::shared_ptr<T>> expired;
+    std::lock_guard lock(mutex);
+    collect_expired(clock::now(), expired);
+
+    auto it = entries.find(handle);
+    if (it == entries.end()) {
+      return nullptr;
+    }
+    auto value = std::move(it->second.value);
+    entries.erase(it);
+    return value;
+  }
+
+  // Keeps the entry and extends its lifetime by another `ttl`.
+  std::shared_ptr<T> find(const std::string& handle) {
+    std::vector<std::shared_ptr<T>> expired;
+    std::lock_guard lock(mutex);
+    const auto now = clock::now();
+    collect_expired(now, expired);
+
+    auto it = entries.find(handle);
+    if (it == entries.end()) {
+      return nullptr;
+    }
+    it->second.expires_at = now + ttl;
+    return it->second.value;
+  }
+
+  bool erase(const std::string& handle) {
+    std::shared_ptr<T> value;
+    std::lock_guard lock(mutex);
+    auto it = entries.find(handle);
+    if (it == entries.end()) {
+      return false;
+    }
+    value = std::move(it->second.value);
+    entries.erase(it);
+    return true;
+  }
+
+  void sweep() {
+    std::vector<std::shared_ptr<T>> expired;
+    std::lock_guard lock(mutex);
+    collect_expired(clock::now(), expired);
+  }
+
+  size_t size() {
+    std::lock_guard lock(mutex);
+    return entries.size();
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct entry {
+    std::shared_ptr<T> value;
+    clock::time_point expires_at;
+  };
+
+  std::mutex mutex;
+  std::unordered_map<std::string, entry> entries;
+  // Handles with the expiry they were queued with; an entry refreshed by find() is re-queued when reached
+  std::deque<std::pair<std::string, clock::time_point>> expiry_queue;
+  std::chrono::milliseconds ttl;
+  std::mt19937_64 generator;
+
+  std::string next_handle() {
+    static constexpr char kHexDigits[] = "0123456789abcdef";
+    std::string handle;
+    do {
+      handle.clear();
+      for (int word = 0; word < 2; word++) {
+        uint64_t bits = generator();
+        for (int i = 0; i < 16; i++, bits >>= 4) {
+          handle.push_back(kHexDigits[bits & 0xF]);
+        }
+      }
+    } while (entries.count(handle) != 0);
+    return handle;
+  }
+
+  // Expired values are moved out so that they are destroyed after the lock is released
+  void collect_expired(clock::time_point now, std::vector<std::shared_ptr<T>>& expired) {
+    while (!expiry_queue.empty()) {
+      auto [handle, queued_expiry] = expiry_queue.front();
+      auto it = entries.find(handle);
+      if (it == entries.end()) {
+        expiry_queue.pop_front();
+        continue;
+      }
+      if (it->second.expires_at != queued_expiry) {
+        expiry_queue.pop_front();
+        expiry_queue.emplace_back(std::move(handle), it->second.expires_at);
+        continue;
+      }
+      if (queued_expiry > now) {
+        break;
+      }
+      expired.push_back(std::move(it->second.value));
+      entries.erase(it);
+      expiry_queue.pop_front();
+    }
+  }
+};
+} // namespace arrow_sql_bridge
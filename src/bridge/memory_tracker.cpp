@@ -0,0 +1,206 @@
+#include "memory_tracker.h"
+
+#include <algorithm>
+
+arrow::Result<arrow::MemoryPool*> backend_pool(const std::string& name) {
+  arrow::MemoryPool* pool = nullptr;
+  if (name.empty()) {
+    return arrow::default_memory_pool();
+  } else if (name == "system") {
+    return arrow::system_memory_pool();
+  } else if (name == "jemalloc") {
+    ARROW_RETURN_NOT_OK(arrow::jemalloc_memory_pool(&pool));
+    return pool;
+  } else if (name == "mimalloc") {
+    ARROW_RETURN_NOT_OK(arrow::mimalloc_memory_pool(&pool));
+    return pool;
+  }
+  return arrow::Status::Invalid("Unknown memory pool ", name, ", expected system, jemalloc or mimalloc");
+}
+
+void raise_to(std::atomic<int64_t>& peak, int64_t value) {
+  int64_t current = peak.load();
+  while (value > current && !peak.compare_exchange_weak(current, value)) {
+  }
+}
+
+namespace arrow_sql_bridge {
+bool memory_account::try_charge(int64_t size) {
+  const int64_t after = bytes.fetch_add(size) + size;
+  if (limit > 0 && after > limit) {
+    bytes.fetch_sub(size);
+    return false;
+  }
+  raise_to(peak, after);
+  return true;
+}
+
+void memory_account::release(int64_t size) {
+  bytes.fetch_sub(size);
+}
+
+arrow::Status query_memory::Allocate(int64_t size, int64_t alignment, uint8_t** out) {
+  ARROW_RETURN_NOT_OK(tracker->charge(*this, size));
+  arrow::Status status = tracker->backend->Allocate(size, alignment, out);
+  if (!status.ok()) {
+    tracker->release(*this, size);
+    return status;
+  }
+  live_buffers++;
+  total_bytes += size;
+  allocations++;
+  tracker->total_bytes += size;
+  tracker->allocations++;
+  return arrow::Status::OK();
+}
+
+arrow::Status query_memory::Reallocate(int64_t old_size, int64_t new_size, int64_t alignment, uint8_t** ptr) {
+  const int64_t growth = new_size - old_size;
+  if (growth > 0) {
+    ARROW_RETURN_NOT_OK(tracker->charge(*this, growth));
+  }
+  arrow::Status status = tracker->backend->Reallocate(old_size, new_size, alignment, ptr);
+  if (!status.ok()) {
+    if (growth > 0) {
+      tracker->release(*this, growth);
+    }
+    return status;
+  }
+  if (growth < 0) {
+    tracker->release(*this, -growth);
+  } else {
+    total_bytes += growth;
+    tracker->total_bytes += growth;
+  }
+  allocations++;
+  tracker->allocations++;
+  return arrow::Status::OK();
+}
+
+void query_memory::Free(uint8_t* buffer, int64_t size, int64_t alignment) {
+  tracker->backend->Free(buffer, size, alignment);
+  tracker->release(*this, size);
+  live_buffers--;
+}
+
+int64_t query_memory::bytes_allocated() const {
+  return own.bytes.load();
+}
+
+int64_t query_memory::max_memory() const {
+  return own.peak.load();
+}
+
+int64_t query_memory::total_bytes_allocated() const {
+  return total_bytes.load();
+}
+
+int64_t query_memory::num_allocations() const {
+  return allocations.load();
+}
+
+std::string query_memory::backend_name() const {
+  return tracker->backend->backend_name();
+}
+
+arrow::Result<std::shared_ptr<memory_tracker>> memory_tracker::make(const server_options& options) {
+  ARROW_ASSIGN_OR_RAISE(auto backend, backend_pool(options.memory_pool));
+  try {
+    return std::shared_ptr<memory_tracker>(new memory_tracker(backend, options));
+  } catch (...) {
+    std::string err_msg("Failed to create memory_tracker, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+}
+
+memory_tracker::memory_tracker(arrow::MemoryPool* backend, const server_options& options)
+    : backend(backend)
+    , query_limit(options.query_memory_limit)
+    , connection_limit(options.connection_memory_limit)
+    , memory_wait(options.memory_wait)
+    , total(options.server_memory_limit) {}
+
+std::shared_ptr<query_memory> memory_tracker::open(const std::string& peer) {
+  std::lock_guard lock(mutex);
+  // Pools stay until the query dropped its pool and its last buffer, even an empty one, is freed
+  std::erase_if(queries, [](const std::shared_ptr<query_memory>& query) {
+    return query.use_count() == 1 && query->live_buffers.load() == 0;
+  });
+  std::erase_if(connections, [](const auto& connection) {
+    return connection.second.use_count() == 1 && connection.second->bytes.load() == 0;
+  });
+
+  auto& connection = connections[peer];
+  if (connection == nullptr) {
+    connection = std::make_shared<memory_account>(connection_limit);
+  }
+  auto query = std::shared_ptr<query_memory>(new query_memory(this, query_limit, connection));
+  queries.push_back(query);
+  return query;
+}
+
+arrow::Status memory_tracker::charge(query_memory& query, int64_t size) {
+  if (!query.own.try_charge(size)) {
+    rejections++;
+    return arrow::Status::OutOfMemory("Query went over its memory limit of ", query.own.limit, " bytes");
+  }
+  if (!query.connection->try_charge(size)) {
+    query.own.release(size);
+    rejections++;
+    return arrow::Status::OutOfMemory(
+        "Connection went over its memory limit of ", query.connection->limit, " bytes"
+    );
+  }
+  if (!total.try_charge(size)) {
+    // Other queries are bound to finish, so the query is slowed down for a while before it fails
+    std::unique_lock lock(wait_mutex);
+    if (!freed.wait_for(lock, memory_wait, [&] { return total.try_charge(size); })) {
+      lock.unlock();
+      query.connection->release(size);
+      query.own.release(size);
+      rejections++;
+      return arrow::Status::OutOfMemory("Server went over its memory limit of ", total.limit, " bytes");
+    }
+  }
+  raise_to(peak_query_bytes, query.own.bytes.load());
+  return arrow::Status::OK();
+}
+
+void memory_tracker::release(query_memory& query, int64_t size) {
+  query.own.release(size);
+  query.connection->release(size);
+  total.release(size);
+  if (total.limit > 0) {
+    std::lock_guard lock(wait_mutex);
+    freed.notify_all();
+  }
+}
+
+memory_stats memory_tracker::stats() {
+  memory_stats result;
+  result.backend = backend->backend_name();
+  result.bytes = total.bytes.load();
+  result.peak_bytes = total.peak.load();
+  result.total_bytes = total_bytes.load();
+  result.allocations = allocations.load();
+  result.peak_query_bytes = peak_query_bytes.load();
+  result.rejections = rejections.load();
+
+  std::lock_guard lock(mutex);
+  const auto now = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(now - rate_since).count();
+  if (seconds > 0) {
+    result.allocation_rate = static_cast<double>(result.total_bytes - rate_bytes) / seconds;
+  }
+  rate_since = now;
+  rate_bytes = result.total_bytes;
+
+  result.queries = std::count_if(queries.begin(), queries.end(), [](const std::shared_ptr<query_memory>& query) {
+    return query.use_count() > 1;
+  });
+  for (const auto& [peer, connection] : connections) {
+    result.connection_bytes[peer] = connection->bytes.load();
+  }
+  return result;
+}
+} // namespace arrow_sql_bridge
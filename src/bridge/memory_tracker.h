@@ -0,0 +1,140 @@
+#pragma once
+
+#include "arrow/memory_pool.h"
+#include "arrow/result.h"
+#include "server_options.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace arrow_sql_bridge {
+struct memory_stats {
+  std::string backend;
+  // Bytes the buffers of query results hold right now, and the most they ever held at once
+  int64_t bytes = 0;
+  int64_t peak_bytes = 0;
+  int64_t total_bytes = 0;
+  int64_t allocations = 0;
+  // Bytes allocated per second since the previous call
+  double allocation_rate = 0;
+  // The most a single query held at once
+  int64_t peak_query_bytes = 0;
+  // Allocations refused because they would have gone over a budget
+  uint64_t rejections = 0;
+  size_t queries = 0;
+  // Bytes held by the queries of every client connection, keyed by peer
+  std::unordered_map<std::string, int64_t> connection_bytes;
+};
+
+// Bytes charged against one budget
+struct memory_account {
+  // 0 is unlimited
+  int64_t limit = 0;
+  std::atomic<int64_t> bytes{0};
+  std::atomic<int64_t> peak{0};
+
+  explicit memory_account(int64_t limit)
+      : limit(limit) {}
+
+  // Leaves the account unchanged if the bytes do not fit
+  bool try_charge(int64_t size);
+
+  void release(int64_t size);
+};
+
+class memory_tracker;
+
+// Memory pool of one query. Every allocation is charged to the query, to its client connection
+// and to the server, and is refused once any of them would go over its budget.
+class query_memory : public arrow::MemoryPool {
+public:
+  using arrow::MemoryPool::Allocate;
+  using arrow::MemoryPool::Free;
+  using arrow::MemoryPool::Reallocate;
+
+  arrow::Status Allocate(int64_t size, int64_t alignment, uint8_t** out) override;
+
+  arrow::Status Reallocate(int64_t old_size, int64_t new_size, int64_t alignment, uint8_t** ptr) override;
+
+  void Free(uint8_t* buffer, int64_t size, int64_t alignment) override;
+
+  int64_t bytes_allocated() const override;
+
+  int64_t max_memory() const override;
+
+  int64_t total_bytes_allocated() const override;
+
+  int64_t num_allocations() const override;
+
+  std::string backend_name() const override;
+
+private:
+  friend class memory_tracker;
+
+  memory_tracker* tracker;
+  memory_account own;
+  std::shared_ptr<memory_account> connection;
+  std::atomic<int64_t> total_bytes{0};
+  std::atomic<int64_t> allocations{0};
+  std::atomic<int64_t> live_buffers{0};
+
+  query_memory(memory_tracker* tracker, int64_t limit, std::shared_ptr<memory_account> connection)
+      : tracker(tracker)
+      , own(limit)
+      , connection(std::move(connection)) {}
+};
+
+// Hands out a tracking pool per query over the allocator the server was configured with, and
+// keeps each pool alive until the query is gone and all of its buffers were freed.
+class memory_tracker {
+public:
+  static arrow::Result<std::shared_ptr<memory_tracker>> make(const server_options& options);
+
+  memory_tracker(const memory_tracker&) = delete;
+
+  memory_tracker& operator=(const memory_tracker&) = delete;
+
+  // Pool for the next query of a client connection
+  std::shared_ptr<query_memory> open(const std::string& peer);
+
+  memory_stats stats();
+
+private:
+  friend class query_memory;
+
+  arrow::MemoryPool* backend;
+  int64_t query_limit;
+  int64_t connection_limit;
+  std::chrono::milliseconds memory_wait;
+  memory_account total;
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<query_memory>> queries;
+  std::unordered_map<std::string, std::shared_ptr<memory_account>> connections;
+
+  // Allocations over the server budget wait here for other queries to free memory
+  std::mutex wait_mutex;
+  std::condition_variable freed;
+
+  std::atomic<int64_t> total_bytes{0};
+  std::atomic<int64_t> allocations{0};
+  std::atomic<int64_t> peak_query_bytes{0};
+  std::atomic<uint64_t> rejections{0};
+
+  std::chrono::steady_clock::time_point rate_since = std::chrono::steady_clock::now();
+  int64_t rate_bytes = 0;
+
+  memory_tracker(arrow::MemoryPool* backend, const server_options& options);
+
+  arrow::Status charge(query_memory& query, int64_t size);
+
+  void release(query_memory& query, int64_t size);
+};
+} // namespace arrow_sql_bridge
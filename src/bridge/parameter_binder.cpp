@@ -0,0 +1,154 @@
+#include "parameter_binder.h"
+
+#include "arrow/array.h"
+
+#include <limits>
+#include <type_traits>
+
+arrow::Status check_bind(sqlite3_stmt* stmt, int rc) {
+  if (rc != SQLITE_OK) {
+    return arrow::Status::ExecutionError("Failed to bind parameter: ", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+  }
+  return arrow::Status::OK();
+}
+
+template <typename ArrayType>
+arrow::Status bind_integer(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  const auto value = static_cast<const ArrayType&>(array).Value(row);
+  // SQLite integers are signed 64-bit, larger uint64 values would wrap around
+  if constexpr (std::is_same_v<ArrayType, arrow::UInt64Array>) {
+    if (value > static_cast<uint64_t>(std::numeric_limits<sqlite3_int64>::max())) {
+      return arrow::Status::Invalid("Value ", value, " does not fit a SQLite integer");
+    }
+  }
+  return check_bind(stmt, sqlite3_bind_int64(stmt, index, static_cast<sqlite3_int64>(value)));
+}
+
+template <typename ArrayType>
+arrow::Status bind_floating(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  const auto value = static_cast<const ArrayType&>(array).Value(row);
+  return check_bind(stmt, sqlite3_bind_double(stmt, index, static_cast<double>(value)));
+}
+
+arrow::Status bind_boolean(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  const bool value = static_cast<const arrow::BooleanArray&>(array).Value(row);
+  return check_bind(stmt, sqlite3_bind_int(stmt, index, value ? 1 : 0));
+}
+
+template <typename ArrayType>
+arrow::Status bind_text(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  const std::string_view value = static_cast<const ArrayType&>(array).GetView(row);
+  return check_bind(
+      stmt,
+      sqlite3_bind_text64(stmt, index, value.data(), value.size(), SQLITE_STATIC, SQLITE_UTF8)
+  );
+}
+
+template <typename ArrayType>
+arrow::Status bind_blob(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  const std::string_view value = static_cast<const ArrayType&>(array).GetView(row);
+  return check_bind(stmt, sqlite3_bind_blob64(stmt, index, value.data(), value.size(), SQLITE_STATIC));
+}
+
+arrow::Status bind_null(sqlite3_stmt* stmt, int index, const arrow::Array&, int64_t) {
+  return check_bind(stmt, sqlite3_bind_null(stmt, index));
+}
+
+arrow::Status bind_union(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row);
+
+arrow::Result<arrow_sql_bridge::parameter_binder::bind_function> resolve_bind_function(const arrow::DataType& type) {
+  switch (type.id()) {
+  case arrow::Type::INT8:
+    return bind_integer<arrow::Int8Array>;
+  case arrow::Type::INT16:
+    return bind_integer<arrow::Int16Array>;
+  case arrow::Type::INT32:
+    return bind_integer<arrow::Int32Array>;
+  case arrow::Type::INT64:
+    return bind_integer<arrow::Int64Array>;
+  case arrow::Type::UINT8:
+    return bind_integer<arrow::UInt8Array>;
+  case arrow::Type::UINT16:
+    return bind_integer<arrow::UInt16Array>;
+  case arrow::Type::UINT32:
+    return bind_integer<arrow::UInt32Array>;
+  case arrow::Type::UINT64:
+    return bind_integer<arrow::UInt64Array>;
+  case arrow::Type::FLOAT:
+    return bind_floating<arrow::FloatArray>;
+  case arrow::Type::DOUBLE:
+    return bind_floating<arrow::DoubleArray>;
+  case arrow::Type::BOOL:
+    return bind_boolean;
+  case arrow::Type::STRING:
+    return bind_text<arrow::StringArray>;
+  case arrow::Type::LARGE_STRING:
+    return bind_text<arrow::LargeStringArray>;
+  case arrow::Type::BINARY:
+    return bind_blob<arrow::BinaryArray>;
+  case arrow::Type::LARGE_BINARY:
+    return bind_blob<arrow::LargeBinaryArray>;
+  case arrow::Type::FIXED_SIZE_BINARY:
+    return bind_blob<arrow::FixedSizeBinaryArray>;
+  case arrow::Type::NA:
+    return bind_null;
+  case arrow::Type::DENSE_UNION:
+  case arrow::Type::SPARSE_UNION:
+    return bind_union;
+  default:
+    return arrow::Status::NotImplemented("Binding parameters of type ", type.ToString(), " is not supported");
+  }
+}
+
+arrow::Status bind_value(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  if (array.IsNull(row)) {
+    return bind_null(stmt, index, array, row);
+  }
+  ARROW_ASSIGN_OR_RAISE(auto bind, resolve_bind_function(*array.type()));
+  return bind(stmt, index, array, row);
+}
+
+arrow::Status bind_union(sqlite3_stmt* stmt, int index, const arrow::Array& array, int64_t row) {
+  const auto& union_array = static_cast<const arrow::UnionArray&>(array);
+  const int child_id = union_array.child_id(row);
+  int64_t child_row = row;
+  if (array.type_id() == arrow::Type::DENSE_UNION) {
+    child_row = static_cast<const arrow::DenseUnionArray&>(array).value_offset(row);
+  }
+  return bind_value(stmt, index, *union_array.field(child_id), child_row);
+}
+
+namespace arrow_sql_bridge {
+arrow::Result<parameter_binder> parameter_binder::make(const arrow::Schema& schema, sqlite3_stmt* stmt) {
+  const int parameter_count = sqlite3_bind_parameter_count(stmt);
+  if (schema.num_fields() != parameter_count) {
+    return arrow::Status::Invalid(
+        "Statement expects ",
+        parameter_count,
+        " parameters, but ",
+        schema.num_fields(),
+        " columns were provided"
+    );
+  }
+
+  std::vector<bind_function> binders(schema.num_fields());
+  for (int i = 0; i < schema.num_fields(); i++) {
+    ARROW_ASSIGN_OR_RAISE(binders[i], resolve_bind_function(*schema.field(i)->type()));
+  }
+  return parameter_binder(std::move(binders));
+}
+
+arrow::Status parameter_binder::bind(sqlite3_stmt* stmt, const arrow::RecordBatch& batch, int64_t row) const {
+  const auto& columns = batch.columns();
+  for (size_t i = 0; i < binders.size(); i++) {
+    const arrow::Array& column = *columns[i];
+    const int index = static_cast<int>(i) + 1;
+    if (column.IsNull(row)) {
+      ARROW_RETURN_NOT_OK(bind_null(stmt, index, column, row));
+    } else {
+      ARROW_RETURN_NOT_OK(binders[i](stmt, index, column, row));
+    }
+  }
+  return arrow::Status::OK();
+}
+} // namespace arrow_sql_bridge
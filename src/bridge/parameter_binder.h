@@ -0,0 +1,28 @@
+#pragma once
+
+#include "arrow/record_batch.h"
+#include "arrow/result.h"
+#include "sqlite3.h"
+
+#include <vector>
+
+namespace arrow_sql_bridge {
+// Binds rows of an Arrow record batch to the parameters of a SQLite statement,
+// column i going to parameter i + 1. The per-column bind function is resolved
+// once from the schema; dense and sparse unions are resolved per value.
+class parameter_binder {
+public:
+  using bind_function = arrow::Status (*)(sqlite3_stmt*, int, const arrow::Array&, int64_t);
+
+  static arrow::Result<parameter_binder> make(const arrow::Schema& schema, sqlite3_stmt* stmt);
+
+  // Values are bound with SQLITE_STATIC: the batch has to outlive the next step
+  arrow::Status bind(sqlite3_stmt* stmt, const arrow::RecordBatch& batch, int64_t row) const;
+
+private:
+  std::vector<bind_function> binders;
+
+  explicit parameter_binder(std::vector<bind_function> binders)
+      : binders(std::move(binders)) {}
+};
+} // namespace arrow_sql_bridge
@@ -0,0 +1,129 @@
+#include "prefetching_reader.h"
+
+namespace arrow_sql_bridge {
+prefetch_stats prefetch_counters::stats() const {
+  const uint64_t sampled = reads.load();
+  return prefetch_stats{
+      streams.load(),
+      batches.load(),
+      sampled == 0 ? 0 : static_cast<double>(occupancy.load()) / static_cast<double>(sampled),
+      peak_occupancy.load(),
+      std::chrono::microseconds(producer_stall_us.load()),
+      std::chrono::microseconds(consumer_stall_us.load())
+  };
+}
+
+arrow::Result<std::shared_ptr<prefetching_reader>> prefetching_reader::make(
+    std::shared_ptr<arrow::RecordBatchReader> source,
+    size_t depth,
+    std::shared_ptr<prefetch_counters> counters
+) {
+  if (depth == 0) {
+    return arrow::Status::Invalid("Prefetch depth must be positive");
+  }
+
+  std::shared_ptr<prefetching_reader> reader;
+  try {
+    reader.reset(new prefetching_reader(std::move(source), depth, std::move(counters)));
+  } catch (...) {
+    std::string err_msg("Failed to create prefetching_reader, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+  reader->counters->streams++;
+  reader->worker = std::thread([raw = reader.get()] { raw->produce(); });
+  return reader;
+}
+
+prefetching_reader::prefetching_reader(
+    std::shared_ptr<arrow::RecordBatchReader> source,
+    size_t depth,
+    std::shared_ptr<prefetch_counters> counters
+)
+    : source(std::move(source))
+    , schema_ptr(this->source->schema())
+    , depth(depth)
+    , counters(std::move(counters)) {}
+
+std::shared_ptr<arrow::Schema> prefetching_reader::schema() const {
+  return schema_ptr;
+}
+
+void prefetching_reader::produce() {
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      if (queue.size() >= depth && !closed) {
+        const auto start = std::chrono::steady_clock::now();
+        consumed.wait(lock, [this] { return queue.size() < depth || closed; });
+        counters->producer_stall_us +=
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      }
+      if (closed) {
+        break;
+      }
+    }
+
+    std::shared_ptr<arrow::RecordBatch> batch;
+    arrow::Status read = source->ReadNext(&batch);
+
+    std::lock_guard lock(mutex);
+    if (!read.ok() || batch == nullptr) {
+      status = std::move(read);
+      break;
+    }
+    queue.push_back(std::move(batch));
+    counters->batches++;
+    produced.notify_one();
+  }
+
+  // Gives the statement, and with it the pooled connection, back without waiting for the consumer
+  source.reset();
+  std::lock_guard lock(mutex);
+  done = true;
+  produced.notify_one();
+}
+
+arrow::Status prefetching_reader::ReadNext(std::shared_ptr<arrow::RecordBatch>* out) {
+  std::unique_lock lock(mutex);
+  if (queue.empty() && !done && !closed) {
+    const auto start = std::chrono::steady_clock::now();
+    produced.wait(lock, [this] { return !queue.empty() || done || closed; });
+    counters->consumer_stall_us +=
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  const size_t waiting = queue.size();
+  counters->reads++;
+  counters->occupancy += waiting;
+  size_t peak = counters->peak_occupancy.load();
+  while (waiting > peak && !counters->peak_occupancy.compare_exchange_weak(peak, waiting)) {
+  }
+
+  if (queue.empty()) {
+    out->reset();
+    return closed ? arrow::Status::OK() : status;
+  }
+  *out = std::move(queue.front());
+  queue.pop_front();
+  consumed.notify_one();
+  return arrow::Status::OK();
+}
+
+arrow::Status prefetching_reader::Close() {
+  {
+    std::lock_guard lock(mutex);
+    closed = true;
+    queue.clear();
+  }
+  consumed.notify_one();
+  produced.notify_one();
+  if (worker.joinable()) {
+    worker.join();
+  }
+  return arrow::Status::OK();
+}
+
+prefetching_reader::~prefetching_reader() {
+  ARROW_UNUSED(Close());
+}
+} // namespace arrow_sql_bridge
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "arrow/record_batch.h"
+#include "arrow/result.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace arrow_sql_bridge {
+struct prefetch_stats {
+  uint64_t streams = 0;
+  uint64_t batches = 0;
+  // Batches already waiting when the consumer asked for the next one
+  double mean_occupancy = 0;
+  size_t peak_occupancy = 0;
+  // Time the producers held back stepping because the queue was full, i.e. the client was slower
+  std::chrono::microseconds producer_stall{0};
+  // Time the consumers waited on an empty queue, i.e. SQLite was slower
+  std::chrono::microseconds consumer_stall{0};
+};
+
+// Counters shared by all prefetching readers of a server
+class prefetch_counters {
+public:
+  prefetch_stats stats() const;
+
+private:
+  friend class prefetching_reader;
+
+  std::atomic<uint64_t> streams{0};
+  std::atomic<uint64_t> batches{0};
+  std::atomic<uint64_t> reads{0};
+  std::atomic<uint64_t> occupancy{0};
+  std::atomic<size_t> peak_occupancy{0};
+  std::atomic<int64_t> producer_stall_us{0};
+  std::atomic<int64_t> consumer_stall_us{0};
+};
+
+// Reads another reader on a worker thread, at most `depth` batches ahead of the consumer, so
+// stepping the statement overlaps with serializing and sending the batches before it. The worker
+// blocks while the queue is full. The source is released by the worker once it is exhausted.
+class prefetching_reader : public arrow::RecordBatchReader {
+public:
+  static arrow::Result<std::shared_ptr<prefetching_reader>> make(
+      std::shared_ptr<arrow::RecordBatchReader> source,
+      size_t depth,
+      std::shared_ptr<prefetch_counters> counters
+  );
+
+  prefetching_reader(const prefetching_reader&) = delete;
+
+  prefetching_reader& operator=(const prefetching_reader&) = delete;
+
+  std::shared_ptr<arrow::Schema> schema() const override;
+
+  // Returns the error of the source once the batches read before it are consumed
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* out) override;
+
+  // Stops the worker after the batch it is reading, the batches still queued are dropped
+  arrow::Status Close() override;
+
+  ~prefetching_reader() override;
+
+private:
+  std::shared_ptr<arrow::RecordBatchReader> source;
+  std::shared_ptr<arrow::Schema> schema_ptr;
+  size_t depth;
+  std::shared_ptr<prefetch_counters> counters;
+
+  std::mutex mutex;
+  std::condition_variable produced;
+  std::condition_variable consumed;
+  std::deque<std::shared_ptr<arrow::RecordBatch>> queue;
+  arrow::Status status;
+  bool done = false;
+  bool closed = false;
+  std::thread worker;
+
+  prefetching_reader(
+      std::shared_ptr<arrow::RecordBatchReader> source,
+      size_t depth,
+      std::shared_ptr<prefetch_counters> counters
+  );
+
+  void produce();
+};
+} // namespace arrow_sql_bridge
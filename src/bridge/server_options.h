@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace arrow_sql_bridge {
+// Where query results are cut into record batches. A batch ends at whichever limit it reaches first.
+struct batch_limits {
+  int64_t max_rows = 65536;
+  // Compared against the bytes of the values appended so far, not the encoded IPC size
+  int64_t target_bytes = 4 << 20;
+  // The first batch is kept this short so the first rows reach the client before the statement
+  // stepped far. 0 cuts it like the others.
+  int64_t first_batch_rows = 1024;
+};
+
+// How result columns are typed. The declared type of a column picks the type family by SQLite's
+// affinity rules, narrowing picks a smaller type within it. Values that do not fit the narrowed
+// type fail the query.
+enum class type_narrowing {
+  // int64, float64, utf8, binary, and a dense union for columns without a fixed affinity
+  none,
+  // TINYINT becomes int8, SMALLINT and INT2 int16, BOOLEAN bool, DATE date32, and DATETIME and
+  // TIMESTAMP timestamp[us]. INT, MEDIUMINT and the other integer types stay int64.
+  declared,
+  // As declared, and text columns with few distinct values among the first rows become
+  // dictionary<int32, utf8>. Read-only statements without parameters step those rows once more to
+  // sample them. Behind a router nodes only narrow by declared types, see the x-type-narrowing header.
+  sampled,
+};
+
+struct type_inference {
+  type_narrowing narrowing = type_narrowing::none;
+  size_t sample_rows = 1024;
+};
+
+struct server_options {
+  // Number of SQLite connections shared by all concurrent Flight SQL calls.
+  // In-memory databases always use a single connection.
+  size_t pool_size = 8;
+
+  // How long a call waits for a free connection before failing.
+  std::chrono::milliseconds acquire_timeout{10000};
+
+  // How long SQLite retries a locked database before returning SQLITE_BUSY.
+  std::chrono::milliseconds busy_timeout{5000};
+
+  // Prepared statements kept per connection, keyed by normalized SQL. 0 disables caching.
+  size_t statement_cache_size = 256;
+
+  type_inference types;
+
+  // How long a query planned by GetFlightInfo waits for its DoGet. Until then it keeps one pooled
+  // connection leased, unless the pool runs out and takes it back.
+  std::chrono::milliseconds statement_handle_ttl{30000};
+
+  // Prepared statements that are neither used nor closed for this long are dropped.
+  std::chrono::milliseconds prepared_statement_ttl{600000};
+
+  // Rows written per transaction by bulk ingestion. 0 commits once, after the whole stream.
+  size_t ingest_chunk_rows = 100000;
+
+  // Record batches a worker thread reads ahead of the client for every query result, stalling once
+  // that many wait to be sent. 0 steps the statement on the calling thread, between the sends.
+  size_t prefetch_depth = 2;
+
+  // Queries may override max_rows and target_bytes with the x-batch-max-rows and
+  // x-batch-target-bytes headers of their DoGet call.
+  batch_limits batch;
+
+  // Allocator behind the buffers of query results: "system", "jemalloc", "mimalloc", or empty for
+  // Arrow's default. The allocator has to be built into Arrow.
+  std::string memory_pool;
+
+  // Bytes the result buffers of one query, of all queries of one client connection and of the
+  // whole server may hold at once, 0 is unlimited. Queries going over their own or their
+  // connection's budget fail. Over the server's budget they first wait up to memory_wait for other
+  // queries to free memory.
+  int64_t query_memory_limit = 0;
+  int64_t connection_memory_limit = 0;
+  int64_t server_memory_limit = 0;
+  std::chrono::milliseconds memory_wait{1000};
+};
+} // namespace arrow_sql_bridge
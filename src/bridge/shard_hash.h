@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace arrow_sql_bridge {
+// Placement hash of a shard key. The router places rows with it and nodes select rows
+// by it, so both sides must agree: integers hash through their decimal text, which is
+// also how SQLite renders them, and the result is FNV-1a finished with a 64-bit mixer
+// to spread short keys over the whole range.
+inline uint64_t shard_hash(std::string_view key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+inline uint64_t shard_hash(int64_t key) {
+  return shard_hash(std::to_string(key));
+}
+
+// SQLite integers are signed: the SQL shard_hash() flips the top bit so hashes compare
+// in SQL the same way they do as unsigned values
+inline int64_t sql_shard_hash(uint64_t hash) {
+  return static_cast<int64_t>(hash ^ (uint64_t{1} << 63));
+}
+} // namespace arrow_sql_bridge
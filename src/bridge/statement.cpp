@@ -1,40 +1,36 @@
 #include "statement.h"
 
-std::shared_ptr<arrow::DataType> column_to_arrow_datatype(const int column_type) {
-  switch (column_type) {
-  case SQLITE_INTEGER:
-    return arrow::int64();
-  case SQLITE_FLOAT:
-    return arrow::float64();
-  case SQLITE_BLOB:
-    return arrow::binary();
-  case SQLITE_TEXT:
-    return arrow::utf8();
-  case SQLITE_NULL:
-  default:
-    return arrow::null();
-  }
-}
+#include <algorithm>
+#include <unordered_set>
 
-// clang-format off
-arrow::Result<std::shared_ptr<arrow::DataType>> sqlite_to_arrow_datatype(const char* sqlite_type) {
-  if (sqlite_type == nullptr || std::strlen(sqlite_type) == 0) {
-    return arrow::null();
-  }
+// Minimum sampled values and the most distinct ones among them for a text column to be dictionary encoded
+const int64_t kMinDictionarySample = 32;
+const int64_t kMaxDistinctShare = 4;
 
-  if (boost::iequals(sqlite_type, "int") || boost::iequals(sqlite_type, "integer")) {
-    return arrow::int64();
-  } else if (boost::iequals(sqlite_type, "REAL")) {
-    return arrow::float64();
-  } else if (boost::iequals(sqlite_type, "BLOB")) {
-    return arrow::binary();
-  } else if (boost::iequals(sqlite_type, "TEXT")
-             || boost::iequals(sqlite_type, "DATE")
-             || boost::istarts_with(sqlite_type, "char")
-             || boost::istarts_with(sqlite_type, "varchar")) {
-    return arrow::utf8();
+enum class sqlite_affinity { integer, text, blob, real, numeric };
+
+// The rules of https://www.sqlite.org/datatype3.html#determination_of_column_affinity, in their order
+sqlite_affinity column_affinity(const std::string& declared) {
+  if (boost::icontains(declared, "INT")) {
+    return sqlite_affinity::integer;
+  } else if (boost::icontains(declared, "CHAR") || boost::icontains(declared, "CLOB")
+             || boost::icontains(declared, "TEXT")) {
+    return sqlite_affinity::text;
+  } else if (boost::icontains(declared, "BLOB") || declared.empty()) {
+    return sqlite_affinity::blob;
+  } else if (boost::icontains(declared, "REAL") || boost::icontains(declared, "FLOA")
+             || boost::icontains(declared, "DOUB")) {
+    return sqlite_affinity::real;
   }
-  return arrow::Status::Invalid("Invalid SQLite type: ", sqlite_type);
+  return sqlite_affinity::numeric;
+}
+
+// The declared type without its size arguments, "VARCHAR(20)" is "VARCHAR"
+std::string type_name(const std::string& declared) {
+  std::string name = declared.substr(0, declared.find('('));
+  boost::trim(name);
+  boost::to_upper(name);
+  return name;
 }
 
 inline std::shared_ptr<arrow::DataType> get_unknown_dense_union() {
@@ -46,7 +42,43 @@ inline std::shared_ptr<arrow::DataType> get_unknown_dense_union() {
   });
 }
 
-// clang-format on
+std::shared_ptr<arrow::DataType>
+sqlite_to_arrow_datatype(const std::string& declared, arrow_sql_bridge::type_narrowing narrowing) {
+  const bool narrow = narrowing != arrow_sql_bridge::type_narrowing::none;
+  const std::string name = type_name(declared);
+  switch (column_affinity(declared)) {
+  case sqlite_affinity::integer:
+    // Only names that spell out a small size are narrowed. INT and friends hold 64-bit values as
+    // often as not, SQLite gives them the same affinity as INTEGER.
+    if (narrow && name == "TINYINT") {
+      return arrow::int8();
+    } else if (narrow && (name == "SMALLINT" || name == "INT2")) {
+      return arrow::int16();
+    }
+    return arrow::int64();
+  case sqlite_affinity::text:
+    return arrow::utf8();
+  case sqlite_affinity::blob:
+    return arrow::binary();
+  case sqlite_affinity::real:
+    return arrow::float64();
+  case sqlite_affinity::numeric:
+    break;
+  }
+
+  // Booleans are stored as 0 and 1, dates and times as ISO 8601 text unless narrowed
+  if (name == "BOOL" || name == "BOOLEAN") {
+    return narrow ? arrow::boolean() : arrow::int64();
+  } else if (name == "DATE") {
+    return narrow ? arrow::date32() : arrow::utf8();
+  } else if (name == "DATETIME" || name == "TIMESTAMP") {
+    return narrow ? arrow::timestamp(arrow::TimeUnit::MICRO) : arrow::utf8();
+  } else if (name.find("DATE") != std::string::npos || name.find("TIME") != std::string::npos) {
+    return arrow::utf8();
+  }
+  // NUMERIC, DECIMAL, ... keep integers, reals and text that is no number alike
+  return get_unknown_dense_union();
+}
 
 int get_precision(const int column_type) {
   switch (column_type) {
@@ -76,9 +108,14 @@ arrow::flight::sql::ColumnMetadata build_column_meta(int column_type, const char
 }
 
 namespace arrow_sql_bridge {
-arrow::Result<std::shared_ptr<statement>> statement::make(sqlite3* db, const std::string& sql) {
-  sqlite3_stmt* stmt = nullptr;
-  int rc = sqlite3_prepare_v2(db, sql.c_str(), static_cast<int>(sql.size()), &stmt, NULLPTR);
+arrow::Result<std::shared_ptr<statement>> statement::make(std::shared_ptr<connection> conn, const std::string& sql) {
+  sqlite3* db = conn->get_sqlite3_db();
+  std::string cache_key = normalize_sql(sql);
+  sqlite3_stmt* stmt = conn->get_statement_cache().take(cache_key);
+  int rc = SQLITE_OK;
+  if (stmt == nullptr) {
+    rc = sqlite3_prepare_v2(db, sql.c_str(), static_cast<int>(sql.size()), &stmt, NULLPTR);
+  }
 
   std::string err_msg;
   if (rc != SQLITE_OK) {
@@ -87,7 +124,7 @@ arrow::Result<std::shared_ptr<statement>> statement::make(sqlite3* db, const std
   }
 
   try {
-    return std::shared_ptr<statement>(new statement(db, stmt));
+    return std::shared_ptr<statement>(new statement(std::move(conn), stmt, std::move(cache_key)));
   } catch (...) {
     err_msg += "Failed to create statement, allocation failed";
     goto cleanup;
@@ -105,33 +142,102 @@ cleanup:
 }
 
 arrow::Result<std::shared_ptr<arrow::Schema>> statement::get_schema() const {
+  if (schema_ptr != nullptr) {
+    return schema_ptr;
+  }
+
+  type_inference types = conn->get_type_inference();
+  types.narrowing = std::min(types.narrowing, narrowing_cap);
   std::vector<std::shared_ptr<arrow::Field>> fields;
   int column_count = sqlite3_column_count(stmt);
   for (int i = 0; i < column_count; i++) {
     const char* column_name = sqlite3_column_name(stmt, i);
     const int column_type = sqlite3_column_type(stmt, i);
     const char* table = sqlite3_column_table_name(stmt, i);
-    std::shared_ptr<arrow::DataType> data_type = column_to_arrow_datatype(column_type);
-
-    if (data_type->id() == arrow::Type::NA) {
-      const char* column_decltype = sqlite3_column_decltype(stmt, i);
-      if (column_decltype != NULLPTR) {
-        ARROW_ASSIGN_OR_RAISE(data_type, sqlite_to_arrow_datatype(column_decltype));
-      } else {
-        data_type = get_unknown_dense_union();
-      }
-    }
+    const char* column_decltype = sqlite3_column_decltype(stmt, i);
+    // Expressions have no declared type and may produce any kind of value
+    std::shared_ptr<arrow::DataType> data_type = column_decltype != NULLPTR
+        ? sqlite_to_arrow_datatype(column_decltype, types.narrowing)
+        : get_unknown_dense_union();
 
     arrow::flight::sql::ColumnMetadata column_meta = build_column_meta(column_type, table);
     fields.push_back(arrow::field(column_name, data_type, column_meta.metadata_map()));
   }
 
+  if (types.narrowing == type_narrowing::sampled) {
+    ARROW_RETURN_NOT_OK(sample_dictionaries(fields, types.sample_rows));
+  }
+  schema_ptr = arrow::schema(fields);
+  return schema_ptr;
+}
+
+arrow::Status statement::sample_dictionaries(std::vector<std::shared_ptr<arrow::Field>>& fields, size_t rows) const {
+  std::vector<int> candidates;
+  for (int i = 0; i < static_cast<int>(fields.size()); i++) {
+    if (fields[i]->type()->id() == arrow::Type::STRING) {
+      candidates.push_back(i);
+    }
+  }
+  // Stepping a statement that writes would run it twice, and unbound parameters sample the wrong rows
+  if (candidates.empty() || rows == 0 || !sqlite3_stmt_readonly(stmt) || sqlite3_bind_parameter_count(stmt) > 0) {
+    return arrow::Status::OK();
+  }
+
+  std::vector<std::unordered_set<std::string>> distinct(candidates.size());
+  std::vector<int64_t> values(candidates.size(), 0);
+  sqlite3_reset(stmt);
+  for (size_t row = 0; row < rows; row++) {
+    const int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      break;
+    } else if (rc != SQLITE_ROW) {
+      sqlite3_reset(stmt);
+      return arrow::Status::ExecutionError("A SQLite runtime error has occurred: ", sqlite3_errmsg(db));
+    }
+    for (size_t i = 0; i < candidates.size(); i++) {
+      const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, candidates[i]));
+      if (text != nullptr) {
+        values[i]++;
+        distinct[i].emplace(text, sqlite3_column_bytes(stmt, candidates[i]));
+      }
+    }
+  }
+  sqlite3_reset(stmt);
+
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const int64_t distinct_values = static_cast<int64_t>(distinct[i].size());
+    if (values[i] >= kMinDictionarySample && distinct_values * kMaxDistinctShare <= values[i]) {
+      auto& field = fields[candidates[i]];
+      field = field->WithType(arrow::dictionary(arrow::int32(), arrow::utf8()));
+    }
+  }
+  return arrow::Status::OK();
+}
+
+void statement::set_schema(std::shared_ptr<arrow::Schema> schema) {
+  schema_ptr = std::move(schema);
+}
+
+void statement::cap_type_narrowing(type_narrowing narrowing) {
+  narrowing_cap = narrowing;
+}
+
+std::shared_ptr<arrow::Schema> statement::get_parameter_schema() const {
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  const int parameter_count = sqlite3_bind_parameter_count(stmt);
+  for (int i = 1; i <= parameter_count; i++) {
+    const char* parameter_name = sqlite3_bind_parameter_name(stmt, i);
+    // Named parameters keep their name without the ':', '@' or '$' prefix
+    std::string name = parameter_name != nullptr ? std::string(parameter_name + 1) : "parameter_" + std::to_string(i);
+    fields.push_back(arrow::field(name, get_unknown_dense_union()));
+  }
+
   return arrow::schema(fields);
 }
 
 arrow::Result<int> statement::step() {
   int rc = sqlite3_step(stmt);
-  if (rc == SQLITE_ERROR) {
+  if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
     return arrow::Status::ExecutionError("A SQLite runtime error has occurred: ", sqlite3_errmsg(db));
   }
 
@@ -152,6 +258,6 @@ sqlite3_stmt* statement::get_sqlite3_statement() const {
 }
 
 statement::~statement() noexcept {
-  sqlite3_finalize(stmt);
+  conn->get_statement_cache().put(cache_key, stmt);
 }
 } // namespace arrow_sql_bridge
@@ -3,20 +3,31 @@
 #include "arrow/flight/sql/column_metadata.h"
 #include "arrow/type.h"
 #include "arrow/type_fwd.h"
+#include "connection.h"
 
 #include <boost/algorithm/string.hpp>
 #include <sqlite3.h>
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace arrow_sql_bridge {
 class statement {
 public:
-  static arrow::Result<std::shared_ptr<statement>> make(sqlite3* db, const std::string& sql);
+  static arrow::Result<std::shared_ptr<statement>> make(std::shared_ptr<connection> conn, const std::string& sql);
 
+  // Computed once per statement, so a result is typed the same from GetFlightInfo to DoGet
   arrow::Result<std::shared_ptr<arrow::Schema>> get_schema() const;
 
+  // Types the result by a schema inferred earlier for the same SQL, e.g. the one GetFlightInfo announced
+  void set_schema(std::shared_ptr<arrow::Schema> schema);
+
+  // Narrows result types at most this far, whatever the connection allows. Must come before get_schema().
+  void cap_type_narrowing(type_narrowing narrowing);
+
+  std::shared_ptr<arrow::Schema> get_parameter_schema() const;
+
   arrow::Result<int> step();
 
   arrow::Result<int> reset();
@@ -26,11 +37,20 @@ public:
   ~statement() noexcept;
 
 private:
+  std::shared_ptr<connection> conn;
   sqlite3* db;
   sqlite3_stmt* stmt;
-
-  statement(sqlite3* db, sqlite3_stmt* stmt)
-      : db(db)
-      , stmt(stmt) {}
+  std::string cache_key;
+  mutable std::shared_ptr<arrow::Schema> schema_ptr;
+  type_narrowing narrowing_cap = type_narrowing::sampled;
+
+  // Dictionary encodes the text columns that repeat a few values over the first rows
+  arrow::Status sample_dictionaries(std::vector<std::shared_ptr<arrow::Field>>& fields, size_t rows) const;
+
+  statement(std::shared_ptr<connection> conn, sqlite3_stmt* stmt, std::string cache_key)
+      : conn(std::move(conn))
+      , db(this->conn->get_sqlite3_db())
+      , stmt(stmt)
+      , cache_key(std::move(cache_key)) {}
 };
 } // namespace arrow_sql_bridge
@@ -1,80 +1,44 @@
 #include "statement_batch_reader.h"
 
-#define INT_BUILDER_CASE(TYPE_CLASS, STMT, COLUMN)                                                                     \
-  case arrow::TYPE_CLASS##Type::type_id: {                                                                             \
-    using c_type = typename arrow::TYPE_CLASS##Type::c_type;                                                           \
-    auto status = int_builder_case<arrow::TYPE_CLASS##Builder, c_type>(array_builder, STMT, COLUMN);                   \
-    ARROW_RETURN_NOT_OK(status);                                                                                       \
-    break;                                                                                                             \
-  }
-
-#define FLOAT_BUILDER_CASE(TYPE_CLASS, STMT, COLUMN)                                                                   \
-  case arrow::TYPE_CLASS##Type::type_id: {                                                                             \
-    auto status = float_builder_case<arrow::TYPE_CLASS##Builder>(array_builder, STMT, COLUMN);                         \
-    ARROW_RETURN_NOT_OK(status);                                                                                       \
-    break;                                                                                                             \
-  }
-
-#define STRING_BUILDER_CASE(TYPE_CLASS, STMT, COLUMN)                                                                  \
-  case arrow::TYPE_CLASS##Type::type_id: {                                                                             \
-    auto status = string_builder_case<arrow::TYPE_CLASS##Builder>(array_builder, STMT, COLUMN);                        \
-    ARROW_RETURN_NOT_OK(status);                                                                                       \
-    break;                                                                                                             \
-  }
-
-#define BINARY_BUILDER_CASE(TYPE_CLASS, STMT, COLUMN)                                                                  \
-  case arrow::TYPE_CLASS##Type::type_id: {                                                                             \
-    auto status = binary_builder_case<arrow::TYPE_CLASS##Builder>(array_builder, STMT, COLUMN);                        \
-    ARROW_RETURN_NOT_OK(status);                                                                                       \
-    break;                                                                                                             \
-  }
+#include <algorithm>
 
-template <typename BuilderType, typename ValueType>
-arrow::Status int_builder_case(arrow::ArrayBuilder* array_builder, sqlite3_stmt* stmt, int col) {
-  auto builder = reinterpret_cast<BuilderType*>(array_builder);
-  const sqlite3_int64 value = sqlite3_column_int64(stmt, col);
-  return builder->Append(static_cast<ValueType>(value));
-}
-
-template <typename BuilderType>
-arrow::Status float_builder_case(arrow::ArrayBuilder* array_builder, sqlite3_stmt* stmt, int col) {
-  auto builder = reinterpret_cast<BuilderType*>(array_builder);
-  const double value = sqlite3_column_double(stmt, col);
-  return builder->Append(static_cast<typename BuilderType::value_type>(value));
-}
-
-template <typename BuilderType>
-arrow::Status string_builder_case(arrow::ArrayBuilder* array_builder, sqlite3_stmt* stmt, int col) {
-  auto builder = reinterpret_cast<BuilderType*>(array_builder);
-  const uint8_t* string = reinterpret_cast<const uint8_t*>(sqlite3_column_text(stmt, col));
-  if (string == nullptr) {
-    return builder->AppendNull();
-  }
-  const int bytes = sqlite3_column_bytes(stmt, col);
-  return builder->Append(string, bytes);
+namespace arrow_sql_bridge {
+arrow::Result<std::shared_ptr<statement_batch_reader>> statement_batch_reader::make(
+    const std::shared_ptr<arrow_sql_bridge::statement>& statement,
+    const batch_limits& limits,
+    std::shared_ptr<arrow::MemoryPool> pool
+) {
+  return make(statement, {}, limits, std::move(pool));
 }
 
-template <typename BuilderType>
-arrow::Status binary_builder_case(arrow::ArrayBuilder* array_builder, sqlite3_stmt* stmt, int col) {
-  auto builder = reinterpret_cast<BuilderType*>(array_builder);
-  const uint8_t* blob = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
-  if (blob == nullptr) {
-    return builder->AppendNull();
+arrow::Result<std::shared_ptr<statement_batch_reader>> statement_batch_reader::make(
+    const std::shared_ptr<arrow_sql_bridge::statement>& statement,
+    std::vector<std::shared_ptr<arrow::RecordBatch>> parameters,
+    const batch_limits& limits,
+    std::shared_ptr<arrow::MemoryPool> pool
+) {
+  if (limits.max_rows <= 0 || limits.target_bytes <= 0) {
+    return arrow::Status::Invalid("Batch limits must be positive");
   }
-  const int bytes = sqlite3_column_bytes(stmt, col);
-  return builder->Append(blob, bytes);
-}
 
-namespace arrow_sql_bridge {
-static constexpr int32_t kMaxBatchSize = 16384;
-
-arrow::Result<std::shared_ptr<statement_batch_reader>>
-statement_batch_reader::make(const std::shared_ptr<arrow_sql_bridge::statement>& statement) {
   ARROW_RETURN_NOT_OK(statement->reset());
   ARROW_ASSIGN_OR_RAISE(auto schema, statement->get_schema());
 
+  arrow::MemoryPool* builder_pool = pool != nullptr ? pool.get() : arrow::default_memory_pool();
+  std::vector<std::unique_ptr<column_appender>> appenders(schema->num_fields());
+  for (int i = 0; i < schema->num_fields(); i++) {
+    ARROW_ASSIGN_OR_RAISE(appenders[i], column_appender::make(schema->field(i)->type(), builder_pool));
+  }
+
   try {
-    return std::shared_ptr<statement_batch_reader>(new statement_batch_reader(statement, schema));
+    return std::shared_ptr<statement_batch_reader>(new statement_batch_reader(
+        statement,
+        std::move(schema),
+        std::move(appenders),
+        std::move(parameters),
+        limits,
+        std::move(pool)
+    ));
   } catch (...) {
     std::string err_msg("Failed to create batch_reader, allocation failed");
     return arrow::Status::OutOfMemory(err_msg);
@@ -89,61 +53,74 @@ arrow::Status statement_batch_reader::ReadNext(std::shared_ptr<arrow::RecordBatc
   sqlite3_stmt* sqlite3_stmt = stmt_ptr->get_sqlite3_statement();
   const int num_fields = schema_ptr->num_fields();
 
-  std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders(num_fields);
-  for (int i = 0; i < num_fields; i++) {
-    const std::shared_ptr<arrow::Field>& field = schema_ptr->field(i);
-    const std::shared_ptr<arrow::DataType>& field_type = field->type();
-
-    ARROW_RETURN_NOT_OK(MakeBuilder(arrow::default_memory_pool(), field_type, &builders[i]));
-  }
-
   int64_t rows = 0;
   if (!is_executed) {
     ARROW_ASSIGN_OR_RAISE(rc, stmt_ptr->reset());
-    ARROW_ASSIGN_OR_RAISE(rc, stmt_ptr->step());
+    // With parameters the first set is bound by the loop below, as for every following one
+    if (parameters.empty()) {
+      ARROW_ASSIGN_OR_RAISE(rc, stmt_ptr->step());
+    } else {
+      rc = SQLITE_DONE;
+    }
     is_executed = true;
   }
 
-  while (rows < kMaxBatchSize && rc == SQLITE_ROW) {
-    rows++;
-    for (int i = 0; i < num_fields; i++) {
-      const std::shared_ptr<arrow::Field>& field = schema_ptr->field(i);
-      const std::shared_ptr<arrow::DataType>& field_type = field->type();
-      auto array_builder = builders[i].get();
+  int64_t max_rows = limits.max_rows;
+  if (is_first_batch && limits.first_batch_rows > 0) {
+    max_rows = std::min(max_rows, limits.first_batch_rows);
+  }
+  // Fixed-width columns alone already bound the rows that fit the byte target
+  if (fixed_row_bytes > 0) {
+    max_rows = std::min(max_rows, std::max<int64_t>(limits.target_bytes / fixed_row_bytes, 1));
+  }
 
-      if (sqlite3_column_type(sqlite3_stmt, i) == SQLITE_NULL) {
-        ARROW_RETURN_NOT_OK(array_builder->AppendNull());
-        continue;
-      }
+  // With variable-width columns the byte target usually ends the batch first, at about the average
+  // row size of the previous batch. That follows rows that widen or narrow over the scan, where an
+  // average over the whole scan would lag behind. The eighth on top covers rows that come out a
+  // little narrower, and the row that crosses the target.
+  int64_t expected_rows = max_rows;
+  if (!variable_width_columns.empty() && last_batch_rows > 0) {
+    const int64_t row_bytes = std::max<int64_t>(last_batch_bytes / last_batch_rows, 1);
+    expected_rows = std::min(max_rows, (limits.target_bytes / row_bytes + 1) * 9 / 8);
+  }
+
+  if (rc == SQLITE_ROW || has_more_parameters()) {
+    for (const auto& appender : appenders) {
+      ARROW_RETURN_NOT_OK(appender->reserve(expected_rows));
+    }
+  }
 
-      switch (field_type->id()) {
-        INT_BUILDER_CASE(Int64, sqlite3_stmt, i)
-        INT_BUILDER_CASE(UInt64, sqlite3_stmt, i)
-        INT_BUILDER_CASE(Int32, sqlite3_stmt, i)
-        INT_BUILDER_CASE(UInt32, sqlite3_stmt, i)
-        INT_BUILDER_CASE(Int16, sqlite3_stmt, i)
-        INT_BUILDER_CASE(UInt16, sqlite3_stmt, i)
-        INT_BUILDER_CASE(Int8, sqlite3_stmt, i)
-        INT_BUILDER_CASE(UInt8, sqlite3_stmt, i)
-        FLOAT_BUILDER_CASE(Double, sqlite3_stmt, i)
-        FLOAT_BUILDER_CASE(Float, sqlite3_stmt, i)
-        FLOAT_BUILDER_CASE(HalfFloat, sqlite3_stmt, i)
-        BINARY_BUILDER_CASE(Binary, sqlite3_stmt, i)
-        BINARY_BUILDER_CASE(LargeBinary, sqlite3_stmt, i)
-        STRING_BUILDER_CASE(String, sqlite3_stmt, i)
-        STRING_BUILDER_CASE(LargeString, sqlite3_stmt, i)
-      default:
-        return arrow::Status::NotImplemented("Not implemented SQLite data conversion to ", field_type->name());
+  while (rows < max_rows) {
+    if (rc == SQLITE_DONE) {
+      ARROW_RETURN_NOT_OK(stmt_ptr->reset());
+      ARROW_ASSIGN_OR_RAISE(bool bound, bind_next_parameters());
+      if (!bound) {
+        break;
       }
+      ARROW_ASSIGN_OR_RAISE(rc, stmt_ptr->step());
+      continue;
+    }
+
+    rows++;
+    for (int i = 0; i < num_fields; i++) {
+      ARROW_RETURN_NOT_OK(appenders[i]->append(sqlite3_stmt, i));
     }
 
     ARROW_ASSIGN_OR_RAISE(rc, stmt_ptr->step());
+    if (!variable_width_columns.empty() && batch_bytes(rows) >= limits.target_bytes) {
+      break;
+    }
   }
 
   if (rows > 0) {
-    std::vector<std::shared_ptr<arrow::Array>> columns(builders.size());
+    is_first_batch = false;
+    last_batch_rows = rows;
+    if (!variable_width_columns.empty()) {
+      last_batch_bytes = batch_bytes(rows);
+    }
+    std::vector<std::shared_ptr<arrow::Array>> columns(num_fields);
     for (int i = 0; i < num_fields; i++) {
-      ARROW_RETURN_NOT_OK(builders[i]->Finish(&columns[i]));
+      ARROW_ASSIGN_OR_RAISE(columns[i], appenders[i]->finish());
     }
 
     *out = arrow::RecordBatch::Make(schema_ptr, rows, columns);
@@ -154,10 +131,65 @@ arrow::Status statement_batch_reader::ReadNext(std::shared_ptr<arrow::RecordBatc
   return arrow::Status::OK();
 }
 
+int64_t statement_batch_reader::batch_bytes(int64_t rows) const {
+  int64_t bytes = rows * fixed_row_bytes;
+  for (int i : variable_width_columns) {
+    bytes += appenders[i]->bytes();
+  }
+  return bytes;
+}
+
+bool statement_batch_reader::has_more_parameters() const {
+  for (size_t i = parameter_batch; i < parameters.size(); i++) {
+    if ((i == parameter_batch ? parameter_row : 0) < parameters[i]->num_rows()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+arrow::Result<bool> statement_batch_reader::bind_next_parameters() {
+  while (parameter_batch < parameters.size() && parameter_row >= parameters[parameter_batch]->num_rows()) {
+    parameter_batch++;
+    parameter_row = 0;
+    binder.reset();
+  }
+  if (parameter_batch == parameters.size()) {
+    return false;
+  }
+
+  const arrow::RecordBatch& batch = *parameters[parameter_batch];
+  sqlite3_stmt* sqlite3_stmt = stmt_ptr->get_sqlite3_statement();
+  if (!binder.has_value()) {
+    ARROW_ASSIGN_OR_RAISE(binder, parameter_binder::make(*batch.schema(), sqlite3_stmt));
+  }
+  ARROW_RETURN_NOT_OK(binder->bind(sqlite3_stmt, batch, parameter_row++));
+  return true;
+}
+
 statement_batch_reader::statement_batch_reader(
     std::shared_ptr<statement> statement,
-    std::shared_ptr<arrow::Schema> schema
+    std::shared_ptr<arrow::Schema> schema,
+    std::vector<std::unique_ptr<column_appender>> appenders,
+    std::vector<std::shared_ptr<arrow::RecordBatch>> parameters,
+    const batch_limits& limits,
+    std::shared_ptr<arrow::MemoryPool> pool
 )
-    : stmt_ptr(std::move(statement))
-    , schema_ptr(std::move(schema)) {}
+    : limits(limits)
+    , pool(std::move(pool))
+    , stmt_ptr(std::move(statement))
+    , schema_ptr(std::move(schema))
+    , appenders(std::move(appenders))
+    , parameters(std::move(parameters)) {
+  for (int i = 0; i < schema_ptr->num_fields(); i++) {
+    const auto& type = schema_ptr->field(i)->type();
+    // Dictionary indices are fixed-width, but each batch carries the values it added to its dictionary
+    if (arrow::is_fixed_width(type->id()) && type->id() != arrow::Type::DICTIONARY) {
+      // Booleans are single bits, a row still adds to the batch
+      fixed_row_bytes += (static_cast<const arrow::FixedWidthType&>(*type).bit_width() + 7) / 8;
+    } else {
+      variable_width_columns.push_back(i);
+    }
+  }
+}
 } // namespace arrow_sql_bridge
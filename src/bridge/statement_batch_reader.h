@@ -2,16 +2,33 @@
 
 #include "arrow/builder.h"
 #include "arrow/record_batch.h"
+#include "column_appender.h"
+#include "parameter_binder.h"
+#include "server_options.h"
 #include "sqlite3.h"
 #include "statement.h"
 
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace arrow_sql_bridge {
 class statement_batch_reader : public arrow::RecordBatchReader {
 public:
-  static arrow::Result<std::shared_ptr<statement_batch_reader>>
-  make(const std::shared_ptr<arrow_sql_bridge::statement>& statement);
+  // Builds the batches in `pool`, or in Arrow's default pool when it is null
+  static arrow::Result<std::shared_ptr<statement_batch_reader>> make(
+      const std::shared_ptr<arrow_sql_bridge::statement>& statement,
+      const batch_limits& limits = batch_limits(),
+      std::shared_ptr<arrow::MemoryPool> pool = nullptr
+  );
+
+  // Runs the statement once per parameter row and concatenates the results
+  static arrow::Result<std::shared_ptr<statement_batch_reader>> make(
+      const std::shared_ptr<arrow_sql_bridge::statement>& statement,
+      std::vector<std::shared_ptr<arrow::RecordBatch>> parameters,
+      const batch_limits& limits = batch_limits(),
+      std::shared_ptr<arrow::MemoryPool> pool = nullptr
+  );
 
   std::shared_ptr<arrow::Schema> schema() const override;
 
@@ -19,11 +36,41 @@ public:
 
 private:
   bool is_executed = false;
+  bool is_first_batch = true;
   int rc = SQLITE_OK;
 
+  batch_limits limits;
+  // Bytes every row adds through its fixed-width columns. The others, dictionaries included, are
+  // asked as they fill.
+  int64_t fixed_row_bytes = 0;
+  std::vector<int> variable_width_columns;
+  // The previous batch, sizes the buffers of the next one
+  int64_t last_batch_rows = 0;
+  int64_t last_batch_bytes = 0;
+
+  std::shared_ptr<arrow::MemoryPool> pool;
   std::shared_ptr<statement> stmt_ptr;
   std::shared_ptr<arrow::Schema> schema_ptr;
+  std::vector<std::unique_ptr<column_appender>> appenders;
+
+  std::vector<std::shared_ptr<arrow::RecordBatch>> parameters;
+  size_t parameter_batch = 0;
+  int64_t parameter_row = 0;
+  std::optional<parameter_binder> binder;
+
+  bool has_more_parameters() const;
+
+  arrow::Result<bool> bind_next_parameters();
+
+  int64_t batch_bytes(int64_t rows) const;
 
-  statement_batch_reader(std::shared_ptr<statement> statement, std::shared_ptr<arrow::Schema> schema);
+  statement_batch_reader(
+      std::shared_ptr<statement> statement,
+      std::shared_ptr<arrow::Schema> schema,
+      std::vector<std::unique_ptr<column_appender>> appenders,
+      std::vector<std::shared_ptr<arrow::RecordBatch>> parameters,
+      const batch_limits& limits,
+      std::shared_ptr<arrow::MemoryPool> pool
+  );
 };
 } // namespace arrow_sql_bridge
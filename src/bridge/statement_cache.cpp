@@ -0,0 +1,113 @@
+#include "statement_cache.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace arrow_sql_bridge {
+std::string normalize_sql(const std::string& sql) {
+  std::string result;
+  result.reserve(sql.size());
+
+  char quote = 0;
+  bool pending_space = false;
+  for (size_t i = 0; i < sql.size(); i++) {
+    const char c = sql[i];
+    if (quote != 0) {
+      result.push_back(c);
+      if (c == quote) {
+        quote = 0;
+      }
+      continue;
+    }
+
+    // Comments count as whitespace, so text that only looks alike once joined never shares a key
+    if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+      i = std::min(sql.find('\n', i), sql.size());
+      pending_space = !result.empty();
+      continue;
+    } else if (c == '/' && i + 1 < sql.size() && sql[i + 1] == '*') {
+      const size_t end = sql.find("*/", i + 2);
+      i = end == std::string::npos ? sql.size() : end + 1;
+      pending_space = !result.empty();
+      continue;
+    }
+
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      pending_space = !result.empty();
+      continue;
+    }
+
+    if (pending_space) {
+      result.push_back(' ');
+      pending_space = false;
+    }
+    if (c == '\'' || c == '"' || c == '`') {
+      quote = c;
+    } else if (c == '[') {
+      quote = ']';
+    }
+    result.push_back(c);
+  }
+
+  while (!result.empty() && (result.back() == ';' || result.back() == ' ')) {
+    result.pop_back();
+  }
+  return result;
+}
+
+sqlite3_stmt* statement_cache::take(const std::string& key) {
+  auto it = index.find(key);
+  if (it == index.end()) {
+    misses++;
+    return nullptr;
+  }
+
+  hits++;
+  sqlite3_stmt* stmt = it->second->second;
+  lru.erase(it->second);
+  index.erase(it);
+  return stmt;
+}
+
+void statement_cache::put(const std::string& key, sqlite3_stmt* stmt) {
+  if (stmt == nullptr) {
+    return;
+  }
+
+  // Resetting right away also ends the statement's read transaction
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  if (capacity == 0 || index.count(key) != 0) {
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  lru.emplace_front(key, stmt);
+  index[key] = lru.begin();
+
+  while (lru.size() > capacity) {
+    auto& [evicted_key, evicted_stmt] = lru.back();
+    sqlite3_finalize(evicted_stmt);
+    index.erase(evicted_key);
+    lru.pop_back();
+    evictions++;
+  }
+}
+
+void statement_cache::clear() {
+  for (auto& [key, stmt] : lru) {
+    sqlite3_finalize(stmt);
+  }
+  lru.clear();
+  index.clear();
+}
+
+statement_cache_stats statement_cache::stats() const {
+  return statement_cache_stats{hits.load(), misses.load(), evictions.load()};
+}
+
+statement_cache::~statement_cache() noexcept {
+  clear();
+}
+} // namespace arrow_sql_bridge
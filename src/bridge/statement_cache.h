@@ -0,0 +1,57 @@
+#pragma once
+
+#include "sqlite3.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace arrow_sql_bridge {
+struct statement_cache_stats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+// Collapses whitespace and comments outside of quoted literals and identifiers and drops
+// trailing semicolons, so that formatting differences map to the same cache entry. The result
+// is only a key, statements are always prepared from the text the client sent.
+std::string normalize_sql(const std::string& sql);
+
+// LRU cache of prepared statements belonging to one connection. A statement is
+// checked out with take() and stays out of the cache while in use, then comes
+// back through put(), which resets it and clears its bindings.
+class statement_cache {
+public:
+  explicit statement_cache(size_t capacity)
+      : capacity(capacity) {}
+
+  statement_cache(const statement_cache&) = delete;
+
+  statement_cache& operator=(const statement_cache&) = delete;
+
+  // Returns nullptr on a miss; the caller prepares the statement itself.
+  sqlite3_stmt* take(const std::string& key);
+
+  void put(const std::string& key, sqlite3_stmt* stmt);
+
+  void clear();
+
+  statement_cache_stats stats() const;
+
+  ~statement_cache() noexcept;
+
+private:
+  using lru_list = std::list<std::pair<std::string, sqlite3_stmt*>>;
+
+  size_t capacity;
+  lru_list lru; // most recently used first
+  std::unordered_map<std::string, lru_list::iterator> index;
+
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> evictions{0};
+};
+} // namespace arrow_sql_bridge
@@ -1,3 +1,4 @@
+#include "arrow/pretty_print.h"
 #include "client/client.h"
 
 #include <boost/program_options.hpp>
@@ -6,6 +7,28 @@
 
 namespace po = boost::program_options;
 
+// Prints batches as they arrive, so only a few of them are held in memory at a time
+arrow::Status print_sql_query(const std::string& host, int port, const std::string& query) {
+  ARROW_ASSIGN_OR_RAISE(auto reader, execute_sql_query_stream(host, port, query));
+  std::cout << "Schema:" << std::endl;
+  std::cout << reader->schema()->ToString() << std::endl;
+
+  int64_t total_rows = 0;
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ARROW_RETURN_NOT_OK(reader->ReadNext(&batch));
+    if (!batch) {
+      break;
+    }
+
+    ARROW_RETURN_NOT_OK(arrow::PrettyPrint(*batch, 0, &std::cout));
+    total_rows += batch->num_rows();
+  }
+
+  std::cout << "Total rows: " << total_rows << std::endl;
+  return arrow::Status::OK();
+}
+
 int main(int argc, char** argv) {
   po::options_description desc("Allowed options");
   desc.add_options()
@@ -33,9 +56,9 @@ int main(int argc, char** argv) {
       return 1;
     }
 
-    auto st = execute_sql_query(host, port, query, true);
+    auto st = print_sql_query(host, port, query);
     if (!st.ok()) {
-      std::cerr << "Error: " << st.status().ToString() << std::endl;
+      std::cerr << "Error: " << st.ToString() << std::endl;
       return 1;
     }
   } catch (const po::error& e) {
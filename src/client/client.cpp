@@ -1,60 +1,118 @@
 #include "client.h"
 
+#include "result_stream_reader.h"
+
 #include <iostream>
 
 namespace flight = arrow::flight;
 
-arrow::Result<std::shared_ptr<arrow::Table>>
-execute_sql_query(const std::string& host, int port, const std::string& query, bool stdout_results) {
-  ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(host, port));
-  flight::FlightClientOptions options;
-  ARROW_ASSIGN_OR_RAISE(auto client, flight::FlightClient::Connect(location, options));
-
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> execute_sql_query_stream(
+    const std::shared_ptr<client_pool>& pool,
+    const flight::Location& location,
+    const std::string& query,
+    const client_options& options
+) {
   flight::FlightCallOptions call_options;
-  flight::sql::FlightSqlClient sql_client(std::move(client));
-  ARROW_ASSIGN_OR_RAISE(auto info, sql_client.Execute(call_options, query));
+  ARROW_ASSIGN_OR_RAISE(auto client, pool->get(location));
+  auto info = client->Execute(call_options, query);
+  // A pooled channel may have gone stale since its last health check. GetFlightInfo only
+  // plans the query, so it is safe to retry once on a freshly dialed channel.
+  if (info.status().IsIOError()) {
+    pool->invalidate(location);
+    ARROW_ASSIGN_OR_RAISE(client, pool->get(location));
+    info = client->Execute(call_options, query);
+  }
+  ARROW_RETURN_NOT_OK(info.status());
 
-  const auto& endpoints = info->endpoints();
-  std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
-  std::shared_ptr<arrow::Schema> schema;
+  auto clients = std::make_unique<endpoint_clients>(pool, location, std::move(client));
+  ARROW_ASSIGN_OR_RAISE(
+      auto reader,
+      result_stream_reader::make(std::move(clients), std::move(info).ValueOrDie(), options)
+  );
+  return reader;
+}
 
-  for (const auto& endpoint : endpoints) {
-    ARROW_ASSIGN_OR_RAISE(auto stream, sql_client.DoGet(call_options, endpoint.ticket));
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> execute_sql_query_stream(
+    const std::string& host,
+    int port,
+    const std::string& query,
+    const client_options& options
+) {
+  ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(host, port));
+  return execute_sql_query_stream(default_client_pool(), location, query, options);
+}
 
-    ARROW_ASSIGN_OR_RAISE(schema, stream->GetSchema());
+arrow::Result<std::shared_ptr<arrow::Schema>> get_sql_query_schema(
+    const std::shared_ptr<client_pool>& pool,
+    const flight::Location& location,
+    const std::string& query
+) {
+  flight::FlightCallOptions call_options;
+  ARROW_ASSIGN_OR_RAISE(auto client, pool->get(location));
+  auto result = client->GetExecuteSchema(call_options, query);
+  // Planning only, as safe to retry on a fresh channel as Execute above
+  if (result.status().IsIOError()) {
+    pool->invalidate(location);
+    ARROW_ASSIGN_OR_RAISE(client, pool->get(location));
+    result = client->GetExecuteSchema(call_options, query);
+  }
+  ARROW_RETURN_NOT_OK(result.status());
 
-    if (stdout_results) {
-      std::cout << "Results from endpoint " << &endpoint - &endpoints[0] + 1 << " of " << endpoints.size() << std::endl;
-      std::cout << "Schema:" << std::endl;
-      std::cout << schema->ToString() << std::endl;
-    }
+  arrow::ipc::DictionaryMemo memo;
+  return result.ValueOrDie()->GetSchema(&memo);
+}
 
-    while (true) {
-      ARROW_ASSIGN_OR_RAISE(flight::FlightStreamChunk chunk, stream->Next());
-      if (!chunk.data) {
-        break;
-      }
+arrow::Result<std::shared_ptr<arrow::Schema>>
+get_sql_query_schema(const std::string& host, int port, const std::string& query) {
+  ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(host, port));
+  return get_sql_query_schema(default_client_pool(), location, query);
+}
 
-      if (stdout_results) {
-        std::cout << chunk.data->ToString();
-      }
+arrow::Result<std::shared_ptr<arrow::Table>> read_all(arrow::RecordBatchReader& reader, bool stdout_results) {
+  if (stdout_results) {
+    std::cout << "Schema:" << std::endl;
+    std::cout << reader.schema()->ToString() << std::endl;
+  }
 
-      batches.push_back(chunk.data);
+  std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+  int64_t total_rows = 0;
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ARROW_RETURN_NOT_OK(reader.ReadNext(&batch));
+    if (!batch) {
+      break;
     }
 
     if (stdout_results) {
-      int64_t total_rows = 0;
-      for (const auto& batch : batches) {
-        total_rows += batch->num_rows();
-      }
-      std::cout << "Total rows: " << total_rows << std::endl;
+      std::cout << batch->ToString();
     }
+    total_rows += batch->num_rows();
+    batches.push_back(std::move(batch));
   }
 
-  if (batches.empty()) {
-    return arrow::Table::MakeEmpty(schema);
+  if (stdout_results) {
+    std::cout << "Total rows: " << total_rows << std::endl;
   }
+  return arrow::Table::FromRecordBatches(reader.schema(), batches);
+}
+
+arrow::Result<std::shared_ptr<arrow::Table>> execute_sql_query(
+    const std::shared_ptr<client_pool>& pool,
+    const flight::Location& location,
+    const std::string& query,
+    const client_options& options
+) {
+  ARROW_ASSIGN_OR_RAISE(auto reader, execute_sql_query_stream(pool, location, query, options));
+  return read_all(*reader, false);
+}
 
-  ARROW_ASSIGN_OR_RAISE(auto table, arrow::Table::FromRecordBatches(batches));
-  return table;
+arrow::Result<std::shared_ptr<arrow::Table>> execute_sql_query(
+    const std::string& host,
+    int port,
+    const std::string& query,
+    bool stdout_results,
+    const client_options& options
+) {
+  ARROW_ASSIGN_OR_RAISE(auto reader, execute_sql_query_stream(host, port, query, options));
+  return read_all(*reader, stdout_results);
 }
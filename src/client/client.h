@@ -1,12 +1,53 @@
 #pragma once
 
 #include "arrow/flight/sql/api.h"
+#include "arrow/record_batch.h"
 #include "arrow/result.h"
 #include "arrow/status.h"
 #include "arrow/table.h"
+#include "client_options.h"
+#include "client_pool.h"
 
 #include <memory>
 #include <string>
 
-arrow::Result<std::shared_ptr<arrow::Table>>
-execute_sql_query(const std::string& host, int port, const std::string& query, bool stdout_results = false);
+// Runs the query and streams the batches of all its endpoints as they arrive
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> execute_sql_query_stream(
+    const std::shared_ptr<client_pool>& pool,
+    const arrow::flight::Location& location,
+    const std::string& query,
+    const client_options& options = client_options()
+);
+
+arrow::Result<std::shared_ptr<arrow::Table>> execute_sql_query(
+    const std::shared_ptr<client_pool>& pool,
+    const arrow::flight::Location& location,
+    const std::string& query,
+    const client_options& options = client_options()
+);
+
+// Result schema of the query, planned by the server without running it
+arrow::Result<std::shared_ptr<arrow::Schema>> get_sql_query_schema(
+    const std::shared_ptr<client_pool>& pool,
+    const arrow::flight::Location& location,
+    const std::string& query
+);
+
+// Same as above over the process-wide default_client_pool()
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> execute_sql_query_stream(
+    const std::string& host,
+    int port,
+    const std::string& query,
+    const client_options& options = client_options()
+);
+
+arrow::Result<std::shared_ptr<arrow::Schema>>
+get_sql_query_schema(const std::string& host, int port, const std::string& query);
+
+arrow::Result<std::shared_ptr<arrow::Table>> execute_sql_query(
+    const std::string& host,
+    int port,
+    const std::string& query,
+    bool stdout_results = false,
+    const client_options& options = client_options()
+);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+struct client_options {
+  // Endpoints of one result that are pulled at the same time
+  size_t max_parallel_fetches = 4;
+
+  // Keep endpoint order when the server marks the result as ordered. Otherwise batches
+  // are returned in the order their endpoints finish.
+  bool respect_ordered = true;
+
+  // Batches buffered per stream before the fetching threads wait for the reader
+  size_t max_buffered_batches = 8;
+
+  // Limits of the record batches the server cuts the result into, sent along with every DoGet.
+  // 0 leaves the limit to the server.
+  size_t batch_max_rows = 0;
+  size_t batch_target_bytes = 0;
+
+  // HTTP/2 keepalive pings on pooled channels, so idle connections survive middleboxes
+  // and dead peers are noticed without waiting for the next query.
+  std::chrono::milliseconds keepalive_time{30000};
+  std::chrono::milliseconds keepalive_timeout{10000};
+
+  // A pooled client idle for longer than this is probed before it is handed out again.
+  std::chrono::milliseconds health_check_interval{1000};
+  std::chrono::milliseconds health_check_timeout{2000};
+};
@@ -0,0 +1,85 @@
+#include "client_pool.h"
+
+namespace flight = arrow::flight;
+
+arrow::Result<std::shared_ptr<client_pool>> client_pool::make(const client_options& options) {
+  try {
+    return std::shared_ptr<client_pool>(new client_pool(options));
+  } catch (...) {
+    std::string err_msg("Failed to create client_pool, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+}
+
+arrow::Result<std::shared_ptr<flight::sql::FlightSqlClient>> client_pool::get(const flight::Location& location) {
+  const std::string key = location.ToString();
+  std::optional<entry> pooled;
+  {
+    std::lock_guard lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      pooled = it->second;
+      it->second.last_used = clock::now();
+    }
+  }
+
+  // The probe runs outside the lock, other locations must not wait on a slow peer
+  if (pooled.has_value() && clock::now() - pooled->last_used < options.health_check_interval) {
+    return pooled->sql_client;
+  }
+  if (pooled.has_value() && is_healthy(*pooled)) {
+    return pooled->sql_client;
+  }
+
+  ARROW_ASSIGN_OR_RAISE(entry dialed, connect(location));
+  std::lock_guard lock(mutex);
+  auto it = entries.find(key);
+  // Another caller may have re-dialed in the meantime, keep a single channel per location
+  if (it != entries.end() && (!pooled.has_value() || it->second.flight_client != pooled->flight_client)) {
+    return it->second.sql_client;
+  }
+  entries[key] = dialed;
+  return dialed.sql_client;
+}
+
+void client_pool::invalidate(const flight::Location& location) {
+  std::lock_guard lock(mutex);
+  entries.erase(location.ToString());
+}
+
+size_t client_pool::size() {
+  std::lock_guard lock(mutex);
+  return entries.size();
+}
+
+client_pool::client_pool(const client_options& options)
+    : options(options) {}
+
+arrow::Result<client_pool::entry> client_pool::connect(const flight::Location& location) const {
+  flight::FlightClientOptions client_options;
+  client_options.generic_options.emplace_back(
+      "grpc.keepalive_time_ms",
+      static_cast<int>(options.keepalive_time.count())
+  );
+  client_options.generic_options.emplace_back(
+      "grpc.keepalive_timeout_ms",
+      static_cast<int>(options.keepalive_timeout.count())
+  );
+  client_options.generic_options.emplace_back("grpc.keepalive_permit_without_calls", 1);
+  client_options.generic_options.emplace_back("grpc.http2.max_pings_without_data", 0);
+
+  ARROW_ASSIGN_OR_RAISE(auto client, flight::FlightClient::Connect(location, client_options));
+  std::shared_ptr<flight::FlightClient> flight_client = std::move(client);
+  return entry{flight_client, std::make_shared<flight::sql::FlightSqlClient>(flight_client), clock::now()};
+}
+
+bool client_pool::is_healthy(const entry& entry) const {
+  flight::FlightCallOptions call_options;
+  call_options.timeout = std::chrono::duration<double>(options.health_check_timeout);
+  return entry.flight_client->ListActions(call_options).ok();
+}
+
+std::shared_ptr<client_pool> default_client_pool() {
+  static std::shared_ptr<client_pool> pool = client_pool::make().ValueOrDie();
+  return pool;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "arrow/flight/sql/client.h"
+#include "arrow/result.h"
+#include "client_options.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Long-lived Flight SQL clients keyed by location. A client wraps one gRPC channel,
+// which multiplexes concurrent calls, so every caller for a location shares it.
+// Channels are dialed with keepalive on first use; a client that sat idle past the
+// health check interval is probed and re-dialed if the probe fails.
+class client_pool {
+public:
+  static arrow::Result<std::shared_ptr<client_pool>> make(const client_options& options = client_options());
+
+  arrow::Result<std::shared_ptr<arrow::flight::sql::FlightSqlClient>> get(const arrow::flight::Location& location);
+
+  // Drops the client of a location after a failed call, the next get() dials again
+  void invalidate(const arrow::flight::Location& location);
+
+  size_t size();
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct entry {
+    std::shared_ptr<arrow::flight::FlightClient> flight_client;
+    std::shared_ptr<arrow::flight::sql::FlightSqlClient> sql_client;
+    clock::time_point last_used;
+  };
+
+  client_options options;
+  std::mutex mutex;
+  std::unordered_map<std::string, entry> entries;
+
+  explicit client_pool(const client_options& options);
+
+  arrow::Result<entry> connect(const arrow::flight::Location& location) const;
+
+  bool is_healthy(const entry& entry) const;
+};
+
+// Process-wide pool used by the execute_sql_query helpers
+std::shared_ptr<client_pool> default_client_pool();
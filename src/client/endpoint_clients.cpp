@@ -0,0 +1,30 @@
+#include "endpoint_clients.h"
+
+namespace flight = arrow::flight;
+
+endpoint_clients::endpoint_clients(
+    std::shared_ptr<client_pool> pool,
+    flight::Location origin_location,
+    std::shared_ptr<flight::sql::FlightSqlClient> origin
+)
+    : pool(std::move(pool))
+    , origin_location(std::move(origin_location))
+    , origin(std::move(origin)) {}
+
+flight::sql::FlightSqlClient& endpoint_clients::get_origin() {
+  return *origin;
+}
+
+arrow::Result<std::shared_ptr<flight::sql::FlightSqlClient>>
+endpoint_clients::get(const flight::FlightEndpoint& endpoint) {
+  if (endpoint.locations.empty()) {
+    return origin;
+  }
+  return pool->get(endpoint.locations.front());
+}
+
+void endpoint_clients::report_failure(const flight::FlightEndpoint& endpoint, const arrow::Status& status) {
+  if (status.IsIOError()) {
+    pool->invalidate(endpoint.locations.empty() ? origin_location : endpoint.locations.front());
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "arrow/flight/sql/client.h"
+#include "arrow/result.h"
+#include "client_pool.h"
+
+#include <memory>
+
+// Resolves the client for each endpoint of one query. Endpoints without a location are
+// served by the origin, the service the query was sent to; others by the pooled client
+// of their first location.
+class endpoint_clients {
+public:
+  endpoint_clients(
+      std::shared_ptr<client_pool> pool,
+      arrow::flight::Location origin_location,
+      std::shared_ptr<arrow::flight::sql::FlightSqlClient> origin
+  );
+
+  arrow::flight::sql::FlightSqlClient& get_origin();
+
+  arrow::Result<std::shared_ptr<arrow::flight::sql::FlightSqlClient>>
+  get(const arrow::flight::FlightEndpoint& endpoint);
+
+  // Transport failures drop the pooled client, so the next query dials a fresh channel
+  void report_failure(const arrow::flight::FlightEndpoint& endpoint, const arrow::Status& status);
+
+private:
+  std::shared_ptr<client_pool> pool;
+  arrow::flight::Location origin_location;
+  std::shared_ptr<arrow::flight::sql::FlightSqlClient> origin;
+};
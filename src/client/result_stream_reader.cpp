@@ -0,0 +1,160 @@
+#include "result_stream_reader.h"
+
+#include <algorithm>
+
+namespace flight = arrow::flight;
+
+arrow::Result<std::shared_ptr<result_stream_reader>> result_stream_reader::make(
+    std::unique_ptr<endpoint_clients> clients,
+    std::unique_ptr<flight::FlightInfo> info,
+    const client_options& options
+) {
+  arrow::ipc::DictionaryMemo memo;
+  ARROW_ASSIGN_OR_RAISE(auto schema, info->GetSchema(&memo));
+  const size_t endpoint_count = info->endpoints().size();
+
+  std::shared_ptr<result_stream_reader> reader;
+  try {
+    reader = std::shared_ptr<result_stream_reader>(
+        new result_stream_reader(std::move(clients), std::move(info), std::move(schema), options)
+    );
+  } catch (...) {
+    std::string err_msg("Failed to create result_stream_reader, allocation failed");
+    return arrow::Status::OutOfMemory(err_msg);
+  }
+
+  reader->start(std::min(std::max<size_t>(options.max_parallel_fetches, 1), endpoint_count));
+  return reader;
+}
+
+std::shared_ptr<arrow::Schema> result_stream_reader::schema() const {
+  return schema_ptr;
+}
+
+arrow::Status result_stream_reader::ReadNext(std::shared_ptr<arrow::RecordBatch>* out) {
+  std::unique_lock lock(mutex);
+  const size_t endpoint_count = finished.size();
+  while (true) {
+    ARROW_RETURN_NOT_OK(status);
+    if (cancelled) {
+      return arrow::Status::Cancelled("Result stream was closed");
+    }
+
+    if (keep_order) {
+      while (current < endpoint_count && finished[current] && queues[current].empty()) {
+        current++;
+      }
+    }
+    const bool exhausted = keep_order ? current == endpoint_count
+                                      : finished_count == endpoint_count && queues.front().empty();
+    if (exhausted) {
+      *out = nullptr;
+      return arrow::Status::OK();
+    }
+
+    auto& queue = queues[keep_order ? current : 0];
+    if (!queue.empty()) {
+      *out = std::move(queue.front());
+      queue.pop_front();
+      batch_taken.notify_all();
+      return arrow::Status::OK();
+    }
+    batch_added.wait(lock);
+  }
+}
+
+arrow::Status result_stream_reader::Close() {
+  {
+    std::lock_guard lock(mutex);
+    cancelled = true;
+  }
+  batch_taken.notify_all();
+  batch_added.notify_all();
+
+  for (auto& worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  return arrow::Status::OK();
+}
+
+result_stream_reader::~result_stream_reader() {
+  ARROW_UNUSED(Close());
+}
+
+result_stream_reader::result_stream_reader(
+    std::unique_ptr<endpoint_clients> clients,
+    std::unique_ptr<flight::FlightInfo> info,
+    std::shared_ptr<arrow::Schema> schema,
+    const client_options& options
+)
+    : clients(std::move(clients))
+    , info(std::move(info))
+    , schema_ptr(std::move(schema))
+    , max_buffered_batches(std::max<size_t>(options.max_buffered_batches, 1))
+    , keep_order(options.respect_ordered && this->info->ordered())
+    , queues(keep_order ? this->info->endpoints().size() : 1)
+    , finished(this->info->endpoints().size(), false) {
+  if (options.batch_max_rows > 0) {
+    headers.emplace_back("x-batch-max-rows", std::to_string(options.batch_max_rows));
+  }
+  if (options.batch_target_bytes > 0) {
+    headers.emplace_back("x-batch-target-bytes", std::to_string(options.batch_target_bytes));
+  }
+}
+
+void result_stream_reader::start(size_t thread_count) {
+  for (size_t i = 0; i < thread_count; i++) {
+    workers.emplace_back([this] { fetch_endpoints(); });
+  }
+}
+
+void result_stream_reader::fetch_endpoints() {
+  const size_t endpoint_count = finished.size();
+  for (size_t i = next_endpoint++; i < endpoint_count; i = next_endpoint++) {
+    arrow::Status fetched = fetch_endpoint(i);
+    if (!fetched.ok()) {
+      clients->report_failure(info->endpoints()[i], fetched);
+    }
+
+    std::lock_guard lock(mutex);
+    if (!fetched.ok() && !cancelled) {
+      status &= fetched;
+      // Remaining endpoints are not worth fetching
+      cancelled = true;
+    }
+    finished[i] = true;
+    finished_count++;
+    batch_added.notify_all();
+    if (cancelled) {
+      batch_taken.notify_all();
+      return;
+    }
+  }
+}
+
+arrow::Status result_stream_reader::fetch_endpoint(size_t index) {
+  const flight::FlightEndpoint& endpoint = info->endpoints()[index];
+  ARROW_ASSIGN_OR_RAISE(auto client, clients->get(endpoint));
+  flight::FlightCallOptions call_options;
+  call_options.headers = headers;
+  ARROW_ASSIGN_OR_RAISE(auto stream, client->DoGet(call_options, endpoint.ticket));
+
+  auto& queue = queues[keep_order ? index : 0];
+  while (true) {
+    ARROW_ASSIGN_OR_RAISE(flight::FlightStreamChunk chunk, stream->Next());
+    if (!chunk.data) {
+      return arrow::Status::OK();
+    }
+
+    std::unique_lock lock(mutex);
+    batch_taken.wait(lock, [&] { return cancelled || queue.size() < max_buffered_batches; });
+    if (cancelled) {
+      stream->Cancel();
+      return arrow::Status::OK();
+    }
+    queue.push_back(std::move(chunk.data));
+    batch_added.notify_all();
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "arrow/flight/sql/client.h"
+#include "arrow/record_batch.h"
+#include "client_options.h"
+#include "endpoint_clients.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Streams the batches of every endpoint of a FlightInfo. Endpoints are pulled on up to
+// max_parallel_fetches threads into queues of at most max_buffered_batches, so memory
+// stays bounded by a few batches no matter how large the result is.
+class result_stream_reader : public arrow::RecordBatchReader {
+public:
+  ~result_stream_reader() override;
+
+  static arrow::Result<std::shared_ptr<result_stream_reader>> make(
+      std::unique_ptr<endpoint_clients> clients,
+      std::unique_ptr<arrow::flight::FlightInfo> info,
+      const client_options& options
+  );
+
+  std::shared_ptr<arrow::Schema> schema() const override;
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* out) override;
+
+  // Stops the fetching threads, batches that were not read are dropped
+  arrow::Status Close() override;
+
+private:
+  std::unique_ptr<endpoint_clients> clients;
+  std::unique_ptr<arrow::flight::FlightInfo> info;
+  std::shared_ptr<arrow::Schema> schema_ptr;
+  size_t max_buffered_batches;
+  // One queue per endpoint when order matters, a single shared queue otherwise
+  bool keep_order;
+  // Batch limits requested from the server
+  std::vector<std::pair<std::string, std::string>> headers;
+
+  std::mutex mutex;
+  std::condition_variable batch_added;
+  std::condition_variable batch_taken;
+  std::vector<std::deque<std::shared_ptr<arrow::RecordBatch>>> queues;
+  std::vector<bool> finished;
+  size_t finished_count = 0;
+  size_t current = 0;
+  bool cancelled = false;
+  arrow::Status status;
+
+  std::atomic<size_t> next_endpoint{0};
+  std::vector<std::thread> workers;
+
+  result_stream_reader(
+      std::unique_ptr<endpoint_clients> clients,
+      std::unique_ptr<arrow::flight::FlightInfo> info,
+      std::shared_ptr<arrow::Schema> schema,
+      const client_options& options
+  );
+
+  void start(size_t thread_count);
+
+  void fetch_endpoints();
+
+  arrow::Status fetch_endpoint(size_t index);
+};
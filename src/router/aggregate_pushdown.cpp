@@ -0,0 +1,319 @@
+#include "aggregate_pushdown.h"
+
+#include "arrow/acero/exec_plan.h"
+#include "arrow/acero/options.h"
+#include "arrow/builder.h"
+#include "arrow/compute/api.h"
+#include "arrow/scalar.h"
+#include "sql_text.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace acero = arrow::acero;
+namespace compute = arrow::compute;
+
+std::optional<arrow_sql_router::aggregate_function> parse_function(const std::string& name) {
+  static const std::unordered_map<std::string, arrow_sql_router::aggregate_function> functions{
+      {"count", arrow_sql_router::aggregate_function::count},
+      {"sum", arrow_sql_router::aggregate_function::sum},
+      {"min", arrow_sql_router::aggregate_function::min},
+      {"max", arrow_sql_router::aggregate_function::max},
+      {"avg", arrow_sql_router::aggregate_function::avg},
+  };
+  auto it = functions.find(to_lower(trim(name)));
+  if (it == functions.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+// SUM of integers stays an integer unless some node had to fall back to floating point
+arrow::Result<std::shared_ptr<arrow::DataType>>
+common_type(const std::shared_ptr<arrow::DataType>& left, const std::shared_ptr<arrow::DataType>& right) {
+  if (left->id() == arrow::Type::NA || left->Equals(*right)) {
+    return right;
+  }
+  if (right->id() == arrow::Type::NA) {
+    return left;
+  }
+  if (arrow::is_numeric(left->id()) && arrow::is_numeric(right->id())) {
+    return arrow::float64();
+  }
+  return arrow::Status::Invalid("Partial results mix ", left->ToString(), " and ", right->ToString());
+}
+
+// Untyped expressions arrive as the bridge's dense union, turn them into a plain column
+arrow::Result<std::shared_ptr<arrow::Array>> unwrap_union(const std::shared_ptr<arrow::Array>& array) {
+  if (array->type_id() != arrow::Type::DENSE_UNION) {
+    return array;
+  }
+
+  const auto& union_array = static_cast<const arrow::DenseUnionArray&>(*array);
+  std::shared_ptr<arrow::DataType> type = arrow::null();
+  for (int64_t row = 0; row < union_array.length(); row++) {
+    const auto& child = union_array.field(union_array.child_id(row));
+    if (!child->IsNull(union_array.value_offset(row))) {
+      ARROW_ASSIGN_OR_RAISE(type, common_type(type, child->type()));
+    }
+  }
+  if (type->id() == arrow::Type::NA) {
+    return arrow::MakeArrayOfNull(arrow::null(), union_array.length());
+  }
+
+  ARROW_ASSIGN_OR_RAISE(auto builder, arrow::MakeBuilder(type));
+  ARROW_RETURN_NOT_OK(builder->Reserve(union_array.length()));
+  for (int64_t row = 0; row < union_array.length(); row++) {
+    const auto& child = union_array.field(union_array.child_id(row));
+    const int64_t offset = union_array.value_offset(row);
+    if (child->IsNull(offset)) {
+      ARROW_RETURN_NOT_OK(builder->AppendNull());
+      continue;
+    }
+    ARROW_ASSIGN_OR_RAISE(auto value, child->GetScalar(offset));
+    if (!value->type->Equals(*type)) {
+      ARROW_ASSIGN_OR_RAISE(value, value->CastTo(type));
+    }
+    ARROW_RETURN_NOT_OK(builder->AppendScalar(*value));
+  }
+  return builder->Finish();
+}
+
+// Concatenates the partial results of all nodes under one schema
+arrow::Result<std::shared_ptr<arrow::Table>>
+unify_partials(const std::vector<std::shared_ptr<arrow::Table>>& partials, size_t columns) {
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  std::vector<std::shared_ptr<arrow::ChunkedArray>> chunked_columns;
+  for (size_t i = 0; i < columns; i++) {
+    std::vector<std::shared_ptr<arrow::Array>> chunks;
+    std::shared_ptr<arrow::DataType> type = arrow::null();
+    for (const auto& partial : partials) {
+      if (partial->num_columns() != static_cast<int>(columns)) {
+        return arrow::Status::Invalid("Partial result has ", partial->num_columns(), " columns, expected ", columns);
+      }
+      for (const auto& chunk : partial->column(static_cast<int>(i))->chunks()) {
+        ARROW_ASSIGN_OR_RAISE(auto array, unwrap_union(chunk));
+        ARROW_ASSIGN_OR_RAISE(type, common_type(type, array->type()));
+        chunks.push_back(std::move(array));
+      }
+    }
+    if (type->id() == arrow::Type::NA) {
+      // No values at all: keep the declared type, expressions without one become integers
+      const auto& declared = partials.front()->schema()->field(static_cast<int>(i))->type();
+      const bool typed = declared->id() != arrow::Type::NA && declared->id() != arrow::Type::DENSE_UNION;
+      type = typed ? declared : arrow::int64();
+    }
+
+    for (auto& chunk : chunks) {
+      if (!chunk->type()->Equals(*type)) {
+        ARROW_ASSIGN_OR_RAISE(chunk, compute::Cast(*chunk, type));
+      }
+    }
+    fields.push_back(arrow::field(partials.front()->schema()->field(static_cast<int>(i))->name(), type));
+    chunked_columns.push_back(std::make_shared<arrow::ChunkedArray>(std::move(chunks), type));
+  }
+  return arrow::Table::Make(arrow::schema(std::move(fields)), std::move(chunked_columns));
+}
+
+namespace arrow_sql_router {
+std::optional<aggregate_plan> aggregate_plan::parse(const std::string& query) {
+  const std::string sql = trim(query);
+  const auto words = scan_words(sql);
+  if (words.empty() || words.front().text != "select" || words.front().begin != 0) {
+    return std::nullopt;
+  }
+
+  const sql_word* from = nullptr;
+  const sql_word* where = nullptr;
+  const sql_word* group = nullptr;
+  const sql_word* by = nullptr;
+  for (size_t i = 1; i < words.size(); i++) {
+    const auto& word = words[i];
+    if (word.text == "select" || word.text == "distinct" || word.text == "having" || word.text == "order" ||
+        word.text == "limit" || word.text == "union" || word.text == "intersect" || word.text == "except" ||
+        word.text == "over" || word.text == "window") {
+      return std::nullopt;
+    }
+    if (word.depth != 0) {
+      continue;
+    }
+    if (word.text == "from" && from == nullptr) {
+      from = &word;
+    } else if (word.text == "where" && from != nullptr && where == nullptr && group == nullptr) {
+      where = &word;
+    } else if (word.text == "group" && from != nullptr && group == nullptr && i + 1 < words.size() &&
+               words[i + 1].text == "by") {
+      group = &word;
+      by = &words[i + 1];
+    }
+  }
+  if (from == nullptr) {
+    return std::nullopt;
+  }
+
+  const size_t from_end = where != nullptr ? where->begin : group != nullptr ? group->begin : sql.size();
+  const std::string select_list = sql.substr(words.front().end, from->begin - words.front().end);
+  const std::string from_clause = trim(sql.substr(from->end, from_end - from->end));
+  const std::string where_clause =
+      where != nullptr ? trim(sql.substr(where->end, (group != nullptr ? group->begin : sql.size()) - where->end)) : "";
+
+  std::vector<std::string> keys;
+  if (by != nullptr) {
+    keys = split_top_level(sql.substr(by->end));
+  }
+  std::vector<std::string> canonical_keys;
+  for (const auto& key : keys) {
+    if (key.empty()) {
+      return std::nullopt;
+    }
+    canonical_keys.push_back(canonical(key));
+  }
+
+  aggregate_plan plan;
+  plan.key_count = keys.size();
+  std::vector<std::string> partial_columns;
+  for (size_t i = 0; i < keys.size(); i++) {
+    partial_columns.push_back(keys[i] + " as k" + std::to_string(i));
+  }
+
+  for (const auto& item : split_top_level(select_list)) {
+    auto [expression, alias] = split_alias(item);
+    if (expression.empty() || expression == "*") {
+      return std::nullopt;
+    }
+    const std::string name = alias.empty() ? expression : alias;
+
+    const size_t open = expression.find('(');
+    auto function = open == std::string::npos ? std::nullopt : parse_function(expression.substr(0, open));
+    if (!function.has_value()) {
+      auto key = std::find(canonical_keys.begin(), canonical_keys.end(), canonical(expression));
+      if (key == canonical_keys.end()) {
+        return std::nullopt;
+      }
+      plan.outputs.push_back(output_column{name, true, static_cast<size_t>(key - canonical_keys.begin())});
+      continue;
+    }
+
+    // The call has to span the whole expression: "sum(a) + 1" is not a plain aggregate
+    if (expression.back() != ')') {
+      return std::nullopt;
+    }
+    int depth = 0;
+    for (size_t i = open; i < expression.size(); i++) {
+      depth += expression[i] == '(' ? 1 : expression[i] == ')' ? -1 : 0;
+      if (depth == 0 && i + 1 != expression.size()) {
+        return std::nullopt;
+      }
+    }
+
+    const std::string argument = trim(expression.substr(open + 1, expression.size() - open - 2));
+    if (argument.empty() || (argument == "*" && *function != aggregate_function::count)) {
+      return std::nullopt;
+    }
+
+    plan.outputs.push_back(output_column{name, false, plan.aggregates.size()});
+    plan.aggregates.push_back(aggregate{*function, plan.partial_count});
+    switch (*function) {
+    case aggregate_function::avg:
+      partial_columns.push_back("sum(" + argument + ") as p" + std::to_string(plan.partial_count++));
+      partial_columns.push_back("count(" + argument + ") as p" + std::to_string(plan.partial_count++));
+      break;
+    default:
+      partial_columns.push_back(
+          expression.substr(0, open) + "(" + argument + ") as p" + std::to_string(plan.partial_count++)
+      );
+      break;
+    }
+  }
+  if (plan.aggregates.empty()) {
+    return std::nullopt;
+  }
+
+  plan.partial_query = "select ";
+  for (size_t i = 0; i < partial_columns.size(); i++) {
+    plan.partial_query += (i == 0 ? "" : ", ") + partial_columns[i];
+  }
+  plan.partial_query += " from " + from_clause;
+  if (!where_clause.empty()) {
+    plan.partial_query += " where " + where_clause;
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    plan.partial_query += (i == 0 ? " group by " : ", ") + keys[i];
+  }
+  return plan;
+}
+
+const std::string& aggregate_plan::get_partial_query() const {
+  return partial_query;
+}
+
+arrow::Result<std::shared_ptr<arrow::Table>>
+aggregate_plan::merge(const std::vector<std::shared_ptr<arrow::Table>>& partials) const {
+  if (partials.empty()) {
+    return arrow::Status::Invalid("No partial results to merge");
+  }
+  ARROW_ASSIGN_OR_RAISE(auto table, unify_partials(partials, key_count + partial_count));
+
+  // Keyed merges use the hash_ variants, global ones the scalar aggregate functions
+  const std::string prefix = key_count > 0 ? "hash_" : "";
+  auto partial_name = [](size_t i) { return "p" + std::to_string(i); };
+  auto merged_name = [](size_t i) { return "m" + std::to_string(i); };
+
+  std::vector<compute::Aggregate> merges;
+  for (const auto& aggregate : aggregates) {
+    const size_t width = aggregate.function == aggregate_function::avg ? 2 : 1;
+    for (size_t i = aggregate.partial; i < aggregate.partial + width; i++) {
+      std::string function;
+      switch (aggregate.function) {
+      case aggregate_function::min:
+        function = "min";
+        break;
+      case aggregate_function::max:
+        function = "max";
+        break;
+      default:
+        // Counts and sums of every node add up
+        function = "sum";
+        break;
+      }
+      merges.emplace_back(prefix + function, nullptr, arrow::FieldRef(partial_name(i)), merged_name(i));
+    }
+  }
+
+  std::vector<arrow::FieldRef> keys;
+  for (size_t i = 0; i < key_count; i++) {
+    keys.emplace_back("k" + std::to_string(i));
+  }
+
+  std::vector<compute::Expression> projections;
+  std::vector<std::string> names;
+  for (const auto& output : outputs) {
+    names.push_back(output.name);
+    if (output.is_key) {
+      projections.push_back(compute::field_ref("k" + std::to_string(output.index)));
+      continue;
+    }
+
+    const auto& aggregate = aggregates[output.index];
+    if (aggregate.function != aggregate_function::avg) {
+      projections.push_back(compute::field_ref(merged_name(aggregate.partial)));
+      continue;
+    }
+    auto as_double = [](compute::Expression value) {
+      return compute::call("cast", {std::move(value)}, compute::CastOptions::Safe(arrow::float64()));
+    };
+    projections.push_back(compute::call(
+        "divide",
+        {as_double(compute::field_ref(merged_name(aggregate.partial))),
+         as_double(compute::field_ref(merged_name(aggregate.partial + 1)))}
+    ));
+  }
+
+  acero::Declaration plan = acero::Declaration::Sequence({
+      {"table_source", acero::TableSourceNodeOptions(table)},
+      {"aggregate", acero::AggregateNodeOptions(std::move(merges), std::move(keys))},
+      {"project", acero::ProjectNodeOptions(std::move(projections), std::move(names))},
+  });
+  return acero::DeclarationToTable(std::move(plan));
+}
+} // namespace arrow_sql_router
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "arrow/result.h"
+#include "arrow/table.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace arrow_sql_router {
+enum class aggregate_function { count, sum, min, max, avg };
+
+// A single-table SELECT made only of GROUP BY keys and COUNT/SUM/MIN/MAX/AVG, split into
+// a partial query every node runs on its shard and the merge of the partial results.
+// Anything else (HAVING, ORDER BY, LIMIT, DISTINCT, subqueries, ...) is not recognized
+// and has to be executed some other way.
+class aggregate_plan {
+public:
+  static std::optional<aggregate_plan> parse(const std::string& query);
+
+  // Keys are named k0, k1, ... and partial aggregates p0, p1, ... in the result
+  const std::string& get_partial_query() const;
+
+  // Combines the partial results of all nodes into the final result of the query
+  arrow::Result<std::shared_ptr<arrow::Table>> merge(const std::vector<std::shared_ptr<arrow::Table>>& partials) const;
+
+private:
+  struct output_column {
+    std::string name;
+    // Index into keys for a key column, into aggregates otherwise
+    bool is_key;
+    size_t index;
+  };
+
+  struct aggregate {
+    aggregate_function function;
+    // First partial column, AVG takes two: the sum and the count
+    size_t partial;
+  };
+
+  std::string partial_query;
+  size_t key_count = 0;
+  size_t partial_count = 0;
+  std::vector<aggregate> aggregates;
+  std::vector<output_column> outputs;
+
+  aggregate_plan() = default;
+};
+} // namespace arrow_sql_router
@@ -0,0 +1,657 @@
+#include "distributed_join.h"
+
+#include "../bridge/shard_hash.h"
+#include "arrow/acero/exec_plan.h"
+#include "arrow/acero/options.h"
+#include "arrow/array.h"
+#include "arrow/builder.h"
+#include "arrow/compute/api.h"
+#include "arrow/io/file.h"
+#include "arrow/ipc/reader.h"
+#include "arrow/ipc/writer.h"
+#include "arrow/util/byte_size.h"
+#include "sql_text.h"
+
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <set>
+
+namespace acero = arrow::acero;
+namespace compute = arrow::compute;
+
+struct join_table_ref {
+  // As written, with its alias
+  std::string text;
+  std::string alias;
+};
+
+// "table [AS] alias" or a bare table, which is its own alias
+std::optional<join_table_ref> parse_table_ref(const std::string& text) {
+  const std::string ref = trim(text);
+  const auto [begin, end] = identifier_span(ref, 0);
+  if (begin == end || ref.find('(') != std::string::npos) {
+    return std::nullopt;
+  }
+
+  std::string rest = trim(ref.substr(end));
+  if (rest.empty()) {
+    return join_table_ref{ref, identifier_name(ref.substr(begin, end - begin))};
+  }
+  const auto words = scan_words(rest);
+  if (!words.empty() && words.front().text == "as" && words.front().begin == 0) {
+    rest = trim(rest.substr(words.front().end));
+  }
+  const auto [alias_begin, alias_end] = identifier_span(rest, 0);
+  if (alias_begin == alias_end || alias_end != rest.size()) {
+    return std::nullopt;
+  }
+  return join_table_ref{ref, identifier_name(rest)};
+}
+
+// "alias.column" spanning the whole expression
+std::optional<std::pair<std::string, std::string>> qualified_column(const std::string& expression) {
+  const std::string text = trim(expression);
+  const auto [begin, end] = identifier_span(text, 0);
+  const size_t dot = text.find('.', begin);
+  if (dot == std::string::npos || dot >= end || dot == 0 || dot + 1 == end || end != text.size() ||
+      std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return std::nullopt;
+  }
+  const std::string column = text.substr(dot + 1);
+  if (column.find('.') != std::string::npos || column == "*") {
+    return std::nullopt;
+  }
+  return std::make_pair(identifier_name(text.substr(0, dot)), column);
+}
+
+// Lower-cased qualifiers of every "qualifier.column" in an expression
+std::set<std::string> qualifiers(const std::string& expression) {
+  std::set<std::string> names;
+  for (size_t i = 0; i < expression.size();) {
+    const char c = expression[i];
+    if (c == '\'') {
+      const size_t close = expression.find('\'', i + 1);
+      i = close == std::string::npos ? expression.size() : close + 1;
+      continue;
+    }
+    const bool quoted = c == '"' || c == '`' || c == '[';
+    if (std::isdigit(static_cast<unsigned char>(c))) {
+      // The decimal point of a number is not a qualifier
+      i = std::min(expression.find_first_not_of("0123456789.eE_", i), expression.size());
+      continue;
+    }
+    if (!quoted && !std::isalpha(static_cast<unsigned char>(c)) && c != '_') {
+      i++;
+      continue;
+    }
+
+    size_t end = i + 1;
+    if (quoted) {
+      end = expression.find(c == '[' ? ']' : c, i + 1);
+      end = end == std::string::npos ? expression.size() : end + 1;
+    } else {
+      while (end < expression.size() && (std::isalnum(static_cast<unsigned char>(expression[end])) ||
+                                         expression[end] == '_')) {
+        end++;
+      }
+    }
+    if (end < expression.size() && expression[end] == '.') {
+      names.insert(identifier_name(expression.substr(i, end - i)));
+      // Skip the column so that it is not taken for the next qualifier
+      end = identifier_span(expression, end + 1).second;
+    }
+    i = end;
+  }
+  return names;
+}
+
+// The two sides of a top-level "=", if that is the whole conjunct
+std::optional<std::pair<std::string, std::string>> split_join_equality(const std::string& conjunct) {
+  size_t position = std::string::npos;
+  for (size_t i = 0; i < conjunct.size(); i++) {
+    const char c = conjunct[i];
+    if (c == '\'' || c == '"' || c == '`' || c == '[') {
+      const size_t close = conjunct.find(c == '[' ? ']' : c, i + 1);
+      i = close == std::string::npos ? conjunct.size() : close;
+    } else if (c == '(' || c == ')' || c == '<' || c == '>' || c == '!') {
+      return std::nullopt;
+    } else if (c == '=') {
+      if (position != std::string::npos) {
+        return std::nullopt;
+      }
+      position = i;
+    }
+  }
+  if (position == std::string::npos) {
+    return std::nullopt;
+  }
+  return std::make_pair(trim(conjunct.substr(0, position)), trim(conjunct.substr(position + 1)));
+}
+
+std::optional<int> find_column(const arrow::Schema& schema, const std::string& column) {
+  const std::string name = identifier_name(column);
+  for (int i = 0; i < schema.num_fields(); i++) {
+    if (to_lower(schema.field(i)->name()) == name) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+uint64_t mix_hash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+template <typename ArrayType>
+void hash_integers(const arrow::Array& array, std::vector<uint64_t>& hashes) {
+  const auto& values = static_cast<const ArrayType&>(array);
+  for (int64_t row = 0; row < values.length(); row++) {
+    if (values.IsValid(row)) {
+      hashes[row] = mix_hash(hashes[row] * 31 + static_cast<uint64_t>(values.Value(row)));
+    }
+  }
+}
+
+template <typename ArrayType>
+void hash_floating(const arrow::Array& array, std::vector<uint64_t>& hashes) {
+  const auto& values = static_cast<const ArrayType&>(array);
+  for (int64_t row = 0; row < values.length(); row++) {
+    if (values.IsValid(row)) {
+      // -0.0 joins with 0.0
+      const double value = static_cast<double>(values.Value(row)) + 0.0;
+      hashes[row] = mix_hash(hashes[row] * 31 + std::bit_cast<uint64_t>(value));
+    }
+  }
+}
+
+template <typename ArrayType>
+void hash_binary(const arrow::Array& array, std::vector<uint64_t>& hashes) {
+  const auto& values = static_cast<const ArrayType&>(array);
+  for (int64_t row = 0; row < values.length(); row++) {
+    if (values.IsValid(row)) {
+      hashes[row] = mix_hash(hashes[row] * 31 + arrow_sql_bridge::shard_hash(values.GetView(row)));
+    }
+  }
+}
+
+// Folds one key column into the row hashes; equal keys of the same type hash equally on both sides
+arrow::Status hash_keys(const arrow::Array& array, std::vector<uint64_t>& hashes) {
+  switch (array.type_id()) {
+  case arrow::Type::INT8:
+    hash_integers<arrow::Int8Array>(array, hashes);
+    break;
+  case arrow::Type::INT16:
+    hash_integers<arrow::Int16Array>(array, hashes);
+    break;
+  case arrow::Type::INT32:
+    hash_integers<arrow::Int32Array>(array, hashes);
+    break;
+  case arrow::Type::INT64:
+    hash_integers<arrow::Int64Array>(array, hashes);
+    break;
+  case arrow::Type::UINT8:
+    hash_integers<arrow::UInt8Array>(array, hashes);
+    break;
+  case arrow::Type::UINT16:
+    hash_integers<arrow::UInt16Array>(array, hashes);
+    break;
+  case arrow::Type::UINT32:
+    hash_integers<arrow::UInt32Array>(array, hashes);
+    break;
+  case arrow::Type::UINT64:
+    hash_integers<arrow::UInt64Array>(array, hashes);
+    break;
+  case arrow::Type::BOOL:
+    hash_integers<arrow::BooleanArray>(array, hashes);
+    break;
+  case arrow::Type::FLOAT:
+    hash_floating<arrow::FloatArray>(array, hashes);
+    break;
+  case arrow::Type::DOUBLE:
+    hash_floating<arrow::DoubleArray>(array, hashes);
+    break;
+  case arrow::Type::STRING:
+    hash_binary<arrow::StringArray>(array, hashes);
+    break;
+  case arrow::Type::LARGE_STRING:
+    hash_binary<arrow::LargeStringArray>(array, hashes);
+    break;
+  case arrow::Type::BINARY:
+    hash_binary<arrow::BinaryArray>(array, hashes);
+    break;
+  case arrow::Type::LARGE_BINARY:
+    hash_binary<arrow::LargeBinaryArray>(array, hashes);
+    break;
+  default:
+    return arrow::Status::NotImplemented("Cannot partition join keys of type ", array.type()->ToString());
+  }
+  return arrow::Status::OK();
+}
+
+// One IPC stream file per partition of one join side
+class spill_files {
+public:
+  static arrow::Result<spill_files> make(
+      const std::filesystem::path& directory,
+      const std::string& side,
+      size_t partitions,
+      std::shared_ptr<arrow::Schema> schema
+  ) {
+    spill_files files;
+    files.schema = std::move(schema);
+    for (size_t i = 0; i < partitions; i++) {
+      files.paths.push_back(directory / (side + "-" + std::to_string(i) + ".arrow"));
+      ARROW_ASSIGN_OR_RAISE(auto stream, arrow::io::FileOutputStream::Open(files.paths.back().string()));
+      ARROW_ASSIGN_OR_RAISE(auto writer, arrow::ipc::MakeStreamWriter(stream, files.schema));
+      files.writers.push_back(std::move(writer));
+    }
+    return files;
+  }
+
+  arrow::Status write(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<int>& keys) {
+    const size_t partitions = writers.size();
+    std::vector<uint64_t> hashes(batch->num_rows(), 0);
+    for (int key : keys) {
+      ARROW_RETURN_NOT_OK(hash_keys(*batch->column(key), hashes));
+    }
+
+    std::vector<arrow::Int64Builder> indices(partitions);
+    for (int64_t row = 0; row < batch->num_rows(); row++) {
+      ARROW_RETURN_NOT_OK(indices[hashes[row] % partitions].Append(row));
+    }
+    for (size_t i = 0; i < partitions; i++) {
+      if (indices[i].length() == 0) {
+        continue;
+      }
+      ARROW_ASSIGN_OR_RAISE(auto selection, indices[i].Finish());
+      ARROW_ASSIGN_OR_RAISE(auto part, compute::Take(batch, selection));
+      ARROW_RETURN_NOT_OK(writers[i]->WriteRecordBatch(*part.record_batch()));
+    }
+    return arrow::Status::OK();
+  }
+
+  arrow::Status close() {
+    for (auto& writer : writers) {
+      ARROW_RETURN_NOT_OK(writer->Close());
+    }
+    writers.clear();
+    return arrow::Status::OK();
+  }
+
+  arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> open(size_t partition) const {
+    ARROW_ASSIGN_OR_RAISE(auto file, arrow::io::ReadableFile::Open(paths[partition].string()));
+    return arrow::ipc::RecordBatchStreamReader::Open(file);
+  }
+
+private:
+  std::shared_ptr<arrow::Schema> schema;
+  std::vector<std::filesystem::path> paths;
+  std::vector<std::shared_ptr<arrow::ipc::RecordBatchWriter>> writers;
+
+  spill_files() = default;
+};
+
+// Removes the spill directory however the join ends
+struct spill_directory_guard {
+  std::filesystem::path path;
+
+  ~spill_directory_guard() {
+    std::error_code error;
+    std::filesystem::remove_all(path, error);
+  }
+};
+
+arrow::Result<std::filesystem::path> make_spill_directory(const std::filesystem::path& parent) {
+  std::random_device random;
+  const uint64_t id = (static_cast<uint64_t>(random()) << 32) | random();
+  std::filesystem::path path = parent / ("arrow-sql-join-" + std::to_string(id));
+  std::error_code error;
+  if (!std::filesystem::create_directories(path, error)) {
+    return arrow::Status::IOError("Failed to create join spill directory ", path.string(), ": ", error.message());
+  }
+  return path;
+}
+
+namespace arrow_sql_router {
+struct join_plan::layout {
+  std::vector<int> left_keys;
+  std::vector<int> right_keys;
+  // Side and column of every output column
+  std::vector<std::pair<bool, int>> columns;
+  std::vector<std::string> names;
+};
+
+std::optional<join_plan> join_plan::parse(const std::string& query) {
+  const std::string sql = trim(query);
+  const auto words = scan_words(sql);
+  if (words.empty() || words.front().text != "select" || words.front().begin != 0) {
+    return std::nullopt;
+  }
+
+  static const std::set<std::string> unsupported{
+      "select", "distinct", "group", "having", "order", "limit",   "union", "intersect", "except",
+      "over",   "window",   "left",  "right",  "full",  "outer",   "cross", "natural",   "using",
+  };
+  const sql_word* from = nullptr;
+  const sql_word* inner = nullptr;
+  const sql_word* join = nullptr;
+  const sql_word* on = nullptr;
+  const sql_word* where = nullptr;
+  for (size_t i = 1; i < words.size(); i++) {
+    const auto& word = words[i];
+    if (unsupported.contains(word.text)) {
+      return std::nullopt;
+    }
+    if (word.depth != 0) {
+      continue;
+    }
+    if (word.text == "from" && from == nullptr) {
+      from = &word;
+    } else if (word.text == "join" && from != nullptr && join == nullptr && where == nullptr) {
+      join = &word;
+      inner = words[i - 1].text == "inner" ? &words[i - 1] : nullptr;
+    } else if (word.text == "join") {
+      return std::nullopt;
+    } else if (word.text == "on" && join != nullptr && on == nullptr && where == nullptr) {
+      on = &word;
+    } else if (word.text == "where" && from != nullptr && where == nullptr) {
+      where = &word;
+    }
+  }
+  if (from == nullptr || (join != nullptr && on == nullptr)) {
+    return std::nullopt;
+  }
+
+  const size_t from_end = where != nullptr ? where->begin : sql.size();
+  std::vector<std::string> table_refs;
+  std::vector<std::string> conditions;
+  if (join != nullptr) {
+    const size_t left_end = inner != nullptr ? inner->begin : join->begin;
+    table_refs.push_back(sql.substr(from->end, left_end - from->end));
+    table_refs.push_back(sql.substr(join->end, on->begin - join->end));
+    conditions.push_back(sql.substr(on->end, from_end - on->end));
+  } else {
+    table_refs = split_top_level(sql.substr(from->end, from_end - from->end));
+  }
+  if (where != nullptr) {
+    conditions.push_back(sql.substr(where->end));
+  }
+  if (table_refs.size() != 2) {
+    return std::nullopt;
+  }
+  auto left = parse_table_ref(table_refs[0]);
+  auto right = parse_table_ref(table_refs[1]);
+  if (!left.has_value() || !right.has_value() || left->alias == right->alias) {
+    return std::nullopt;
+  }
+
+  join_plan plan;
+  // Pushed-down conjuncts and the columns every side has to return
+  std::vector<std::string> filters[2];
+  std::vector<std::string> columns[2];
+  bool stars[2] = {false, false};
+  auto side_of = [&](const std::string& alias) -> std::optional<bool> {
+    if (alias == left->alias) {
+      return false;
+    }
+    if (alias == right->alias) {
+      return true;
+    }
+    return std::nullopt;
+  };
+  auto need = [&](bool side, const std::string& column) {
+    const std::string name = identifier_name(column);
+    auto& side_columns = columns[side];
+    if (std::none_of(side_columns.begin(), side_columns.end(), [&](const std::string& known) {
+          return identifier_name(known) == name;
+        })) {
+      side_columns.push_back(column);
+    }
+  };
+
+  for (const auto& condition : conditions) {
+    auto conjuncts = split_conjuncts(condition);
+    if (!conjuncts.has_value()) {
+      return std::nullopt;
+    }
+    for (const auto& conjunct : *conjuncts) {
+      const auto names = qualifiers(conjunct);
+      if (conjunct.empty() || names.empty()) {
+        return std::nullopt;
+      }
+      if (names.size() == 1) {
+        auto side = side_of(*names.begin());
+        if (!side.has_value()) {
+          return std::nullopt;
+        }
+        filters[*side].push_back(conjunct);
+        continue;
+      }
+
+      // Refers to both tables, so it has to be a key equality
+      auto equality = split_join_equality(conjunct);
+      if (!equality.has_value()) {
+        return std::nullopt;
+      }
+      auto first = qualified_column(equality->first);
+      auto second = qualified_column(equality->second);
+      if (!first.has_value() || !second.has_value()) {
+        return std::nullopt;
+      }
+      auto first_side = side_of(first->first);
+      auto second_side = side_of(second->first);
+      if (!first_side.has_value() || !second_side.has_value() || *first_side == *second_side) {
+        return std::nullopt;
+      }
+      if (*first_side) {
+        std::swap(first, second);
+      }
+      plan.keys.emplace_back(first->second, second->second);
+      need(false, first->second);
+      need(true, second->second);
+    }
+  }
+  if (plan.keys.empty()) {
+    return std::nullopt;
+  }
+
+  const size_t select_end = from->begin;
+  for (const auto& item : split_top_level(sql.substr(words.front().end, select_end - words.front().end))) {
+    auto [expression, alias] = split_alias(item);
+    if (expression == "*" && alias.empty()) {
+      plan.outputs.push_back(output_column{"", "", false});
+      plan.outputs.push_back(output_column{"", "", true});
+      stars[0] = stars[1] = true;
+      continue;
+    }
+    if (expression.size() > 2 && expression.ends_with(".*") && alias.empty()) {
+      auto side = side_of(identifier_name(expression.substr(0, expression.size() - 2)));
+      if (!side.has_value()) {
+        return std::nullopt;
+      }
+      plan.outputs.push_back(output_column{"", "", *side});
+      stars[*side] = true;
+      continue;
+    }
+
+    auto column = qualified_column(expression);
+    if (!column.has_value()) {
+      return std::nullopt;
+    }
+    auto side = side_of(column->first);
+    if (!side.has_value()) {
+      return std::nullopt;
+    }
+    plan.outputs.push_back(output_column{column->second, alias, *side});
+    need(*side, column->second);
+  }
+
+  const join_table_ref* refs[2] = {&*left, &*right};
+  std::string* queries[2] = {&plan.left_query, &plan.right_query};
+  for (int side = 0; side < 2; side++) {
+    std::string& side_query = *queries[side];
+    const std::string alias = quote_name(refs[side]->alias);
+    side_query = "select ";
+    if (stars[side]) {
+      side_query += alias + ".*";
+    } else {
+      for (size_t i = 0; i < columns[side].size(); i++) {
+        side_query += (i == 0 ? "" : ", ") + alias + "." + columns[side][i];
+      }
+    }
+    side_query += " from " + refs[side]->text;
+    for (size_t i = 0; i < filters[side].size(); i++) {
+      side_query += (i == 0 ? " where " : " and ") + filters[side][i];
+    }
+  }
+  return plan;
+}
+
+const std::string& join_plan::get_left_query() const {
+  return left_query;
+}
+
+const std::string& join_plan::get_right_query() const {
+  return right_query;
+}
+
+arrow::Result<join_plan::layout> join_plan::resolve(const arrow::Schema& left, const arrow::Schema& right) const {
+  layout result;
+  const arrow::Schema* schemas[2] = {&left, &right};
+  auto find = [&](bool side, const std::string& column) -> arrow::Result<int> {
+    auto index = find_column(*schemas[side], column);
+    if (!index.has_value()) {
+      return arrow::Status::Invalid("Join side result has no column ", column);
+    }
+    return *index;
+  };
+
+  for (const auto& [left_key, right_key] : keys) {
+    ARROW_ASSIGN_OR_RAISE(int left_index, find(false, left_key));
+    ARROW_ASSIGN_OR_RAISE(int right_index, find(true, right_key));
+    result.left_keys.push_back(left_index);
+    result.right_keys.push_back(right_index);
+  }
+  for (const auto& output : outputs) {
+    if (output.column.empty()) {
+      for (int i = 0; i < schemas[output.right]->num_fields(); i++) {
+        result.columns.emplace_back(output.right, i);
+        result.names.push_back(schemas[output.right]->field(i)->name());
+      }
+      continue;
+    }
+    ARROW_ASSIGN_OR_RAISE(int index, find(output.right, output.column));
+    result.columns.emplace_back(output.right, index);
+    result.names.push_back(output.name.empty() ? schemas[output.right]->field(index)->name() : output.name);
+  }
+  return result;
+}
+
+arrow::Result<std::shared_ptr<arrow::Schema>>
+join_plan::output_schema(const arrow::Schema& left, const arrow::Schema& right) const {
+  ARROW_ASSIGN_OR_RAISE(auto resolved, resolve(left, right));
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  for (size_t i = 0; i < resolved.columns.size(); i++) {
+    const auto& [side, index] = resolved.columns[i];
+    const auto& field = (side ? right : left).field(index);
+    fields.push_back(arrow::field(resolved.names[i], field->type(), field->nullable()));
+  }
+  return arrow::schema(std::move(fields));
+}
+
+// Acero's hash join builds its table over the right input and streams the left one through it
+arrow::Result<std::shared_ptr<arrow::Table>> hash_join(
+    std::shared_ptr<arrow::RecordBatchReader> left,
+    std::shared_ptr<arrow::Table> right,
+    const std::vector<int>& left_keys,
+    const std::vector<int>& right_keys,
+    const std::vector<std::pair<bool, int>>& columns,
+    const std::vector<std::string>& names
+) {
+  const int left_width = left->schema()->num_fields();
+  std::vector<arrow::FieldRef> left_refs(left_keys.begin(), left_keys.end());
+  std::vector<arrow::FieldRef> right_refs(right_keys.begin(), right_keys.end());
+
+  acero::Declaration plan{
+      "hashjoin",
+      {acero::Declaration{"record_batch_reader_source", acero::RecordBatchReaderSourceNodeOptions(std::move(left))},
+       acero::Declaration{"table_source", acero::TableSourceNodeOptions(std::move(right))}},
+      acero::HashJoinNodeOptions(
+          acero::JoinType::INNER, std::move(left_refs), std::move(right_refs), compute::literal(true), "_l", "_r"
+      ),
+  };
+  ARROW_ASSIGN_OR_RAISE(auto joined, acero::DeclarationToTable(std::move(plan)));
+
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  std::vector<std::shared_ptr<arrow::ChunkedArray>> arrays;
+  for (size_t i = 0; i < columns.size(); i++) {
+    const int index = columns[i].first ? left_width + columns[i].second : columns[i].second;
+    arrays.push_back(joined->column(index));
+    fields.push_back(arrow::field(names[i], arrays.back()->type()));
+  }
+  return arrow::Table::Make(arrow::schema(std::move(fields)), std::move(arrays), joined->num_rows());
+}
+
+arrow::Result<std::shared_ptr<arrow::Table>> join_plan::execute(
+    std::shared_ptr<arrow::RecordBatchReader> left,
+    std::shared_ptr<arrow::RecordBatchReader> right,
+    const join_options& options
+) const {
+  ARROW_ASSIGN_OR_RAISE(auto resolved, resolve(*left->schema(), *right->schema()));
+  auto join = [&](std::shared_ptr<arrow::RecordBatchReader> probe, std::shared_ptr<arrow::Table> build) {
+    return hash_join(
+        std::move(probe), std::move(build), resolved.left_keys, resolved.right_keys, resolved.columns, resolved.names
+    );
+  };
+
+  std::vector<std::shared_ptr<arrow::RecordBatch>> build;
+  int64_t build_bytes = 0;
+  while (build_bytes <= options.memory_budget) {
+    ARROW_ASSIGN_OR_RAISE(auto batch, right->Next());
+    if (batch == nullptr) {
+      ARROW_ASSIGN_OR_RAISE(auto table, arrow::Table::FromRecordBatches(right->schema(), std::move(build)));
+      return join(std::move(left), std::move(table));
+    }
+    build_bytes += arrow::util::TotalBufferSize(*batch);
+    build.push_back(std::move(batch));
+  }
+
+  // The build side does not fit: partition both sides by key hash so that matching rows land in
+  // the same partition, then join the partitions one by one
+  const size_t partitions = std::max<size_t>(options.spill_partitions, 2);
+  ARROW_ASSIGN_OR_RAISE(auto directory, make_spill_directory(options.spill_directory));
+  spill_directory_guard guard{directory};
+  ARROW_ASSIGN_OR_RAISE(auto right_files, spill_files::make(directory, "right", partitions, right->schema()));
+  ARROW_ASSIGN_OR_RAISE(auto left_files, spill_files::make(directory, "left", partitions, left->schema()));
+
+  for (const auto& batch : build) {
+    ARROW_RETURN_NOT_OK(right_files.write(batch, resolved.right_keys));
+  }
+  build.clear();
+  for (auto source : {std::make_pair(right, &right_files), std::make_pair(left, &left_files)}) {
+    const auto& keys = source.second == &right_files ? resolved.right_keys : resolved.left_keys;
+    while (true) {
+      ARROW_ASSIGN_OR_RAISE(auto batch, source.first->Next());
+      if (batch == nullptr) {
+        break;
+      }
+      ARROW_RETURN_NOT_OK(source.second->write(batch, keys));
+    }
+    ARROW_RETURN_NOT_OK(source.second->close());
+  }
+
+  std::vector<std::shared_ptr<arrow::Table>> results;
+  for (size_t i = 0; i < partitions; i++) {
+    ARROW_ASSIGN_OR_RAISE(auto build_reader, right_files.open(i));
+    ARROW_ASSIGN_OR_RAISE(auto build_table, build_reader->ToTable());
+    ARROW_ASSIGN_OR_RAISE(auto probe_reader, left_files.open(i));
+    ARROW_ASSIGN_OR_RAISE(auto result, join(std::move(probe_reader), std::move(build_table)));
+    results.push_back(std::move(result));
+  }
+  return arrow::ConcatenateTables(results);
+}
+} // namespace arrow_sql_router
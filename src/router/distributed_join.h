@@ -0,0 +1,66 @@
+#pragma once
+
+#include "arrow/record_batch.h"
+#include "arrow/result.h"
+#include "arrow/table.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace arrow_sql_router {
+struct join_options {
+  // Build side bytes held in memory before both sides are partitioned to spill files
+  int64_t memory_budget = 256 << 20;
+  size_t spill_partitions = 16;
+  std::filesystem::path spill_directory = std::filesystem::temp_directory_path();
+};
+
+// An inner equi-join of two tables, `FROM a JOIN b ON a.x = b.y` or `FROM a, b WHERE a.x = b.y`,
+// selecting qualified columns and stars. Every WHERE or ON conjunct that only refers to one
+// table is pushed down to that table's side query together with the columns it needs; the
+// sides are then streamed from the nodes and joined on the router. Anything else (outer joins,
+// expressions in the select list, GROUP BY, ORDER BY, ...) is not recognized.
+class join_plan {
+public:
+  static std::optional<join_plan> parse(const std::string& query);
+
+  // The query every node runs for the left (probe) and the right (build) table
+  const std::string& get_left_query() const;
+  const std::string& get_right_query() const;
+
+  // Schema of the joined result given the ones the side queries return
+  arrow::Result<std::shared_ptr<arrow::Schema>>
+  output_schema(const arrow::Schema& left, const arrow::Schema& right) const;
+
+  // Builds a hash table over the right side and probes it with the left one. Once the right
+  // side outgrows the memory budget, both sides are hash-partitioned to IPC files on local
+  // disk and joined a partition at a time.
+  arrow::Result<std::shared_ptr<arrow::Table>> execute(
+      std::shared_ptr<arrow::RecordBatchReader> left,
+      std::shared_ptr<arrow::RecordBatchReader> right,
+      const join_options& options = join_options()
+  ) const;
+
+private:
+  struct output_column {
+    // Empty for a star
+    std::string column;
+    std::string name;
+    bool right;
+  };
+
+  struct layout;
+
+  std::string left_query;
+  std::string right_query;
+  std::vector<std::pair<std::string, std::string>> keys;
+  std::vector<output_column> outputs;
+
+  join_plan() = default;
+
+  arrow::Result<layout> resolve(const arrow::Schema& left, const arrow::Schema& right) const;
+};
+} // namespace arrow_sql_router
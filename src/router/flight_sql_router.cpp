@@ -1,71 +1,1358 @@
 #include "flight_sql_router.h"
 
+#include "../bridge/dictionary_delta_stream.h"
+#include "../bridge/handle_registry.h"
+#include "../bridge/shard_hash.h"
+#include "aggregate_pushdown.h"
+#include "distributed_join.h"
+#include "arrow/array.h"
 #include "arrow/flight/client.h"
 #include "arrow/flight/sql/client.h"
+#include "arrow/ipc/writer.h"
+#include "arrow/scalar.h"
+#include "arrow/table.h"
+#include "arrow/util/logging.h"
+#include "node_channel_pool.h"
+#include "ordered_merge.h"
+#include "replica_groups.h"
+#include "sql_text.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <thread>
 
 namespace flight = arrow::flight;
 
+// Location part of tickets for results the router computed itself
+const std::string kLocalResultLocation = "router";
+// Location part of tickets for ordered results the router merges while they are read
+const std::string kMergedResultLocation = "router-merge";
+// Location part of tickets for node results the router keeps a copy of while proxying them
+const std::string kCachedResultLocation = "router-cache";
+// Times a copied batch is thrown away because writes ran meanwhile, before the next one is copied
+// with writes held back
+const int kMaxCopyConflicts = 3;
+// Nodes type results from declared column types only. A dictionary picked from one node's own
+// rows would not match the plain text another node returns for the same query.
+const std::pair<std::string, std::string> kTypeNarrowingHeader{"x-type-narrowing", "declared"};
+
+// Shards of one query have to agree on column names and types; nullability is widened
+// and column metadata (which carries per-node table names) is dropped.
+arrow::Result<std::shared_ptr<arrow::Schema>>
+merge_schemas(const std::vector<std::shared_ptr<arrow::Schema>>& schemas, const std::vector<flight::Location>& nodes) {
+  std::shared_ptr<arrow::Schema> merged = schemas.front()->RemoveMetadata();
+  for (size_t i = 1; i < schemas.size(); i++) {
+    const auto& schema = *schemas[i];
+    if (schema.num_fields() != merged->num_fields()) {
+      return arrow::Status::Invalid(
+          "Inconsistent schemas: ",
+          nodes.front().ToString(),
+          " reports ",
+          merged->num_fields(),
+          " columns, ",
+          nodes[i].ToString(),
+          " reports ",
+          schema.num_fields()
+      );
+    }
+
+    for (int j = 0; j < schema.num_fields(); j++) {
+      const auto& field = schema.field(j);
+      const auto& merged_field = merged->field(j);
+      if (field->name() != merged_field->name() || !field->type()->Equals(*merged_field->type())) {
+        return arrow::Status::Invalid(
+            "Inconsistent schemas: column ",
+            j,
+            " is ",
+            merged_field->ToString(),
+            " on ",
+            nodes.front().ToString(),
+            " but ",
+            field->ToString(),
+            " on ",
+            nodes[i].ToString()
+        );
+      }
+      if (field->nullable() && !merged_field->nullable()) {
+        ARROW_ASSIGN_OR_RAISE(merged, merged->SetField(j, merged_field->WithNullable(true)));
+      }
+    }
+  }
+
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  for (const auto& field : merged->fields()) {
+    fields.push_back(field->RemoveMetadata());
+  }
+  return arrow::schema(std::move(fields));
+}
+
+// Rows of `key` whose hash falls into one of the ring ranges, in terms of the nodes' shard_hash()
+std::string range_predicate(const std::string& key, const std::vector<arrow_sql_router::hash_ring::range>& ranges) {
+  const std::string hash = "shard_hash(" + quote_name(key) + ")";
+  std::string predicate;
+  for (const auto& range : ranges) {
+    const std::string begin = std::to_string(arrow_sql_bridge::sql_shard_hash(range.begin));
+    const std::string end = std::to_string(arrow_sql_bridge::sql_shard_hash(range.end));
+    const std::string join = range.begin < range.end ? " and " : " or ";
+    predicate += (predicate.empty() ? "(" : " or (") + hash + " > " + begin + join + hash + " <= " + end + ")";
+  }
+  return predicate.empty() ? "0" : predicate;
+}
+
+// The CREATE TABLE statement of a table, as kept in sqlite_master, for a table of another name.
+// Declared types, keys and constraints stay as they are.
+arrow::Result<std::string> rename_definition(const std::string& definition, const std::string& name) {
+  const auto words = scan_words(definition);
+  size_t keyword = 0;
+  while (keyword < words.size() && words[keyword].text != "table") {
+    keyword++;
+  }
+  if (keyword == words.size()) {
+    return arrow::Status::Invalid("Not a CREATE TABLE statement: ", definition);
+  }
+  // "if not exists" never reaches sqlite_master, but costs nothing to skip
+  if (keyword + 3 < words.size() && words[keyword + 1].text == "if" && words[keyword + 3].text == "exists") {
+    keyword += 3;
+  }
+  const auto span = identifier_span(definition, words[keyword].end);
+  return "create table " + quote_name(name) + definition.substr(span.second);
+}
+
+// Statements after which cached result schemas may be wrong
+bool changes_schema(const std::string& query) {
+  const auto words = scan_words(query);
+  return !words.empty() && (words.front().text == "create" || words.front().text == "drop" ||
+                            words.front().text == "alter");
+}
+
 namespace arrow_sql_router {
+// Node result stream proxied to the client, holds its channel until the stream is done
+class leased_reader : public arrow::RecordBatchReader {
+public:
+  leased_reader(node_channel_pool::lease channel, std::shared_ptr<arrow::RecordBatchReader> reader)
+      : channel(std::move(channel))
+      , reader(std::move(reader)) {}
+
+  std::shared_ptr<arrow::Schema> schema() const override { return reader->schema(); }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    auto status = reader->ReadNext(batch);
+    channel.report(status);
+    return status;
+  }
+
+  arrow::Status Close() override { return reader->Close(); }
+
+private:
+  node_channel_pool::lease channel;
+  std::shared_ptr<arrow::RecordBatchReader> reader;
+};
+
+// Node result stream passed on to the client as it arrives. Arrow's Flight client only hands out
+// decoded batches, never the FlightData it received, so the message is rebuilt rather than passed
+// through. Batches are not copied: decoding keeps the body buffers received from the node, the
+// outgoing IPC payload references them and only the message header is written anew. Streams with
+// dictionaries don't come here, see forward_stream. Holds its channel until the stream is done,
+// and passes the batches to the result cache fill, if any.
+class forwarding_stream : public flight::FlightDataStream {
+public:
+  forwarding_stream(
+      node_channel_pool::lease channel,
+      std::unique_ptr<flight::FlightStreamReader> reader,
+      std::shared_ptr<arrow::Schema> schema,
+      std::shared_ptr<result_cache::fill> fill
+  )
+      : channel(std::move(channel))
+      , reader(std::move(reader))
+      , stream_schema(std::move(schema))
+      , mapper(*stream_schema)
+      , fill(std::move(fill)) {}
+
+  std::shared_ptr<arrow::Schema> schema() override { return stream_schema; }
+
+  arrow::Result<flight::FlightPayload> GetSchemaPayload() override {
+    flight::FlightPayload payload;
+    ARROW_RETURN_NOT_OK(arrow::ipc::GetSchemaPayload(*stream_schema, options, mapper, &payload.ipc_message));
+    return payload;
+  }
+
+  arrow::Result<flight::FlightPayload> Next() override {
+    flight::FlightPayload payload;
+    while (true) {
+      auto chunk = reader->Next();
+      channel.report(chunk.status());
+      ARROW_RETURN_NOT_OK(chunk);
+      if (chunk->data == nullptr && chunk->app_metadata == nullptr) {
+        // Null IPC metadata ends the stream
+        finished = true;
+        if (fill != nullptr) {
+          fill->finish(stream_schema);
+        }
+        return payload;
+      }
+      // Metadata-only messages cannot be forwarded on their own, they carry nothing of a query result
+      if (chunk->data != nullptr) {
+        if (fill != nullptr) {
+          fill->add(chunk->data);
+        }
+        ARROW_RETURN_NOT_OK(arrow::ipc::GetRecordBatchPayload(*chunk->data, options, &payload.ipc_message));
+        payload.app_metadata = std::move(chunk->app_metadata);
+        return payload;
+      }
+    }
+  }
+
+  // A client that stops early must not leave the node streaming into the router
+  arrow::Status Close() override {
+    if (!finished) {
+      reader->Cancel();
+    }
+    return arrow::Status::OK();
+  }
+
+private:
+  node_channel_pool::lease channel;
+  std::unique_ptr<flight::FlightStreamReader> reader;
+  bool finished = false;
+  std::shared_ptr<arrow::Schema> stream_schema;
+  arrow::ipc::DictionaryFieldMapper mapper;
+  arrow::ipc::IpcWriteOptions options = arrow::ipc::IpcWriteOptions::Defaults();
+  std::shared_ptr<result_cache::fill> fill;
+};
+
+// Passes every batch of a result read on the router to a result cache fill on its way to the client
+class filling_reader : public arrow::RecordBatchReader {
+public:
+  filling_reader(std::shared_ptr<arrow::RecordBatchReader> reader, std::shared_ptr<result_cache::fill> fill)
+      : reader(std::move(reader))
+      , fill(std::move(fill)) {}
+
+  std::shared_ptr<arrow::Schema> schema() const override { return reader->schema(); }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    ARROW_RETURN_NOT_OK(reader->ReadNext(batch));
+    if (*batch != nullptr) {
+      fill->add(*batch);
+    } else if (!finished) {
+      finished = true;
+      fill->finish(reader->schema());
+    }
+    return arrow::Status::OK();
+  }
+
+  arrow::Status Close() override { return reader->Close(); }
+
+private:
+  std::shared_ptr<arrow::RecordBatchReader> reader;
+  std::shared_ptr<result_cache::fill> fill;
+  bool finished = false;
+};
+
+// Results of one query on several nodes read as one stream, an endpoint at a time
+class chained_reader : public arrow::RecordBatchReader {
+public:
+  using open_function = std::function<arrow::Result<std::shared_ptr<arrow::RecordBatchReader>>(size_t)>;
+
+  chained_reader(std::shared_ptr<arrow::Schema> schema, size_t count, open_function open)
+      : merged_schema(std::move(schema))
+      , count(count)
+      , open(std::move(open)) {}
+
+  std::shared_ptr<arrow::Schema> schema() const override { return merged_schema; }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    while (true) {
+      if (current == nullptr) {
+        if (next == count) {
+          *batch = nullptr;
+          return arrow::Status::OK();
+        }
+        ARROW_ASSIGN_OR_RAISE(current, open(next++));
+      }
+      ARROW_RETURN_NOT_OK(current->ReadNext(batch));
+      if (*batch != nullptr) {
+        // Node schemas differ in metadata and nullability, the batches carry the merged one
+        *batch = arrow::RecordBatch::Make(merged_schema, (*batch)->num_rows(), (*batch)->columns());
+        return arrow::Status::OK();
+      }
+      ARROW_RETURN_NOT_OK(current->Close());
+      current = nullptr;
+    }
+  }
+
+  arrow::Status Close() override { return current == nullptr ? arrow::Status::OK() : current->Close(); }
+
+private:
+  std::shared_ptr<arrow::Schema> merged_schema;
+  size_t count;
+  size_t next = 0;
+  open_function open;
+  std::shared_ptr<arrow::RecordBatchReader> current;
+};
+
 class flight_sql_router::impl {
 private:
-  std::vector<flight::Location> nodes;
+  using clock = std::chrono::steady_clock;
+
+  struct node_stream {
+    flight::Location location;
+    flight::Ticket ticket;
+  };
+
+  // A top-k query already running on the nodes, merged when the client fetches it
+  struct pending_merge {
+    top_k_plan plan;
+    std::shared_ptr<arrow::Schema> node_schema;
+    std::vector<node_stream> streams;
+    std::shared_ptr<result_cache::fill> fill;
+  };
+
+  // A node result proxied to the client and kept in the result cache
+  struct pending_fill {
+    node_stream stream;
+    std::shared_ptr<result_cache::fill> fill;
+  };
+
+  // The node list and the placement of the sharded tables, replaced as a whole
+  struct topology {
+    std::vector<flight::Location> nodes;
+    shard_catalog catalog;
+  };
+
   uint8_t receiver;
-  std::unordered_map<std::string, std::unique_ptr<flight::sql::FlightSqlClient>> client_cache;
+  router_options options;
+  // Results merged on the router, waiting for their DoGet
+  arrow_sql_bridge::handle_registry<arrow::Table> results;
+  arrow_sql_bridge::handle_registry<pending_merge> merges;
+  arrow_sql_bridge::handle_registry<pending_fill> fills;
+  schema_cache schemas;
+  result_cache cache;
+  replica_groups replicas;
+
+  node_channel_pool channels;
+
+  std::mutex topology_mutex;
+  std::shared_ptr<const topology> current_topology;
+  // Writes on sharded tables hold it shared. Applying a copied batch of a moving table and
+  // switching its placement hold it exclusively.
+  std::shared_mutex move_mutex;
+  // Sharded writes finished so far. A copied batch is only applied if none finished since it was
+  // read, as a write may have changed its rows after the read and found nothing to change in staging.
+  std::atomic<uint64_t> sharded_writes = 0;
+
+  std::mutex rebalance_mutex;
+  std::condition_variable rebalance_finished;
+  rebalance_progress progress;
+  clock::time_point rebalance_start;
+  std::thread rebalance_thread;
+  std::atomic<bool> stopping = false;
+
+  std::shared_ptr<const topology> get_topology() {
+    std::lock_guard lock(topology_mutex);
+    return current_topology;
+  }
+
+  void set_topology(std::vector<flight::Location> nodes, shard_catalog catalog) {
+    auto next = std::make_shared<const topology>(topology{std::move(nodes), std::move(catalog)});
+    std::lock_guard lock(topology_mutex);
+    current_topology = std::move(next);
+  }
+
+  // Router tickets name the node that holds the statement and carry its ticket verbatim
+  static arrow::Result<flight::Ticket>
+  make_ticket(const flight::Location& location, const flight::Ticket& node_ticket) {
+    ARROW_ASSIGN_OR_RAISE(
+        auto query_ticket,
+        flight::sql::CreateStatementQueryTicket(location.ToString() + "|" + node_ticket.ticket)
+    );
+    return flight::Ticket{std::move(query_ticket)};
+  }
+
+  // Members of the node's replica group, least loaded first
+  std::vector<flight::Location> ranked_replicas(const flight::Location& node) {
+    return replicas.by_load(node, [this](const flight::Location& member) { return channels.in_flight(member); });
+  }
 
-  static arrow::Result<flight::Ticket> make_ticket(const flight::Location& location, const std::string& query) {
-    ARROW_ASSIGN_OR_RAISE(auto query_ticket, flight::sql::CreateStatementQueryTicket(query));
-    return flight::Ticket{location.ToString() + "|" + std::move(query_ticket)};
+  // The member of the node's replica group a read goes to
+  flight::Location read_replica(const flight::Location& node) {
+    return ranked_replicas(node).front();
   }
 
-  arrow::Result<flight::sql::FlightSqlClient*> get_or_create_client(const flight::Location& location) {
-    std::string loc_str = location.ToString();
-    auto it = client_cache.find(loc_str);
-    if (it != client_cache.end()) {
-      return it->second.get();
+  arrow::Result<std::shared_ptr<arrow::Schema>> schema_on(const flight::Location& location, const std::string& query) {
+    ARROW_ASSIGN_OR_RAISE(auto channel, channels.acquire(read_replica(location)));
+    flight::FlightCallOptions call_options;
+    call_options.headers.push_back(kTypeNarrowingHeader);
+    auto result = channel->GetExecuteSchema(call_options, query);
+    channel.report(result.status());
+    ARROW_RETURN_NOT_OK(result);
+    arrow::ipc::DictionaryMemo memo;
+    return result.ValueOrDie()->GetSchema(&memo);
+  }
+
+  // Runs the statement on exactly this node or replica
+  arrow::Result<std::unique_ptr<flight::FlightInfo>>
+  execute_at(const flight::Location& location, const std::string& query, const arrow::StopToken& stop) {
+    ARROW_ASSIGN_OR_RAISE(auto channel, channels.acquire(location));
+    flight::FlightCallOptions call_options;
+    call_options.stop_token = stop;
+    call_options.headers.push_back(kTypeNarrowingHeader);
+    auto info = channel->Execute(call_options, query);
+    channel.report(info.status());
+    return info;
+  }
+
+  // Reads run on one member of the node's replica group. Its endpoints name it, where the node's
+  // own ones would be left without a location.
+  arrow::Result<std::unique_ptr<flight::FlightInfo>>
+  execute_on(const flight::Location& location, const std::string& query) {
+    const flight::Location target = writes_data(query) ? location : read_replica(location);
+    ARROW_ASSIGN_OR_RAISE(auto info, execute_at(target, query, arrow::StopToken::Unstoppable()));
+    if (target == location) {
+      return info;
     }
 
-    flight::FlightClientOptions options;
-    ARROW_ASSIGN_OR_RAISE(auto client, flight::FlightClient::Connect(location, options));
-    auto sql_client = std::make_unique<flight::sql::FlightSqlClient>(std::move(client));
-    auto sql_client_ptr = sql_client.get();
-    client_cache[loc_str] = std::move(sql_client);
-    return sql_client_ptr;
+    flight::FlightInfo::Data data;
+    data.schema = info->serialized_schema();
+    data.descriptor = info->descriptor();
+    data.endpoints = info->endpoints();
+    data.total_records = info->total_records();
+    data.total_bytes = info->total_bytes();
+    data.ordered = info->ordered();
+    data.app_metadata = info->app_metadata();
+    for (auto& endpoint : data.endpoints) {
+      if (endpoint.locations.empty()) {
+        endpoint.locations.push_back(target);
+      }
+    }
+    return std::make_unique<flight::FlightInfo>(std::move(data));
   }
 
-public:
-  explicit impl(std::vector<flight::Location> nodes, uint8_t receiver)
-      : nodes(std::move(nodes))
-      , receiver(receiver) {}
+  arrow::Result<std::shared_ptr<arrow::Table>> fetch_results(
+      const flight::Location& node,
+      const flight::FlightInfo& info,
+      const arrow::StopToken& stop = arrow::StopToken::Unstoppable()
+  ) {
+    std::vector<std::shared_ptr<arrow::Table>> tables;
+    for (const auto& endpoint : info.endpoints()) {
+      const flight::Location& location = endpoint.locations.empty() ? node : endpoint.locations.front();
+      ARROW_ASSIGN_OR_RAISE(auto channel, channels.acquire(location));
+      flight::FlightCallOptions call_options;
+      call_options.stop_token = stop;
+      auto table = channel->DoGet(call_options, endpoint.ticket).Map([](auto stream) { return stream->ToTable(); });
+      channel.report(table.status());
+      ARROW_RETURN_NOT_OK(table);
+      tables.push_back(std::move(table).ValueOrDie());
+    }
+    if (tables.size() == 1) {
+      return tables.front();
+    }
+    return arrow::ConcatenateTables(tables);
+  }
 
-  arrow::Result<std::unique_ptr<flight::FlightInfo>> GetFlightInfoStatement(
-      const flight::ServerCallContext&,
+  // Runs the statement on exactly this node or replica and collects its results on the router
+  arrow::Result<std::shared_ptr<arrow::Table>> execute_partial_at(
+      const flight::Location& location,
+      const std::string& query,
+      const arrow::StopToken& stop = arrow::StopToken::Unstoppable()
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto info, execute_at(location, query, stop));
+    return fetch_results(location, *info, stop);
+  }
+
+  // Writes reach every member of the node's replica group, reads one of them
+  arrow::Result<std::shared_ptr<arrow::Table>>
+  execute_partial(const flight::Location& location, const std::string& query) {
+    return writes_data(query) ? write_partial(location, query) : read_partial(location, query);
+  }
+
+  // Runs the write on all members in parallel and returns the node's own result. Members that fail
+  // while others apply it are marked stale.
+  arrow::Result<std::shared_ptr<arrow::Table>> write_partial(const flight::Location& node, const std::string& query) {
+    const auto members = replicas.members(node);
+    if (members.size() == 1) {
+      return execute_partial_at(node, query);
+    }
+
+    std::vector<std::future<arrow::Result<std::shared_ptr<arrow::Table>>>> pending;
+    for (const auto& member : members) {
+      pending.push_back(std::async(std::launch::async, [this, &member, &query] {
+        return execute_partial_at(member, query);
+      }));
+    }
+    std::shared_ptr<arrow::Table> result;
+    arrow::Status status;
+    std::vector<std::string> applied;
+    std::vector<flight::Location> failed;
+    for (size_t i = 0; i < pending.size(); i++) {
+      auto table = pending[i].get();
+      if (!table.ok()) {
+        failed.push_back(members[i]);
+        if (status.ok()) {
+          status = table.status().WithMessage(members[i].ToString(), ": ", table.status().message());
+        }
+        continue;
+      }
+      applied.push_back(members[i].ToString());
+      if (i == 0) {
+        result = std::move(table).ValueOrDie();
+      }
+    }
+    if (status.ok()) {
+      return result;
+    }
+    if (applied.empty()) {
+      return status;
+    }
+
+    // A member that failed is out of step with the others and serves no reads until it is resynced
+    std::string applied_on;
+    for (const auto& member : applied) {
+      applied_on += (applied_on.empty() ? "" : ", ") + member;
+    }
+    for (const auto& member : failed) {
+      replicas.mark_stale(member);
+      ARROW_LOG(WARNING) << "Replica " << member.ToString() << " missed a write applied on " << applied_on
+                         << " and is stale until resynced: " << query;
+    }
+    return status.WithMessage(status.message(), " (applied on ", applied_on, ")");
+  }
+
+  // Runs the read on the least loaded member of the node's replica group. If it outlasts the
+  // group's recent 95th percentile, or fails, the next member runs it as well; the first answer wins.
+  arrow::Result<std::shared_ptr<arrow::Table>> read_partial(const flight::Location& node, const std::string& query) {
+    const auto ranked = ranked_replicas(node);
+    if (ranked.size() == 1) {
+      return execute_partial_at(ranked.front(), query);
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<std::optional<arrow::Result<std::shared_ptr<arrow::Table>>>> results(2);
+    arrow::StopSource stop;
+    auto run = [&](size_t i) {
+      const auto start = clock::now();
+      auto result = execute_partial_at(ranked[i], query, stop.token());
+      // A read stopped because the other one won took at least this long
+      if (result.ok() || result.status().IsCancelled()) {
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start);
+        replicas.record_read(ranked[i], latency, i == 1);
+      }
+      std::lock_guard lock(mutex);
+      results[i] = std::move(result);
+      finished.notify_all();
+    };
+    auto answered = [&](size_t i) { return results[i].has_value() && results[i]->ok(); };
+
+    std::vector<std::future<void>> attempts;
+    attempts.push_back(std::async(std::launch::async, run, 0));
+    const auto delay = options.hedge_reads ? replicas.hedge_delay(node) : std::nullopt;
+    std::unique_lock lock(mutex);
+    if (delay.has_value()) {
+      finished.wait_for(lock, *delay, [&] { return results[0].has_value(); });
+    } else {
+      finished.wait(lock, [&] { return results[0].has_value(); });
+    }
+    if (!answered(0)) {
+      lock.unlock();
+      attempts.push_back(std::async(std::launch::async, run, 1));
+      lock.lock();
+    }
+    finished.wait(lock, [&] {
+      bool all = true;
+      for (size_t i = 0; i < attempts.size(); i++) {
+        if (answered(i)) {
+          return true;
+        }
+        all = all && results[i].has_value();
+      }
+      return all;
+    });
+    // The first error is reported when no attempt answered
+    auto result = answered(0) || !answered(1) ? std::move(*results[0]) : std::move(*results[1]);
+    lock.unlock();
+
+    stop.RequestStop();
+    for (auto& attempt : attempts) {
+      attempt.wait();
+    }
+    return result;
+  }
+
+  // Runs every statement on its node in parallel and collects the results on the router
+  arrow::Result<std::vector<std::shared_ptr<arrow::Table>>>
+  execute_partials(const std::vector<shard_statement>& statements, const std::vector<flight::Location>& nodes) {
+    std::vector<std::future<arrow::Result<std::shared_ptr<arrow::Table>>>> pending;
+    for (const auto& statement : statements) {
+      pending.push_back(std::async(std::launch::async, [this, &statement, &nodes]() {
+        return execute_partial(nodes[statement.node], statement.query);
+      }));
+    }
+
+    std::vector<std::shared_ptr<arrow::Table>> partials;
+    arrow::Status status;
+    for (size_t i = 0; i < pending.size(); i++) {
+      auto partial = pending[i].get();
+      if (!partial.ok() && status.ok()) {
+        status = partial.status().WithMessage(
+            nodes[statements[i].node].ToString(),
+            ": ",
+            partial.status().message()
+        );
+      } else if (partial.ok()) {
+        partials.push_back(std::move(partial).ValueOrDie());
+      }
+    }
+    ARROW_RETURN_NOT_OK(status);
+    return partials;
+  }
+
+  // A result computed on the router, served by its own DoGetStatement and kept by the fill, if any
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> make_local_info(
+      const std::shared_ptr<arrow::Table>& result,
+      const flight::FlightDescriptor& descriptor,
+      const std::shared_ptr<result_cache::fill>& fill = nullptr
+  ) {
+    if (fill != nullptr) {
+      arrow::TableBatchReader reader(result);
+      ARROW_ASSIGN_OR_RAISE(auto batches, reader.ToRecordBatches());
+      for (auto& batch : batches) {
+        fill->add(std::move(batch));
+      }
+      fill->finish(result->schema());
+    }
+
+    ARROW_ASSIGN_OR_RAISE(
+        auto ticket,
+        flight::sql::CreateStatementQueryTicket(kLocalResultLocation + "|" + results.put(result))
+    );
+
+    std::vector<flight::FlightEndpoint> endpoints{flight::FlightEndpoint{flight::Ticket{ticket}, {}, std::nullopt, ""}};
+    const bool ordered = false;
+    ARROW_ASSIGN_OR_RAISE(
+        auto info,
+        flight::FlightInfo::Make(*result->schema(), descriptor, endpoints, result->num_rows(), -1, ordered)
+    );
+    return std::make_unique<arrow::flight::FlightInfo>(info);
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_aggregate(
+      const aggregate_plan& plan,
+      const std::vector<flight::Location>& nodes,
+      const flight::FlightDescriptor& descriptor,
+      const std::shared_ptr<result_cache::fill>& fill
+  ) {
+    std::vector<shard_statement> statements;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      statements.push_back(shard_statement{i, plan.get_partial_query()});
+    }
+    ARROW_ASSIGN_OR_RAISE(auto partials, execute_partials(statements, nodes));
+    ARROW_ASSIGN_OR_RAISE(auto result, plan.merge(partials));
+    return make_local_info(result, descriptor, fill);
+  }
+
+  // Writes on sharded tables complete before the router answers, a concurrent move must
+  // not switch their table's placement halfway
+  arrow::Result<std::unique_ptr<flight::FlightInfo>>
+  execute_write(const std::string& query, const flight::FlightDescriptor& descriptor) {
+    std::shared_lock lock(move_mutex);
+    // Routed again: the placement may have changed since the statement was first routed
+    const auto snapshot = get_topology();
+    ARROW_ASSIGN_OR_RAISE(auto route, snapshot->catalog.route(query));
+    if (!route.has_value() || route->statements.empty()) {
+      return arrow::Status::Invalid("Statement does not write to a sharded table");
+    }
+    auto tables = execute_partials(route->statements, snapshot->nodes);
+    // Counted even when it failed, it may have taken effect on some of the nodes
+    sharded_writes++;
+    ARROW_RETURN_NOT_OK(tables);
+    return make_local_info(tables.ValueOrDie().front(), descriptor);
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_single(
       const flight::sql::StatementQuery& command,
-      const flight::FlightDescriptor& descriptor
+      const std::vector<flight::Location>& nodes,
+      const flight::FlightDescriptor& descriptor,
+      const std::shared_ptr<result_cache::fill>& fill
   ) {
     if (nodes.empty() || receiver >= nodes.size()) {
       return arrow::Status::Invalid("Invalid receiver index");
     }
 
     const auto& location = nodes[receiver];
-    ARROW_ASSIGN_OR_RAISE(auto client, get_or_create_client(location));
+    ARROW_ASSIGN_OR_RAISE(auto info, execute_on(location, command.query));
+    ARROW_ASSIGN_OR_RAISE(auto schema, info->GetSchema(nullptr));
+
+    // Node endpoints are either handed out as they are, pointing at the node, or re-issued as
+    // router tickets, so the results are proxied through DoGetStatement. A result that is to be
+    // cached has to come in one stream.
+    std::vector<flight::FlightEndpoint> endpoints;
+    const bool cached = fill != nullptr && info->endpoints().size() == 1;
+    for (const auto& endpoint : info->endpoints()) {
+      if (options.direct_endpoints) {
+        std::vector<flight::Location> locations = endpoint.locations;
+        if (locations.empty()) {
+          locations.push_back(location);
+        }
+        endpoints.push_back(
+            flight::FlightEndpoint{endpoint.ticket, std::move(locations), endpoint.expiration_time, ""}
+        );
+        continue;
+      }
+      // A replica that ran the read names itself in the endpoint
+      const auto& served_by = endpoint.locations.empty() ? location : endpoint.locations.front();
+      if (cached) {
+        auto pending = std::make_shared<pending_fill>(pending_fill{node_stream{served_by, endpoint.ticket}, fill});
+        ARROW_ASSIGN_OR_RAISE(
+            auto ticket,
+            flight::sql::CreateStatementQueryTicket(kCachedResultLocation + "|" + fills.put(std::move(pending)))
+        );
+        endpoints.push_back(flight::FlightEndpoint{flight::Ticket{std::move(ticket)}, {}, std::nullopt, ""});
+        continue;
+      }
+      ARROW_ASSIGN_OR_RAISE(auto ticket, make_ticket(served_by, endpoint.ticket));
+      endpoints.push_back(flight::FlightEndpoint{std::move(ticket), {}, std::nullopt, ""});
+    }
 
+    ARROW_ASSIGN_OR_RAISE(
+        auto result,
+        flight::FlightInfo::Make(
+            *schema,
+            descriptor,
+            endpoints,
+            info->total_records(),
+            info->total_bytes(),
+            info->ordered()
+        )
+    );
+    return std::make_unique<arrow::flight::FlightInfo>(result);
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_scatter(
+      const flight::sql::StatementQuery& command,
+      const std::vector<flight::Location>& nodes,
+      const flight::FlightDescriptor& descriptor
+  ) {
+    std::vector<shard_statement> statements;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      statements.push_back(shard_statement{i, command.query});
+    }
+    return execute_statements(statements, nodes, descriptor);
+  }
+
+  // Runs every statement on its node in parallel
+  arrow::Result<std::vector<std::unique_ptr<flight::FlightInfo>>>
+  execute_infos(const std::vector<shard_statement>& statements, const std::vector<flight::Location>& nodes) {
+    std::vector<std::future<arrow::Result<std::unique_ptr<flight::FlightInfo>>>> pending;
+    for (const auto& statement : statements) {
+      pending.push_back(std::async(std::launch::async, [this, &statement, &nodes] {
+        return execute_on(nodes[statement.node], statement.query);
+      }));
+    }
+
+    // Every future is collected before returning, the tasks reference this call's arguments
+    std::vector<std::unique_ptr<flight::FlightInfo>> infos;
+    arrow::Status status;
+    for (size_t i = 0; i < pending.size(); i++) {
+      auto info = pending[i].get();
+      if (!info.ok() && status.ok()) {
+        status = info.status().WithMessage(nodes[statements[i].node].ToString(), ": ", info.status().message());
+      } else if (info.ok()) {
+        infos.push_back(std::move(info).ValueOrDie());
+      }
+    }
+    ARROW_RETURN_NOT_OK(status);
+    return infos;
+  }
+
+  // Proxies one node result stream, the channel stays leased until the stream is done
+  arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> open_stream(const node_stream& stream) {
+    ARROW_ASSIGN_OR_RAISE(auto channel, channels.acquire(stream.location));
     flight::FlightCallOptions call_options;
-    ARROW_ASSIGN_OR_RAISE(auto info, client->Execute(call_options, command.query));
-    ARROW_ASSIGN_OR_RAISE(auto ticket, make_ticket(location, command.query));
-    // std::vector<flight::FlightEndpoint> endpoints{flight::FlightEndpoint{std::move(ticket), {}, std::nullopt, ""}};
-    std::shared_ptr<arrow::Schema> schema = arrow::schema({});
-    auto result = flight::FlightInfo::Make(
-                      *schema,
-                      descriptor,
-                      info->endpoints(),
-                      info->total_records(),
-                      info->total_bytes(),
-                      info->ordered()
-    )
-                      .ValueOrDie();
+    auto result = channel->DoGet(call_options, stream.ticket);
+    channel.report(result.status());
+    ARROW_RETURN_NOT_OK(result);
+
+    std::shared_ptr<flight::MetadataRecordBatchReader> shared_reader = std::move(result).ValueOrDie();
+    ARROW_ASSIGN_OR_RAISE(auto batch_reader, flight::MakeRecordBatchReader(shared_reader));
+    return std::make_shared<leased_reader>(std::move(channel), std::move(batch_reader));
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightDataStream>>
+  forward_stream(const node_stream& stream, const std::shared_ptr<result_cache::fill>& fill = nullptr) {
+    ARROW_ASSIGN_OR_RAISE(auto channel, channels.acquire(stream.location));
+    flight::FlightCallOptions call_options;
+    auto result = channel->DoGet(call_options, stream.ticket);
+    channel.report(result.status());
+    ARROW_RETURN_NOT_OK(result);
+
+    auto reader = std::move(result).ValueOrDie();
+    auto schema = reader->GetSchema();
+    channel.report(schema.status());
+    ARROW_RETURN_NOT_OK(schema);
+    // forwarding_stream only rebuilds record batch messages. Dictionaries, nested ones included, may
+    // change from batch to batch, so those streams go through dictionary_delta_stream, which sends
+    // every change.
+    if (arrow::ipc::DictionaryFieldMapper(*schema.ValueOrDie()).num_fields() > 0) {
+      std::shared_ptr<flight::MetadataRecordBatchReader> shared_reader = std::move(reader);
+      ARROW_ASSIGN_OR_RAISE(auto batch_reader, flight::MakeRecordBatchReader(shared_reader));
+      std::shared_ptr<arrow::RecordBatchReader> leased =
+          std::make_shared<leased_reader>(std::move(channel), std::move(batch_reader));
+      if (fill != nullptr) {
+        leased = std::make_shared<filling_reader>(std::move(leased), fill);
+      }
+      return arrow_sql_bridge::dictionary_delta_stream::make(std::move(leased));
+    }
+    return std::make_unique<forwarding_stream>(
+        std::move(channel),
+        std::move(reader),
+        std::move(schema).ValueOrDie(),
+        fill
+    );
+  }
+
+  // Runs `query` on all nodes and returns where to fetch every endpoint, with the schema they share
+  arrow::Result<std::shared_ptr<arrow::Schema>> execute_everywhere(
+      const std::string& query,
+      const std::vector<flight::Location>& nodes,
+      std::vector<node_stream>& streams
+  ) {
+    std::vector<shard_statement> statements;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      statements.push_back(shard_statement{i, query});
+    }
+    ARROW_ASSIGN_OR_RAISE(auto infos, execute_infos(statements, nodes));
+
+    std::vector<std::shared_ptr<arrow::Schema>> schemas;
+    for (size_t i = 0; i < infos.size(); i++) {
+      ARROW_ASSIGN_OR_RAISE(auto schema, infos[i]->GetSchema(nullptr));
+      schemas.push_back(std::move(schema));
+      for (const auto& endpoint : infos[i]->endpoints()) {
+        const auto& location = endpoint.locations.empty() ? nodes[i] : endpoint.locations.front();
+        streams.push_back(node_stream{location, endpoint.ticket});
+      }
+    }
+    return merge_schemas(schemas, nodes);
+  }
+
+  // Streams the results of `query` on all nodes through the router, one endpoint after another
+  arrow::Result<std::shared_ptr<arrow::RecordBatchReader>>
+  open_everywhere(const std::string& query, const std::vector<flight::Location>& nodes) {
+    std::vector<node_stream> streams;
+    ARROW_ASSIGN_OR_RAISE(auto schema, execute_everywhere(query, nodes, streams));
+    const size_t count = streams.size();
+    auto open = [this, streams = std::move(streams)](size_t i) { return open_stream(streams[i]); };
+    return std::make_shared<chained_reader>(std::move(schema), count, std::move(open));
+  }
+
+  // The nodes sort and cut their rows, the router merges them in DoGetStatement
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_top_k(
+      const top_k_plan& plan,
+      const std::vector<flight::Location>& nodes,
+      const flight::FlightDescriptor& descriptor,
+      const std::shared_ptr<result_cache::fill>& fill
+  ) {
+    auto merge = std::make_shared<pending_merge>(pending_merge{plan, nullptr, {}, fill});
+    ARROW_ASSIGN_OR_RAISE(merge->node_schema, execute_everywhere(plan.get_node_query(), nodes, merge->streams));
+    ARROW_ASSIGN_OR_RAISE(auto schema, plan.output_schema(*merge->node_schema));
+    ARROW_ASSIGN_OR_RAISE(
+        auto ticket,
+        flight::sql::CreateStatementQueryTicket(kMergedResultLocation + "|" + merges.put(std::move(merge)))
+    );
+
+    std::vector<flight::FlightEndpoint> endpoints{flight::FlightEndpoint{flight::Ticket{ticket}, {}, std::nullopt, ""}};
+    const bool ordered = true;
+    ARROW_ASSIGN_OR_RAISE(auto info, flight::FlightInfo::Make(*schema, descriptor, endpoints, -1, -1, ordered));
+    return std::make_unique<arrow::flight::FlightInfo>(info);
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_join(
+      const join_plan& plan,
+      const std::vector<flight::Location>& nodes,
+      const flight::FlightDescriptor& descriptor,
+      const std::shared_ptr<result_cache::fill>& fill
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto left, open_everywhere(plan.get_left_query(), nodes));
+    ARROW_ASSIGN_OR_RAISE(auto right, open_everywhere(plan.get_right_query(), nodes));
+
+    join_options join;
+    join.memory_budget = options.join_memory_budget;
+    join.spill_partitions = options.join_spill_partitions;
+    if (!options.join_spill_directory.empty()) {
+      join.spill_directory = options.join_spill_directory;
+    }
+    ARROW_ASSIGN_OR_RAISE(auto result, plan.execute(std::move(left), std::move(right), join));
+    return make_local_info(result, descriptor, fill);
+  }
+
+  // Runs every statement on its node in parallel, the endpoints of all of them make up the result
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_statements(
+      const std::vector<shard_statement>& statements,
+      const std::vector<flight::Location>& nodes,
+      const flight::FlightDescriptor& descriptor
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto infos, execute_infos(statements, nodes));
+
+    std::vector<std::shared_ptr<arrow::Schema>> schemas;
+    std::vector<flight::FlightEndpoint> endpoints;
+    int64_t total_records = 0;
+    int64_t total_bytes = 0;
+    for (size_t i = 0; i < infos.size(); i++) {
+      ARROW_ASSIGN_OR_RAISE(auto schema, infos[i]->GetSchema(nullptr));
+      schemas.push_back(std::move(schema));
+
+      for (const auto& endpoint : infos[i]->endpoints()) {
+        // Endpoints without a location are served by the node that returned them
+        std::vector<flight::Location> locations = endpoint.locations;
+        if (locations.empty()) {
+          locations.push_back(nodes[statements[i].node]);
+        }
+        endpoints.push_back(
+            flight::FlightEndpoint{endpoint.ticket, std::move(locations), endpoint.expiration_time, ""}
+        );
+      }
+
+      // Unknown (-1) on any node makes the total unknown
+      const int64_t records = infos[i]->total_records();
+      const int64_t bytes = infos[i]->total_bytes();
+      total_records = total_records < 0 || records < 0 ? -1 : total_records + records;
+      total_bytes = total_bytes < 0 || bytes < 0 ? -1 : total_bytes + bytes;
+    }
+
+    std::vector<flight::Location> statement_nodes;
+    for (const auto& statement : statements) {
+      statement_nodes.push_back(nodes[statement.node]);
+    }
+    ARROW_ASSIGN_OR_RAISE(auto schema, merge_schemas(schemas, statement_nodes));
+    const bool ordered = false;
+    ARROW_ASSIGN_OR_RAISE(
+        auto result,
+        flight::FlightInfo::Make(*schema, descriptor, endpoints, total_records, total_bytes, ordered)
+    );
     return std::make_unique<arrow::flight::FlightInfo>(result);
   }
 
+  // With results cached, nodes replicated or in scatter mode, statements other than reads complete
+  // on every replica before the router answers, and then the cached results they may have changed
+  // are dropped. Scatter mode writes rows on the receiver only, as single mode does, while schema
+  // changes reach every node.
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> execute_write_through(
+      const std::string& query,
+      const topology& snapshot,
+      const flight::FlightDescriptor& descriptor
+  ) {
+    auto info = [&]() -> arrow::Result<std::unique_ptr<flight::FlightInfo>> {
+      if (options.mode == execution_mode::sharded) {
+        ARROW_ASSIGN_OR_RAISE(auto route, snapshot.catalog.route(query));
+        if (route.has_value() && route->write) {
+          return execute_write(query, descriptor);
+        }
+      }
+      std::vector<shard_statement> statements;
+      const bool scatter_rows = options.mode == execution_mode::scatter && !changes_schema(query);
+      if (options.mode == execution_mode::single || scatter_rows) {
+        if (receiver >= snapshot.nodes.size()) {
+          return arrow::Status::Invalid("Invalid receiver index");
+        }
+        statements.push_back(shard_statement{receiver, query});
+      } else {
+        for (size_t i = 0; i < snapshot.nodes.size(); i++) {
+          statements.push_back(shard_statement{i, query});
+        }
+      }
+      ARROW_ASSIGN_OR_RAISE(auto tables, execute_partials(statements, snapshot.nodes));
+      return make_local_info(tables.front(), descriptor);
+    }();
+    // A failed statement may still have taken effect on some of the nodes
+    cache.invalidate_after(query);
+    return info;
+  }
+
+  // Creates every table and index of an existing node on a new, empty one
+  arrow::Status copy_schema(const flight::Location& source, const flight::Location& target) {
+    ARROW_ASSIGN_OR_RAISE(
+        auto definitions,
+        execute_partial(
+            source,
+            "select sql from sqlite_master where type in ('table', 'index') and sql is not null "
+            "and name not like 'sqlite_%' and substr(name, 1, 11) != '_rebalance_' "
+            "order by type = 'index';"
+        )
+    );
+    ARROW_ASSIGN_OR_RAISE(definitions, definitions->CombineChunks());
+    if (definitions->num_rows() == 0) {
+      return arrow::Status::OK();
+    }
+    const auto& sql = static_cast<const arrow::StringArray&>(*definitions->column(0)->chunk(0));
+    for (int64_t i = 0; i < sql.length(); i++) {
+      ARROW_RETURN_NOT_OK(execute_partial(target, sql.GetString(i)).status());
+    }
+    return arrow::Status::OK();
+  }
+
+  arrow::Status ingest(const flight::Location& location, const std::string& table, std::shared_ptr<arrow::Table> rows) {
+    flight::sql::TableDefinitionOptions table_options;
+    table_options.if_not_exist = flight::sql::TableDefinitionOptionsTableNotExistOption::kFail;
+    table_options.if_exists = flight::sql::TableDefinitionOptionsTableExistsOption::kAppend;
+    for (const auto& member : replicas.members(location)) {
+      ARROW_ASSIGN_OR_RAISE(auto channel, channels.acquire(member));
+      auto reader = std::make_shared<arrow::TableBatchReader>(rows);
+      auto ingested = channel->ExecuteIngest(flight::FlightCallOptions(), reader, table_options, table);
+      channel.report(ingested.status());
+      ARROW_RETURN_NOT_OK(ingested);
+    }
+    return arrow::Status::OK();
+  }
+
+  // Copies the rows of the ranges from their old to their new owner, a batch of keyset-paginated
+  // rows at a time. Rows inserted after `watermark` reached the staging table as dual writes.
+  // Batches are read and shipped to the batch table while writes go on, only moving a batch from
+  // there into staging holds them back.
+  arrow::Status copy_ranges(
+      const topology& nodes,
+      const sharded_table& table,
+      size_t from,
+      size_t to,
+      const std::vector<hash_ring::range>& ranges,
+      int64_t watermark
+  ) {
+    const std::string source = quote_name(table.name);
+    const std::string staging = quote_name(shard_catalog::staging_table(table.name));
+    const std::string batch_table = shard_catalog::batch_table(table.name);
+    const std::string predicate = range_predicate(table.key, ranges);
+    std::optional<int64_t> last;
+    int conflicts = 0;
+    while (!stopping.load()) {
+      // Under steady writes a batch would never apply, the last attempts keep writes out throughout
+      std::unique_lock lock(move_mutex, std::defer_lock);
+      if (conflicts >= kMaxCopyConflicts) {
+        lock.lock();
+      }
+      const uint64_t writes_before = sharded_writes.load();
+
+      std::string query = "select rowid, * from " + source + " where rowid <= " + std::to_string(watermark);
+      if (last.has_value()) {
+        query += " and rowid > " + std::to_string(*last);
+      }
+      query += " and (" + predicate + ") order by rowid limit " + std::to_string(options.rebalance_batch_rows) + ";";
+      // Rowids differ between replicas, the pages and the watermark all come from the node itself
+      ARROW_ASSIGN_OR_RAISE(auto batch, execute_partial_at(nodes.nodes[from], query));
+      if (batch->num_rows() == 0) {
+        return arrow::Status::OK();
+      }
+      ARROW_ASSIGN_OR_RAISE(batch, batch->CombineChunks());
+      ARROW_ASSIGN_OR_RAISE(auto last_rowid, batch->column(0)->chunk(0)->GetScalar(batch->num_rows() - 1));
+
+      ARROW_ASSIGN_OR_RAISE(batch, batch->RemoveColumn(0));
+      const int64_t rows = batch->num_rows();
+      ARROW_RETURN_NOT_OK(ingest(nodes.nodes[to], batch_table, std::move(batch)));
+
+      if (!lock.owns_lock()) {
+        lock.lock();
+      }
+      if (sharded_writes.load() != writes_before) {
+        ARROW_RETURN_NOT_OK(execute_partial(nodes.nodes[to], "delete from " + quote_name(batch_table) + ";").status());
+        conflicts++;
+        continue;
+      }
+      ARROW_RETURN_NOT_OK(
+          execute_partial(nodes.nodes[to], "insert into " + staging + " select * from " + quote_name(batch_table) + ";")
+              .status()
+      );
+      ARROW_RETURN_NOT_OK(execute_partial(nodes.nodes[to], "delete from " + quote_name(batch_table) + ";").status());
+      lock.unlock();
+
+      last = std::static_pointer_cast<arrow::Int64Scalar>(last_rowid)->value;
+      conflicts = 0;
+      std::lock_guard progress_lock(rebalance_mutex);
+      progress.rows_moved += rows;
+    }
+    return arrow::Status::Cancelled("Router is shutting down");
+  }
+
+  // Moves one table onto the current ring: staging tables on the receiving nodes, dual writes,
+  // a copy of the rows that existed when dual writes started, then the switch of placement.
+  arrow::Status move_table(const std::string& name) {
+    const auto before = get_topology();
+    const auto* table = before->catalog.find(name);
+    const auto ranges = before->catalog.pending_moves(name);
+    std::map<std::pair<size_t, size_t>, std::vector<hash_ring::range>> moves;
+    for (const auto& range : ranges) {
+      moves[{range.from, range.to}].push_back(range);
+    }
+
+    const std::string source = quote_name(name);
+    const std::string staging = quote_name(shard_catalog::staging_table(name));
+    const std::string batch_table = quote_name(shard_catalog::batch_table(name));
+    // Staged rows come back with the table's declared types, keys and constraints, which a
+    // "create table ... as select" would drop
+    ARROW_ASSIGN_OR_RAISE(
+        auto definitions,
+        execute_partial(
+            before->nodes.front(),
+            "select sql from sqlite_master where type = 'table' and name = " + quote_literal(name) + " collate nocase;"
+        )
+    );
+    ARROW_ASSIGN_OR_RAISE(definitions, definitions->CombineChunks());
+    if (definitions->num_rows() != 1) {
+      return arrow::Status::Invalid("Can't find the definition of table ", name);
+    }
+    const std::string definition =
+        static_cast<const arrow::StringArray&>(*definitions->column(0)->chunk(0)).GetString(0);
+    std::map<size_t, int64_t> watermarks;
+    for (const auto& [nodes, _] : moves) {
+      watermarks[nodes.first] = 0;
+      const auto& target = before->nodes[nodes.second];
+      for (const auto& table_name : {shard_catalog::staging_table(name), shard_catalog::batch_table(name)}) {
+        ARROW_ASSIGN_OR_RAISE(auto create, rename_definition(definition, table_name));
+        ARROW_RETURN_NOT_OK(execute_partial(target, "drop table if exists " + quote_name(table_name) + ";").status());
+        ARROW_RETURN_NOT_OK(execute_partial(target, create).status());
+      }
+    }
+
+    {
+      std::unique_lock lock(move_mutex);
+      set_topology(before->nodes, before->catalog.begin_move(name));
+      for (auto& [node, watermark] : watermarks) {
+        ARROW_ASSIGN_OR_RAISE(
+            auto max_rowid,
+            execute_partial_at(before->nodes[node], "select coalesce(max(rowid), 0) from " + source + ";")
+        );
+        ARROW_ASSIGN_OR_RAISE(auto value, max_rowid->column(0)->GetScalar(0));
+        watermark = std::static_pointer_cast<arrow::Int64Scalar>(value)->value;
+      }
+    }
+
+    arrow::Status status;
+    for (const auto& [nodes, node_ranges] : moves) {
+      status = copy_ranges(*before, *table, nodes.first, nodes.second, node_ranges, watermarks[nodes.first]);
+      if (!status.ok()) {
+        break;
+      }
+      std::lock_guard progress_lock(rebalance_mutex);
+      progress.ranges_done += node_ranges.size();
+    }
+
+    std::unique_lock lock(move_mutex);
+    std::vector<size_t> receivers;
+    for (const auto& [nodes, _] : moves) {
+      if (std::find(receivers.begin(), receivers.end(), nodes.second) == receivers.end()) {
+        receivers.push_back(nodes.second);
+      }
+    }
+    if (!status.ok()) {
+      // The old owners still have every row, only the staging tables go
+      set_topology(before->nodes, before->catalog);
+      for (size_t node : receivers) {
+        ARROW_UNUSED(execute_partial(before->nodes[node], "drop table if exists " + staging + ";"));
+        ARROW_UNUSED(execute_partial(before->nodes[node], "drop table if exists " + batch_table + ";"));
+      }
+      return status;
+    }
+
+    // Scans running while the switch is under way may see a moved row on both nodes
+    for (size_t node : receivers) {
+      ARROW_RETURN_NOT_OK(
+          execute_partial(before->nodes[node], "insert into " + source + " select * from " + staging + ";").status()
+      );
+      ARROW_RETURN_NOT_OK(execute_partial(before->nodes[node], "drop table " + staging + ";").status());
+      ARROW_RETURN_NOT_OK(execute_partial(before->nodes[node], "drop table " + batch_table + ";").status());
+    }
+    set_topology(before->nodes, get_topology()->catalog.end_move(name, true));
+    std::map<size_t, std::vector<hash_ring::range>> moved_away;
+    for (const auto& range : ranges) {
+      moved_away[range.from].push_back(range);
+    }
+    for (const auto& [node, node_ranges] : moved_away) {
+      ARROW_RETURN_NOT_OK(
+          execute_partial(
+              before->nodes[node],
+              "delete from " + source + " where " + range_predicate(table->key, node_ranges) + ";"
+          )
+              .status()
+      );
+    }
+    // Results read while the switch was under way may have seen moved rows twice
+    cache.invalidate({name});
+    return arrow::Status::OK();
+  }
+
+  arrow::Status rebalance() {
+    for (const auto& table : get_topology()->catalog.unbalanced_tables()) {
+      ARROW_RETURN_NOT_OK(move_table(table));
+
+      std::lock_guard lock(rebalance_mutex);
+      progress.tables_done++;
+    }
+    return arrow::Status::OK();
+  }
+
+public:
+  impl(std::vector<flight::Location> nodes, uint8_t receiver, const router_options& options, shard_catalog catalog)
+      : receiver(receiver)
+      , options(options)
+      , results(options.result_ttl)
+      , merges(options.result_ttl)
+      , fills(options.result_ttl)
+      , schemas(options.schema_cache_size)
+      , cache(options.result_cache_bytes, options.result_cache_entry_bytes)
+      , replicas(nodes, options.replicas)
+      , channels(options.channels_per_node) {
+    set_topology(std::move(nodes), std::move(catalog));
+  }
+
+  ~impl() {
+    stopping.store(true);
+    if (rebalance_thread.joinable()) {
+      rebalance_thread.join();
+    }
+  }
+
+  arrow::Result<std::unique_ptr<flight::FlightInfo>> GetFlightInfoStatement(
+      const flight::ServerCallContext&,
+      const flight::sql::StatementQuery& command,
+      const flight::FlightDescriptor& descriptor
+  ) {
+    if (changes_schema(command.query)) {
+      schemas.clear();
+    }
+    const auto snapshot = get_topology();
+    const bool write_through = cache.enabled() || replicas.replicated() || options.mode == execution_mode::scatter;
+    if (write_through && writes_data(command.query)) {
+      return execute_write_through(command.query, *snapshot, descriptor);
+    }
+    // Results of cacheable reads are served from the cache, or kept on their way to the client
+    std::shared_ptr<result_cache::fill> fill;
+    if (cache.enabled()) {
+      if (auto tables = result_cache::cacheable_tables(command.query)) {
+        ARROW_ASSIGN_OR_RAISE(auto cached, cache.find(command.query));
+        if (cached != nullptr) {
+          return make_local_info(cached, descriptor);
+        }
+        fill = cache.begin(command.query, std::move(*tables));
+      }
+    }
+
+    // Each node only sees its own rows of both tables, so joins are completed on the router
+    if (options.mode != execution_mode::single && options.distributed_join) {
+      if (auto plan = join_plan::parse(command.query)) {
+        return execute_join(*plan, snapshot->nodes, descriptor, fill);
+      }
+    }
+    switch (options.mode) {
+    case execution_mode::sharded: {
+      ARROW_ASSIGN_OR_RAISE(auto route, snapshot->catalog.route(command.query));
+      if (route.has_value() && route->write) {
+        return execute_write(command.query, descriptor);
+      }
+      if (route.has_value()) {
+        return execute_statements(route->statements, snapshot->nodes, descriptor);
+      }
+      [[fallthrough]];
+    }
+    case execution_mode::scatter:
+      if (options.aggregate_pushdown) {
+        if (auto plan = aggregate_plan::parse(command.query)) {
+          return execute_aggregate(*plan, snapshot->nodes, descriptor, fill);
+        }
+      }
+      if (auto plan = top_k_plan::parse(command.query)) {
+        return execute_top_k(*plan, snapshot->nodes, descriptor, fill);
+      }
+      return execute_scatter(command, snapshot->nodes, descriptor);
+    case execution_mode::single:
+    default:
+      return execute_single(command, snapshot->nodes, descriptor, fill);
+    }
+  }
+
+  // Mirrors the dispatch of GetFlightInfoStatement. Fan-out results have the same schema on every
+  // node, so the first node answers for all of them.
+  arrow::Result<std::shared_ptr<arrow::Schema>> plan_schema(const std::string& query) {
+    const auto snapshot = get_topology();
+    const auto& nodes = snapshot->nodes;
+    if (options.mode == execution_mode::single) {
+      if (nodes.empty() || receiver >= nodes.size()) {
+        return arrow::Status::Invalid("Invalid receiver index");
+      }
+      return schema_on(nodes[receiver], query);
+    }
+
+    // Fan-out results drop the per-node column metadata, see merge_schemas
+    auto fan_out_schema = [&](const std::string& node_query) -> arrow::Result<std::shared_ptr<arrow::Schema>> {
+      ARROW_ASSIGN_OR_RAISE(auto schema, schema_on(nodes.front(), node_query));
+      return merge_schemas({schema}, {nodes.front()});
+    };
+    if (options.distributed_join) {
+      if (auto plan = join_plan::parse(query)) {
+        ARROW_ASSIGN_OR_RAISE(auto left, fan_out_schema(plan->get_left_query()));
+        ARROW_ASSIGN_OR_RAISE(auto right, fan_out_schema(plan->get_right_query()));
+        return plan->output_schema(*left, *right);
+      }
+    }
+    if (options.mode == execution_mode::sharded) {
+      ARROW_ASSIGN_OR_RAISE(auto route, snapshot->catalog.route(query));
+      if (route.has_value() && route->write) {
+        // Writes are answered by the router with the result of their first statement
+        const auto& statement = route->statements.front();
+        return schema_on(nodes[statement.node], statement.query);
+      }
+      if (route.has_value()) {
+        return fan_out_schema(query);
+      }
+    }
+    if (options.aggregate_pushdown) {
+      if (auto plan = aggregate_plan::parse(query)) {
+        ARROW_ASSIGN_OR_RAISE(auto partial_schema, fan_out_schema(plan->get_partial_query()));
+        ARROW_ASSIGN_OR_RAISE(auto partial, arrow::Table::MakeEmpty(partial_schema));
+        ARROW_ASSIGN_OR_RAISE(auto merged, plan->merge({partial}));
+        return merged->schema();
+      }
+    }
+    if (auto plan = top_k_plan::parse(query)) {
+      ARROW_ASSIGN_OR_RAISE(auto node_schema, fan_out_schema(plan->get_node_query()));
+      return plan->output_schema(*node_schema);
+    }
+    return fan_out_schema(query);
+  }
+
+  arrow::Result<std::unique_ptr<flight::SchemaResult>> GetSchemaStatement(
+      const flight::ServerCallContext&,
+      const flight::sql::StatementQuery& command,
+      const flight::FlightDescriptor&
+  ) {
+    auto schema = schemas.find(command.query);
+    if (schema == nullptr) {
+      ARROW_ASSIGN_OR_RAISE(schema, plan_schema(command.query));
+      if (!changes_schema(command.query)) {
+        schemas.put(command.query, schema);
+      }
+    }
+    return flight::SchemaResult::Make(*schema);
+  }
+
+  schema_cache_stats get_schema_cache_stats() const {
+    return schemas.stats();
+  }
+
+  result_cache_stats get_result_cache_stats() {
+    return cache.stats();
+  }
+
+  std::vector<replica_stats> get_replica_stats() {
+    return replicas.stats();
+  }
+
+  arrow::Status mark_replica_resynced(const flight::Location& location) {
+    if (!replicas.mark_resynced(location)) {
+      return arrow::Status::Invalid("Node ", location.ToString(), " is not a member of a replica group");
+    }
+    return arrow::Status::OK();
+  }
+
   arrow::Result<std::unique_ptr<flight::FlightDataStream>>
   DoGetStatement(const flight::ServerCallContext&, const flight::sql::StatementQueryTicket& command) {
     std::string ticket_payload = command.statement_handle;
@@ -75,28 +1362,141 @@ public:
     }
 
     std::string location_str = ticket_payload.substr(0, delimiter);
-    std::string query = ticket_payload.substr(delimiter + 1);
+    if (location_str == kLocalResultLocation) {
+      auto result = results.take(ticket_payload.substr(delimiter + 1));
+      if (result == nullptr) {
+        return arrow::Status::Invalid("Unknown or expired result handle");
+      }
+      auto reader = std::make_shared<arrow::TableBatchReader>(result);
+      return arrow_sql_bridge::dictionary_delta_stream::make(std::move(reader));
+    }
+    if (location_str == kMergedResultLocation) {
+      auto merge = merges.take(ticket_payload.substr(delimiter + 1));
+      if (merge == nullptr) {
+        return arrow::Status::Invalid("Unknown or expired result handle");
+      }
+      std::vector<std::shared_ptr<arrow::RecordBatchReader>> streams;
+      for (const auto& stream : merge->streams) {
+        ARROW_ASSIGN_OR_RAISE(auto reader, open_stream(stream));
+        streams.push_back(std::move(reader));
+      }
+      ARROW_ASSIGN_OR_RAISE(auto reader, merge->plan.merge(merge->node_schema, std::move(streams)));
+      if (merge->fill != nullptr) {
+        reader = std::make_shared<filling_reader>(std::move(reader), merge->fill);
+      }
+      return arrow_sql_bridge::dictionary_delta_stream::make(std::move(reader));
+    }
+    if (location_str == kCachedResultLocation) {
+      auto pending = fills.take(ticket_payload.substr(delimiter + 1));
+      if (pending == nullptr) {
+        return arrow::Status::Invalid("Unknown or expired result handle");
+      }
+      return forward_stream(pending->stream, pending->fill);
+    }
+    flight::Ticket ticket{ticket_payload.substr(delimiter + 1)};
     ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::Parse(location_str));
-    ARROW_ASSIGN_OR_RAISE(auto client, get_or_create_client(location));
+    return forward_stream(node_stream{location, std::move(ticket)});
+  }
 
-    flight::FlightCallOptions call_options;
-    flight::Ticket ticket{query};
-    ARROW_ASSIGN_OR_RAISE(auto stream, client->DoGet(call_options, ticket));
+  arrow::Status add_node(const flight::Location& location) {
+    std::lock_guard lock(rebalance_mutex);
+    if (progress.running) {
+      return arrow::Status::Invalid("A rebalance is already running");
+    }
+    if (rebalance_thread.joinable()) {
+      rebalance_thread.join();
+    }
 
-    std::shared_ptr<flight::MetadataRecordBatchReader> shared_reader = std::move(stream);
-    ARROW_ASSIGN_OR_RAISE(auto batch_reader, flight::MakeRecordBatchReader(shared_reader));
-    return std::make_unique<flight::RecordBatchStream>(batch_reader);
+    const auto before = get_topology();
+    std::vector<flight::Location> nodes = before->nodes;
+    if (std::find(nodes.begin(), nodes.end(), location) != nodes.end()) {
+      return arrow::Status::Invalid("Node ", location.ToString(), " is already known");
+    }
+    // Fan-out queries reach the node as soon as it is added, so it needs every table first
+    ARROW_RETURN_NOT_OK(copy_schema(nodes.front(), location));
+
+    nodes.push_back(location);
+    std::vector<std::string> names;
+    for (const auto& node : nodes) {
+      names.push_back(node.ToString());
+    }
+    {
+      // Writes in flight were routed over the old node list
+      std::unique_lock move_lock(move_mutex);
+      set_topology(nodes, before->catalog.with_nodes(names));
+    }
+
+    const auto after = get_topology();
+    progress = rebalance_progress();
+    progress.running = true;
+    progress.tables_total = after->catalog.unbalanced_tables().size();
+    for (const auto& table : after->catalog.unbalanced_tables()) {
+      progress.ranges_total += after->catalog.pending_moves(table).size();
+    }
+    rebalance_start = clock::now();
+    rebalance_thread = std::thread([this] {
+      auto status = rebalance();
+      std::lock_guard lock(rebalance_mutex);
+      progress.running = false;
+      progress.status = status;
+      progress.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - rebalance_start);
+      rebalance_finished.notify_all();
+    });
+    return arrow::Status::OK();
+  }
+
+  rebalance_progress get_rebalance_progress() {
+    std::lock_guard lock(rebalance_mutex);
+    rebalance_progress current = progress;
+    if (current.running) {
+      current.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - rebalance_start);
+    }
+    const double seconds = std::chrono::duration<double>(current.elapsed).count();
+    current.rows_per_second = seconds > 0 ? current.rows_moved / seconds : 0;
+    return current;
+  }
+
+  arrow::Status wait_for_rebalance() {
+    std::unique_lock lock(rebalance_mutex);
+    rebalance_finished.wait(lock, [this] { return !progress.running; });
+    return progress.status;
   }
 };
 
 arrow::Result<std::shared_ptr<flight_sql_router>>
-flight_sql_router::make(const std::list<flight::Location>& nodes, uint8_t receiver) {
+flight_sql_router::make(const std::list<flight::Location>& nodes, uint8_t receiver, const router_options& options) {
   if (nodes.empty()) {
     return arrow::Status::Invalid("No nodes provided");
   }
 
   std::vector<flight::Location> nodes_vector(nodes.begin(), nodes.end());
-  auto impl_ptr = std::make_shared<impl>(std::move(nodes_vector), receiver);
+  if (options.replicas.size() > nodes_vector.size()) {
+    return arrow::Status::Invalid(
+        "Replicas given for ",
+        options.replicas.size(),
+        " groups but there are ",
+        nodes_vector.size(),
+        " nodes"
+    );
+  }
+  std::set<std::string> members;
+  for (const auto& node : nodes_vector) {
+    members.insert(node.ToString());
+  }
+  for (const auto& group : options.replicas) {
+    for (const auto& replica : group) {
+      if (!members.insert(replica.ToString()).second) {
+        return arrow::Status::Invalid("Node ", replica.ToString(), " is listed more than once");
+      }
+    }
+  }
+
+  std::vector<std::string> names;
+  for (const auto& node : nodes_vector) {
+    names.push_back(node.ToString());
+  }
+  ARROW_ASSIGN_OR_RAISE(auto catalog, shard_catalog::make(options.sharded_tables, names, options.ring_vnodes));
+  auto impl_ptr = std::make_shared<impl>(std::move(nodes_vector), receiver, options, std::move(catalog));
   return std::shared_ptr<flight_sql_router>(new flight_sql_router(std::move(impl_ptr)));
 }
 
@@ -115,6 +1515,42 @@ arrow::Result<std::unique_ptr<flight::FlightDataStream>> flight_sql_router::DoGe
   return impl_ptr->DoGetStatement(context, command);
 }
 
+arrow::Result<std::unique_ptr<flight::SchemaResult>> flight_sql_router::GetSchemaStatement(
+    const flight::ServerCallContext& context,
+    const flight::sql::StatementQuery& command,
+    const flight::FlightDescriptor& descriptor
+) {
+  return impl_ptr->GetSchemaStatement(context, command, descriptor);
+}
+
+schema_cache_stats flight_sql_router::get_schema_cache_stats() const {
+  return impl_ptr->get_schema_cache_stats();
+}
+
+result_cache_stats flight_sql_router::get_result_cache_stats() const {
+  return impl_ptr->get_result_cache_stats();
+}
+
+std::vector<replica_stats> flight_sql_router::get_replica_stats() const {
+  return impl_ptr->get_replica_stats();
+}
+
+arrow::Status flight_sql_router::mark_replica_resynced(const arrow::flight::Location& location) {
+  return impl_ptr->mark_replica_resynced(location);
+}
+
+arrow::Status flight_sql_router::add_node(const flight::Location& location) {
+  return impl_ptr->add_node(location);
+}
+
+rebalance_progress flight_sql_router::get_rebalance_progress() {
+  return impl_ptr->get_rebalance_progress();
+}
+
+arrow::Status flight_sql_router::wait_for_rebalance() {
+  return impl_ptr->wait_for_rebalance();
+}
+
 flight_sql_router::flight_sql_router(std::shared_ptr<impl> impl)
     : impl_ptr(std::move(impl)) {}
 
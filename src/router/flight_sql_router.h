@@ -3,20 +3,40 @@
 #include "arrow/flight/sql/server.h"
 #include "arrow/flight/types.h"
 #include "arrow/result.h"
+#include "replica_groups.h"
+#include "result_cache.h"
+#include "router_options.h"
+#include "schema_cache.h"
 #include "sqlite3.h"
 
+#include <chrono>
 #include <list>
 #include <utility>
 
 namespace arrow_sql_router {
+// Progress of the rebalance started by flight_sql_router::add_node
+struct rebalance_progress {
+  bool running = false;
+  size_t tables_total = 0;
+  size_t tables_done = 0;
+  // Ring ranges that change owner, summed over the tables
+  size_t ranges_total = 0;
+  size_t ranges_done = 0;
+  int64_t rows_moved = 0;
+  std::chrono::milliseconds elapsed{0};
+  double rows_per_second = 0;
+  arrow::Status status;
+};
+
 class flight_sql_router : public arrow::flight::sql::FlightSqlServerBase {
 public:
   ~flight_sql_router() override = default;
 
   static arrow::Result<std::shared_ptr<flight_sql_router>> make(
       const std::list<arrow::flight::Location>& nodes,
-      uint8_t receiver
-  ); // tmp receiver - No. of node that will answer
+      uint8_t receiver,
+      const router_options& options = router_options()
+  ); // tmp receiver - No. of node that will answer in single mode
 
   arrow::Result<std::unique_ptr<arrow::flight::FlightInfo>> GetFlightInfoStatement(
       const arrow::flight::ServerCallContext& context,
@@ -29,6 +49,33 @@ public:
       const arrow::flight::sql::StatementQueryTicket& command
   ) override;
 
+  // The schema GetFlightInfoStatement would report, planned on one node without running anything
+  arrow::Result<std::unique_ptr<arrow::flight::SchemaResult>> GetSchemaStatement(
+      const arrow::flight::ServerCallContext& context,
+      const arrow::flight::sql::StatementQuery& command,
+      const arrow::flight::FlightDescriptor& descriptor
+  ) override;
+
+  schema_cache_stats get_schema_cache_stats() const;
+
+  // Hits, misses and size of the result cache, see router_options::result_cache_bytes
+  result_cache_stats get_result_cache_stats() const;
+
+  // Reads, hedges and latency of every member of a replica group, see router_options::replicas
+  std::vector<replica_stats> get_replica_stats() const;
+
+  // Lets a replica that missed a write serve reads again, once its tables were brought back in step
+  arrow::Status mark_replica_resynced(const arrow::flight::Location& location);
+
+  // Adds a node to the router and starts moving the hash-partitioned tables onto the ring of
+  // the new node list in the background. Every existing table is created on the node first.
+  arrow::Status add_node(const arrow::flight::Location& location);
+
+  rebalance_progress get_rebalance_progress();
+
+  // Waits for the running rebalance and returns its outcome
+  arrow::Status wait_for_rebalance();
+
 private:
   class impl;
   std::shared_ptr<impl> impl_ptr;
@@ -0,0 +1,51 @@
+#include "hash_ring.h"
+
+#include "../bridge/shard_hash.h"
+
+#include <algorithm>
+
+namespace arrow_sql_router {
+hash_ring::hash_ring(const std::vector<std::string>& names, size_t vnodes) {
+  for (size_t node = 0; node < names.size(); node++) {
+    for (size_t i = 0; i < std::max<size_t>(vnodes, 1); i++) {
+      points.emplace_back(arrow_sql_bridge::shard_hash(names[node] + "#" + std::to_string(i)), node);
+    }
+  }
+  std::sort(points.begin(), points.end());
+}
+
+size_t hash_ring::owner(uint64_t hash) const {
+  auto it = std::lower_bound(points.begin(), points.end(), std::make_pair(hash, size_t{0}));
+  return it == points.end() ? points.front().second : it->second;
+}
+
+std::vector<hash_ring::range> hash_ring::moved_ranges(const hash_ring& from, const hash_ring& to) {
+  // Between two consecutive boundaries of either ring both owners are constant
+  std::vector<uint64_t> boundaries;
+  for (const auto* ring : {&from, &to}) {
+    for (const auto& point : ring->points) {
+      boundaries.push_back(point.first);
+    }
+  }
+  std::sort(boundaries.begin(), boundaries.end());
+  boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+  std::vector<range> ranges;
+  for (size_t i = 0; i < boundaries.size(); i++) {
+    const uint64_t begin = boundaries[(i + boundaries.size() - 1) % boundaries.size()];
+    const uint64_t end = boundaries[i];
+    const size_t old_owner = from.owner(end);
+    const size_t new_owner = to.owner(end);
+    if (old_owner == new_owner) {
+      continue;
+    }
+    if (!ranges.empty() && ranges.back().end == begin && ranges.back().from == old_owner &&
+        ranges.back().to == new_owner) {
+      ranges.back().end = end;
+    } else {
+      ranges.push_back(range{begin, end, old_owner, new_owner});
+    }
+  }
+  return ranges;
+}
+} // namespace arrow_sql_router
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace arrow_sql_router {
+// Consistent-hash ring over the router's nodes. Every node is placed at `vnodes` points
+// derived from its name, and a hash belongs to the first point at or after it. Adding a
+// node only takes over the arcs in front of its own points, the rest stays where it was.
+class hash_ring {
+public:
+  // An arc (begin, end] of the ring that changes owner; it wraps around when begin >= end
+  struct range {
+    uint64_t begin;
+    uint64_t end;
+    size_t from;
+    size_t to;
+  };
+
+  // Node i of the router is named by names[i], usually its location
+  hash_ring(const std::vector<std::string>& names, size_t vnodes);
+
+  size_t owner(uint64_t hash) const;
+
+  // Arcs owned by a different node in `to` than in `from`, adjacent arcs merged
+  static std::vector<range> moved_ranges(const hash_ring& from, const hash_ring& to);
+
+private:
+  // Sorted by hash
+  std::vector<std::pair<uint64_t, size_t>> points;
+};
+} // namespace arrow_sql_router
@@ -0,0 +1,112 @@
+#include "node_channel_pool.h"
+
+#include "arrow/flight/client.h"
+
+#include <algorithm>
+
+namespace flight = arrow::flight;
+
+arrow::Result<std::shared_ptr<flight::sql::FlightSqlClient>> dial_channel(const flight::Location& location) {
+  flight::FlightClientOptions client_options;
+  // gRPC shares subchannels between channels with equal arguments, a local pool gives
+  // every channel its own connection
+  client_options.generic_options.emplace_back("grpc.use_local_subchannel_pool", 1);
+  ARROW_ASSIGN_OR_RAISE(auto client, flight::FlightClient::Connect(location, client_options));
+  return std::make_shared<flight::sql::FlightSqlClient>(std::move(client));
+}
+
+namespace arrow_sql_router {
+node_channel_pool::lease::lease(lease&& other) noexcept
+    : owner(std::move(other.owner))
+    , index(other.index)
+    , client(std::move(other.client)) {}
+
+node_channel_pool::lease& node_channel_pool::lease::operator=(lease&& other) noexcept {
+  if (this != &other) {
+    release();
+    owner = std::move(other.owner);
+    index = other.index;
+    client = std::move(other.client);
+  }
+  return *this;
+}
+
+node_channel_pool::lease::~lease() {
+  release();
+}
+
+void node_channel_pool::lease::report(const arrow::Status& status) {
+  if (owner == nullptr || !status.IsIOError()) {
+    return;
+  }
+  std::lock_guard lock(owner->mutex);
+  // Only the client this lease used, a concurrent failure may have re-dialed already
+  auto& channel = owner->channels[index];
+  if (channel.client == client) {
+    channel.client.reset();
+  }
+}
+
+void node_channel_pool::lease::release() {
+  if (owner == nullptr) {
+    return;
+  }
+  std::lock_guard lock(owner->mutex);
+  owner->channels[index].in_flight--;
+  owner.reset();
+}
+
+node_channel_pool::node_channel_pool(size_t channels_per_node)
+    : channels_per_node(std::max<size_t>(channels_per_node, 1)) {}
+
+arrow::Result<node_channel_pool::lease> node_channel_pool::acquire(const flight::Location& location) {
+  auto target = get_or_create_node(location.ToString());
+
+  std::lock_guard lock(target->mutex);
+  const size_t count = target->channels.size();
+  size_t best = target->next;
+  for (size_t i = 1; i < count; i++) {
+    const size_t candidate = (target->next + i) % count;
+    if (target->channels[candidate].in_flight < target->channels[best].in_flight) {
+      best = candidate;
+    }
+  }
+  target->next = (best + 1) % count;
+
+  // Dialing does not wait for the connection, so holding the node lock here is cheap
+  auto& channel = target->channels[best];
+  if (channel.client == nullptr) {
+    ARROW_ASSIGN_OR_RAISE(channel.client, dial_channel(location));
+  }
+  channel.in_flight++;
+  return lease(target, best, channel.client);
+}
+
+int64_t node_channel_pool::in_flight(const flight::Location& location) {
+  auto target = get_or_create_node(location.ToString());
+  std::lock_guard lock(target->mutex);
+  int64_t total = 0;
+  for (const auto& channel : target->channels) {
+    total += channel.in_flight;
+  }
+  return total;
+}
+
+std::shared_ptr<node_channel_pool::node> node_channel_pool::get_or_create_node(const std::string& key) {
+  {
+    std::shared_lock lock(nodes_mutex);
+    auto it = nodes.find(key);
+    if (it != nodes.end()) {
+      return it->second;
+    }
+  }
+
+  std::unique_lock lock(nodes_mutex);
+  auto& entry = nodes[key];
+  if (entry == nullptr) {
+    entry = std::make_shared<node>();
+    entry->channels.resize(channels_per_node);
+  }
+  return entry;
+}
+} // namespace arrow_sql_router
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "arrow/flight/sql/client.h"
+#include "arrow/result.h"
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace arrow_sql_router {
+// Flight SQL clients for the backend nodes, several gRPC channels per node. Every call
+// takes the channel of its node with the fewest calls in flight; a channel whose call
+// failed at the transport level is dropped and dialed again by the next caller.
+class node_channel_pool {
+private:
+  struct channel {
+    std::shared_ptr<arrow::flight::sql::FlightSqlClient> client;
+    int64_t in_flight = 0;
+  };
+
+  struct node {
+    std::mutex mutex;
+    std::vector<channel> channels;
+    // Where the search for the least busy channel starts, spreads ties round-robin
+    size_t next = 0;
+  };
+
+public:
+  // A channel held for the duration of one call, or of a whole result stream
+  class lease {
+  public:
+    lease(lease&& other) noexcept;
+    lease& operator=(lease&& other) noexcept;
+    lease(const lease&) = delete;
+    lease& operator=(const lease&) = delete;
+    ~lease();
+
+    arrow::flight::sql::FlightSqlClient* operator->() const { return client.get(); }
+
+    // Transport failures (IOError) make the pool re-dial the channel
+    void report(const arrow::Status& status);
+
+  private:
+    friend class node_channel_pool;
+
+    std::shared_ptr<node> owner;
+    size_t index;
+    std::shared_ptr<arrow::flight::sql::FlightSqlClient> client;
+
+    lease(std::shared_ptr<node> owner, size_t index, std::shared_ptr<arrow::flight::sql::FlightSqlClient> client)
+        : owner(std::move(owner))
+        , index(index)
+        , client(std::move(client)) {}
+
+    void release();
+  };
+
+  explicit node_channel_pool(size_t channels_per_node);
+
+  arrow::Result<lease> acquire(const arrow::flight::Location& location);
+
+  // Calls and result streams under way to the node, over all of its channels
+  int64_t in_flight(const arrow::flight::Location& location);
+
+private:
+  size_t channels_per_node;
+  std::shared_mutex nodes_mutex;
+  std::unordered_map<std::string, std::shared_ptr<node>> nodes;
+
+  std::shared_ptr<node> get_or_create_node(const std::string& key);
+};
+} // namespace arrow_sql_router
@@ -0,0 +1,478 @@
+#include "ordered_merge.h"
+
+#include "arrow/array.h"
+#include "arrow/builder.h"
+#include "sql_text.h"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+
+// Rows per merged batch; top-k results are small, this only bounds large offsets and limits
+constexpr int64_t kMergeBatchRows = 64 * 1024;
+
+struct merge_key {
+  int column;
+  bool descending;
+  bool nulls_first;
+};
+
+struct sql_number {
+  bool integer;
+  int64_t integer_value;
+  double real_value;
+};
+
+std::optional<sql_number> number_at(const arrow::Array& array, int64_t row) {
+  auto integer = [](int64_t value) { return sql_number{true, value, static_cast<double>(value)}; };
+  auto real = [](double value) { return sql_number{false, 0, value}; };
+  switch (array.type_id()) {
+  case arrow::Type::BOOL:
+    return integer(static_cast<const arrow::BooleanArray&>(array).Value(row) ? 1 : 0);
+  case arrow::Type::INT8:
+    return integer(static_cast<const arrow::Int8Array&>(array).Value(row));
+  case arrow::Type::INT16:
+    return integer(static_cast<const arrow::Int16Array&>(array).Value(row));
+  case arrow::Type::INT32:
+    return integer(static_cast<const arrow::Int32Array&>(array).Value(row));
+  case arrow::Type::INT64:
+    return integer(static_cast<const arrow::Int64Array&>(array).Value(row));
+  case arrow::Type::UINT8:
+    return integer(static_cast<const arrow::UInt8Array&>(array).Value(row));
+  case arrow::Type::UINT16:
+    return integer(static_cast<const arrow::UInt16Array&>(array).Value(row));
+  case arrow::Type::UINT32:
+    return integer(static_cast<const arrow::UInt32Array&>(array).Value(row));
+  case arrow::Type::UINT64:
+    return integer(static_cast<int64_t>(static_cast<const arrow::UInt64Array&>(array).Value(row)));
+  case arrow::Type::FLOAT:
+    return real(static_cast<const arrow::FloatArray&>(array).Value(row));
+  case arrow::Type::DOUBLE:
+    return real(static_cast<const arrow::DoubleArray&>(array).Value(row));
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<std::string_view> bytes_at(const arrow::Array& array, int64_t row) {
+  switch (array.type_id()) {
+  case arrow::Type::STRING:
+    return static_cast<const arrow::StringArray&>(array).GetView(row);
+  case arrow::Type::LARGE_STRING:
+    return static_cast<const arrow::LargeStringArray&>(array).GetView(row);
+  case arrow::Type::BINARY:
+    return static_cast<const arrow::BinaryArray&>(array).GetView(row);
+  case arrow::Type::LARGE_BINARY:
+    return static_cast<const arrow::LargeBinaryArray&>(array).GetView(row);
+  case arrow::Type::FIXED_SIZE_BINARY:
+    return static_cast<const arrow::FixedSizeBinaryArray&>(array).GetView(row);
+  default:
+    return std::nullopt;
+  }
+}
+
+// SQLite orders values of different storage classes as numbers < text < blobs
+int storage_class(const arrow::Array& array) {
+  switch (array.type_id()) {
+  case arrow::Type::STRING:
+  case arrow::Type::LARGE_STRING:
+    return 1;
+  case arrow::Type::BINARY:
+  case arrow::Type::LARGE_BINARY:
+  case arrow::Type::FIXED_SIZE_BINARY:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+// Cells of the bridge's union columns are compared by the value they hold
+std::pair<const arrow::Array*, int64_t> resolve_union(const arrow::Array* array, int64_t row) {
+  while (array->type_id() == arrow::Type::DENSE_UNION || array->type_id() == arrow::Type::SPARSE_UNION) {
+    const auto& union_array = static_cast<const arrow::UnionArray&>(*array);
+    const int child_id = union_array.child_id(row);
+    if (array->type_id() == arrow::Type::DENSE_UNION) {
+      row = static_cast<const arrow::DenseUnionArray&>(*array).value_offset(row);
+    }
+    array = union_array.field(child_id).get();
+  }
+  return {array, row};
+}
+
+// Compares two cells the way SQLite's ORDER BY does with the default BINARY collation
+int compare_cells(
+    const arrow::Array& left,
+    int64_t left_row,
+    const arrow::Array& right,
+    int64_t right_row,
+    const merge_key& key
+) {
+  auto [a, i] = resolve_union(&left, left_row);
+  auto [b, j] = resolve_union(&right, right_row);
+  const bool a_null = a->IsNull(i);
+  const bool b_null = b->IsNull(j);
+  if (a_null || b_null) {
+    if (a_null == b_null) {
+      return 0;
+    }
+    return a_null == key.nulls_first ? -1 : 1;
+  }
+
+  int result = 0;
+  const int a_class = storage_class(*a);
+  const int b_class = storage_class(*b);
+  if (a_class != b_class) {
+    result = a_class < b_class ? -1 : 1;
+  } else if (a_class == 0) {
+    auto x = number_at(*a, i);
+    auto y = number_at(*b, j);
+    if (!x.has_value() || !y.has_value()) {
+      // Not a type SQLite returns; keep the node order
+      return 0;
+    }
+    if (x->integer && y->integer) {
+      result = x->integer_value < y->integer_value ? -1 : x->integer_value > y->integer_value ? 1 : 0;
+    } else {
+      result = x->real_value < y->real_value ? -1 : x->real_value > y->real_value ? 1 : 0;
+    }
+  } else {
+    const int order = bytes_at(*a, i)->compare(*bytes_at(*b, j));
+    result = order < 0 ? -1 : order > 0 ? 1 : 0;
+  }
+  return key.descending ? -result : result;
+}
+
+struct merge_cursor {
+  std::shared_ptr<arrow::RecordBatchReader> stream;
+  std::shared_ptr<arrow::RecordBatch> batch;
+  int64_t row = 0;
+};
+
+// k-way merge of sorted streams: a heap of cursors ordered by their current row. Runs of rows
+// that stay ahead of every other cursor are copied as one slice.
+class merging_reader : public arrow::RecordBatchReader {
+public:
+  merging_reader(
+      std::shared_ptr<arrow::Schema> output_schema,
+      std::vector<std::shared_ptr<arrow::RecordBatchReader>> streams,
+      std::vector<merge_key> keys,
+      int64_t offset,
+      int64_t limit
+  )
+      : output_schema(std::move(output_schema))
+      , keys(std::move(keys))
+      , offset(offset)
+      , end(offset + limit) {
+    for (auto& stream : streams) {
+      cursors.push_back(merge_cursor{std::move(stream), nullptr, 0});
+    }
+  }
+
+  std::shared_ptr<arrow::Schema> schema() const override { return output_schema; }
+
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+    if (!started) {
+      started = true;
+      for (size_t i = 0; i < cursors.size(); i++) {
+        ARROW_RETURN_NOT_OK(advance(i));
+      }
+    }
+
+    std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
+    for (const auto& field : output_schema->fields()) {
+      ARROW_ASSIGN_OR_RAISE(auto builder, arrow::MakeBuilder(field->type()));
+      builders.push_back(std::move(builder));
+    }
+
+    int64_t rows = 0;
+    while (!heap.empty() && emitted < end && rows < kMergeBatchRows) {
+      std::pop_heap(heap.begin(), heap.end(), heap_order{this});
+      const size_t current = heap.back();
+      heap.pop_back();
+
+      auto& cursor = cursors[current];
+      const int64_t begin = cursor.row;
+      do {
+        cursor.row++;
+        emitted++;
+      } while (emitted < end && rows + (cursor.row - begin) < kMergeBatchRows &&
+               cursor.row < cursor.batch->num_rows() && (heap.empty() || !row_less(heap.front(), current)));
+
+      // Rows before the offset are pulled but not returned
+      const int64_t run = cursor.row - begin;
+      const int64_t skipped = std::clamp<int64_t>(offset - (emitted - run), 0, run);
+      if (skipped < run) {
+        for (int i = 0; i < output_schema->num_fields(); i++) {
+          ARROW_RETURN_NOT_OK(builders[i]->AppendArraySlice(
+              arrow::ArraySpan(*cursor.batch->column(i)->data()),
+              begin + skipped,
+              run - skipped
+          ));
+        }
+        rows += run - skipped;
+      }
+
+      if (cursor.row == cursor.batch->num_rows()) {
+        ARROW_RETURN_NOT_OK(advance(current));
+      } else {
+        push(current);
+      }
+    }
+
+    if (rows == 0) {
+      *batch = nullptr;
+      return Close();
+    }
+    std::vector<std::shared_ptr<arrow::Array>> columns;
+    for (auto& builder : builders) {
+      ARROW_ASSIGN_OR_RAISE(auto column, builder->Finish());
+      columns.push_back(std::move(column));
+    }
+    *batch = arrow::RecordBatch::Make(output_schema, rows, std::move(columns));
+    return arrow::Status::OK();
+  }
+
+  // The node streams are closed as soon as the limit is reached, nothing past it is pulled
+  arrow::Status Close() override {
+    arrow::Status status;
+    for (auto& cursor : cursors) {
+      if (cursor.stream != nullptr) {
+        status &= cursor.stream->Close();
+        cursor.stream = nullptr;
+        cursor.batch = nullptr;
+      }
+    }
+    heap.clear();
+    return status;
+  }
+
+private:
+  std::shared_ptr<arrow::Schema> output_schema;
+  std::vector<merge_key> keys;
+  int64_t offset;
+  int64_t end;
+  int64_t emitted = 0;
+  bool started = false;
+  std::vector<merge_cursor> cursors;
+  std::vector<size_t> heap;
+
+  // Ties go to the lower stream, so equal rows keep a stable order
+  bool row_less(size_t left, size_t right) const {
+    const auto& a = cursors[left];
+    const auto& b = cursors[right];
+    for (const auto& key : keys) {
+      const int order = compare_cells(*a.batch->column(key.column), a.row, *b.batch->column(key.column), b.row, key);
+      if (order != 0) {
+        return order < 0;
+      }
+    }
+    return left < right;
+  }
+
+  // std heaps keep the largest element on top, the merge wants the smallest row
+  struct heap_order {
+    const merging_reader* reader;
+
+    bool operator()(size_t left, size_t right) const { return reader->row_less(right, left); }
+  };
+
+  void push(size_t cursor) {
+    heap.push_back(cursor);
+    std::push_heap(heap.begin(), heap.end(), heap_order{this});
+  }
+
+  // Moves to the next non-empty batch of the stream, a finished stream leaves the heap
+  arrow::Status advance(size_t index) {
+    auto& cursor = cursors[index];
+    cursor.row = 0;
+    do {
+      ARROW_ASSIGN_OR_RAISE(cursor.batch, cursor.stream->Next());
+    } while (cursor.batch != nullptr && cursor.batch->num_rows() == 0);
+    if (cursor.batch != nullptr) {
+      push(index);
+    }
+    return arrow::Status::OK();
+  }
+};
+
+bool is_integer_literal(const std::string& text) {
+  return !text.empty() && text.size() < 19 && std::all_of(text.begin(), text.end(), [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+  });
+}
+
+// Strips a trailing modifier word of an ORDER BY item, returns it lower-cased
+std::string pop_trailing_word(std::string& item, const std::set<std::string>& modifiers) {
+  const auto words = scan_words(item);
+  if (words.empty() || words.back().depth != 0 || words.back().end != item.size() ||
+      !modifiers.contains(words.back().text)) {
+    return "";
+  }
+  std::string word = words.back().text;
+  item = trim(item.substr(0, words.back().begin));
+  return word;
+}
+
+namespace arrow_sql_router {
+std::optional<top_k_plan> top_k_plan::parse(const std::string& query) {
+  const std::string sql = trim(query);
+  const auto words = scan_words(sql);
+  if (words.empty() || words.front().text != "select" || words.front().begin != 0) {
+    return std::nullopt;
+  }
+
+  static const std::set<std::string> unsupported{
+      "distinct", "group", "having", "union", "intersect", "except", "over", "window", "collate",
+  };
+  static const std::set<std::string> aggregates{"count", "sum", "avg", "total", "group_concat", "min", "max"};
+  const sql_word* from = nullptr;
+  const sql_word* order = nullptr;
+  const sql_word* limit = nullptr;
+  for (size_t i = 1; i < words.size(); i++) {
+    const auto& word = words[i];
+    if (unsupported.contains(word.text)) {
+      return std::nullopt;
+    }
+    const size_t next = sql.find_first_not_of(" \t\r\n", word.end);
+    if (from == nullptr && aggregates.contains(word.text) && next != std::string::npos && sql[next] == '(') {
+      return std::nullopt;
+    }
+    if (word.depth != 0) {
+      continue;
+    }
+    if (word.text == "from" && from == nullptr) {
+      from = &word;
+    } else if (word.text == "order" && from != nullptr && i + 1 < words.size() && words[i + 1].text == "by") {
+      order = &words[i + 1];
+      limit = nullptr;
+    } else if (word.text == "limit") {
+      limit = &word;
+    }
+  }
+  if (from == nullptr || order == nullptr || limit == nullptr || limit < order) {
+    return std::nullopt;
+  }
+
+  top_k_plan plan;
+  // LIMIT k, LIMIT k OFFSET m or LIMIT m, k
+  const std::string limit_clause = trim(sql.substr(limit->end));
+  const auto limit_words = scan_words(limit_clause);
+  std::string separators;
+  for (char c : limit_clause) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && !std::isspace(static_cast<unsigned char>(c))) {
+      separators.push_back(c);
+    }
+  }
+  if (limit_words.size() == 1 && separators.empty() && is_integer_literal(limit_words[0].text)) {
+    plan.limit = std::stoll(limit_words[0].text);
+  } else if (limit_words.size() == 3 && separators.empty() && limit_words[1].text == "offset" &&
+             is_integer_literal(limit_words[0].text) && is_integer_literal(limit_words[2].text)) {
+    plan.limit = std::stoll(limit_words[0].text);
+    plan.offset = std::stoll(limit_words[2].text);
+  } else if (limit_words.size() == 2 && separators == "," && is_integer_literal(limit_words[0].text) &&
+             is_integer_literal(limit_words[1].text)) {
+    plan.offset = std::stoll(limit_words[0].text);
+    plan.limit = std::stoll(limit_words[1].text);
+  } else {
+    return std::nullopt;
+  }
+
+  const auto items = split_top_level(sql.substr(words.front().end, from->begin - words.front().end));
+  const bool has_star = std::any_of(items.begin(), items.end(), [](const std::string& item) {
+    return item == "*" || item.ends_with(".*");
+  });
+
+  std::vector<std::string> hidden;
+  for (auto item : split_top_level(sql.substr(order->end, limit->begin - order->end))) {
+    std::optional<bool> nulls_first;
+    const std::string nulls_position = pop_trailing_word(item, {"first", "last"});
+    if (!nulls_position.empty()) {
+      if (pop_trailing_word(item, {"nulls"}).empty()) {
+        return std::nullopt;
+      }
+      nulls_first = nulls_position == "first";
+    }
+    const bool descending = pop_trailing_word(item, {"asc", "desc"}) == "desc";
+    if (item.empty()) {
+      return std::nullopt;
+    }
+    // SQLite puts NULLs first in ascending order
+    sort_key key{0, false, descending, nulls_first.value_or(!descending)};
+
+    if (is_integer_literal(item)) {
+      const size_t position = std::stoull(item);
+      if (position == 0) {
+        return std::nullopt;
+      }
+      key.column = position - 1;
+      plan.keys.push_back(key);
+      continue;
+    }
+
+    auto match = std::find_if(items.begin(), items.end(), [&](const std::string& select_item) {
+      auto [expression, alias] = split_alias(select_item);
+      return canonical(expression) == canonical(item) || (!alias.empty() && canonical(alias) == canonical(item));
+    });
+    if (match != items.end() && has_star) {
+      // Its position is not known before the stars are expanded
+      auto [expression, alias] = split_alias(*match);
+      if (canonical(expression) != canonical(item)) {
+        return std::nullopt;
+      }
+      match = items.end();
+    }
+    if (match != items.end()) {
+      key.column = static_cast<size_t>(match - items.begin());
+    } else {
+      key.column = hidden.size();
+      key.hidden = true;
+      hidden.push_back(item);
+    }
+    plan.keys.push_back(key);
+  }
+  plan.hidden_count = hidden.size();
+
+  // Hidden keys go last, so ORDER BY positions keep pointing at the same columns
+  plan.node_query = trim(sql.substr(0, from->begin));
+  for (size_t i = 0; i < hidden.size(); i++) {
+    plan.node_query += ", " + hidden[i] + " as __order_" + std::to_string(i);
+  }
+  plan.node_query += " " + trim(sql.substr(from->begin, limit->begin - from->begin));
+  plan.node_query += " limit " + std::to_string(plan.offset + plan.limit);
+  return plan;
+}
+
+const std::string& top_k_plan::get_node_query() const {
+  return node_query;
+}
+
+arrow::Result<std::shared_ptr<arrow::Schema>> top_k_plan::output_schema(const arrow::Schema& node_schema) const {
+  const int visible = node_schema.num_fields() - static_cast<int>(hidden_count);
+  if (visible <= 0) {
+    return arrow::Status::Invalid("Node result has ", node_schema.num_fields(), " columns, expected more");
+  }
+  for (const auto& key : keys) {
+    if (!key.hidden && key.column >= static_cast<size_t>(visible)) {
+      return arrow::Status::Invalid("ORDER BY term ", key.column + 1, " is out of range");
+    }
+  }
+  std::vector<std::shared_ptr<arrow::Field>> fields(
+      node_schema.fields().begin(),
+      node_schema.fields().begin() + visible
+  );
+  return arrow::schema(std::move(fields));
+}
+
+arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> top_k_plan::merge(
+    std::shared_ptr<arrow::Schema> node_schema,
+    std::vector<std::shared_ptr<arrow::RecordBatchReader>> streams
+) const {
+  ARROW_ASSIGN_OR_RAISE(auto schema, output_schema(*node_schema));
+  std::vector<merge_key> merge_keys;
+  for (const auto& key : keys) {
+    const size_t column = key.hidden ? schema->num_fields() + key.column : key.column;
+    merge_keys.push_back(merge_key{static_cast<int>(column), key.descending, key.nulls_first});
+  }
+  return std::make_shared<merging_reader>(std::move(schema), std::move(streams), std::move(merge_keys), offset, limit);
+}
+} // namespace arrow_sql_router
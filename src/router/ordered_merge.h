@@ -0,0 +1,50 @@
+#pragma once
+
+#include "arrow/record_batch.h"
+#include "arrow/result.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace arrow_sql_router {
+// A fan-out SELECT ending in ORDER BY ... LIMIT k [OFFSET m]. Every node runs it with the
+// offset folded into its limit, so it returns at most m + k rows already in order; the router
+// merges the sorted streams and stops once the first m + k rows have gone by. Sort keys which
+// are not plain result columns are returned by the nodes as extra trailing columns that the
+// merge drops. GROUP BY, DISTINCT, aggregates, set operations and collations are not recognized.
+class top_k_plan {
+public:
+  static std::optional<top_k_plan> parse(const std::string& query);
+
+  const std::string& get_node_query() const;
+
+  // Schema of the merged result given the one the node query returns
+  arrow::Result<std::shared_ptr<arrow::Schema>> output_schema(const arrow::Schema& node_schema) const;
+
+  // Streams are read lazily, a batch at a time, and closed once the limit is reached
+  arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> merge(
+      std::shared_ptr<arrow::Schema> node_schema,
+      std::vector<std::shared_ptr<arrow::RecordBatchReader>> streams
+  ) const;
+
+private:
+  struct sort_key {
+    // Result column, or one of the trailing columns when hidden
+    size_t column;
+    bool hidden;
+    bool descending;
+    bool nulls_first;
+  };
+
+  std::string node_query;
+  std::vector<sort_key> keys;
+  size_t hidden_count = 0;
+  int64_t limit = 0;
+  int64_t offset = 0;
+
+  top_k_plan() = default;
+};
+} // namespace arrow_sql_router
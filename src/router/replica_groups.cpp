@@ -0,0 +1,146 @@
+#include "replica_groups.h"
+
+#include <algorithm>
+
+namespace flight = arrow::flight;
+
+// Reads per group the hedge delay is computed over, and how many have to be seen first
+const size_t kLatencyWindow = 256;
+const size_t kMinLatencySamples = 20;
+// Weight of the newest read in a member's mean latency
+const double kLatencyWeight = 0.2;
+
+namespace arrow_sql_router {
+replica_groups::replica_groups(
+    const std::vector<flight::Location>& nodes,
+    const std::vector<std::vector<flight::Location>>& replicas
+) {
+  for (size_t i = 0; i < nodes.size() && i < replicas.size(); i++) {
+    if (replicas[i].empty()) {
+      continue;
+    }
+    const std::string key = nodes[i].ToString();
+    auto& group = groups[key];
+    group.push_back(nodes[i]);
+    group.insert(group.end(), replicas[i].begin(), replicas[i].end());
+    for (const auto& member : group) {
+      group_of[member.ToString()] = key;
+    }
+  }
+}
+
+std::vector<flight::Location> replica_groups::members(const flight::Location& node) const {
+  auto it = groups.find(node.ToString());
+  return it == groups.end() ? std::vector<flight::Location>{node} : it->second;
+}
+
+std::vector<flight::Location> replica_groups::by_load(
+    const flight::Location& node,
+    const std::function<int64_t(const flight::Location&)>& in_flight
+) {
+  auto candidates = members(node);
+  if (candidates.size() == 1) {
+    return candidates;
+  }
+
+  size_t first;
+  std::vector<double> latency;
+  {
+    std::lock_guard lock(mutex);
+    const auto is_stale = [this](const flight::Location& member) { return stale.contains(member.ToString()); };
+    if (!std::all_of(candidates.begin(), candidates.end(), is_stale)) {
+      std::erase_if(candidates, is_stale);
+    }
+    for (const auto& member : candidates) {
+      latency.push_back(members_stats[member.ToString()].mean_latency);
+    }
+    first = rotation++;
+  }
+  std::vector<std::pair<int64_t, double>> load;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    load.emplace_back(in_flight(candidates[i]), latency[i]);
+  }
+  // Equally loaded members take turns
+  std::vector<size_t> order(candidates.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = (first + i) % order.size();
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return load[a] < load[b]; });
+
+  std::vector<flight::Location> ranked;
+  for (size_t i : order) {
+    ranked.push_back(candidates[i]);
+  }
+  return ranked;
+}
+
+std::optional<std::chrono::microseconds> replica_groups::hedge_delay(const flight::Location& node) {
+  std::vector<int64_t> samples;
+  {
+    std::lock_guard lock(mutex);
+    const auto& window = recent[node.ToString()];
+    if (window.size() < kMinLatencySamples) {
+      return std::nullopt;
+    }
+    samples.assign(window.begin(), window.end());
+  }
+  auto p95 = samples.begin() + static_cast<std::ptrdiff_t>(samples.size() * 95 / 100);
+  std::nth_element(samples.begin(), p95, samples.end());
+  return std::chrono::microseconds(*p95);
+}
+
+void replica_groups::record_read(const flight::Location& replica, std::chrono::microseconds latency, bool hedge) {
+  const std::string key = replica.ToString();
+  auto group = group_of.find(key);
+  if (group == group_of.end()) {
+    return;
+  }
+
+  std::lock_guard lock(mutex);
+  auto& member = members_stats[key];
+  member.reads++;
+  member.hedged_reads += hedge ? 1 : 0;
+  const double sample = static_cast<double>(latency.count());
+  member.mean_latency =
+      member.reads == 1 ? sample : member.mean_latency + kLatencyWeight * (sample - member.mean_latency);
+
+  auto& window = recent[group->second];
+  window.push_back(latency.count());
+  if (window.size() > kLatencyWindow) {
+    window.pop_front();
+  }
+}
+
+std::vector<replica_stats> replica_groups::stats() {
+  std::vector<replica_stats> result;
+  std::lock_guard lock(mutex);
+  for (const auto& [_, group] : groups) {
+    for (const auto& member : group) {
+      const auto& counters = members_stats[member.ToString()];
+      result.push_back(replica_stats{
+          member,
+          counters.reads,
+          counters.hedged_reads,
+          std::chrono::microseconds(static_cast<int64_t>(counters.mean_latency)),
+          stale.contains(member.ToString())
+      });
+    }
+  }
+  return result;
+}
+
+void replica_groups::mark_stale(const flight::Location& member) {
+  std::lock_guard lock(mutex);
+  stale.insert(member.ToString());
+}
+
+bool replica_groups::mark_resynced(const flight::Location& member) {
+  const std::string key = member.ToString();
+  if (!group_of.contains(key)) {
+    return false;
+  }
+  std::lock_guard lock(mutex);
+  stale.erase(key);
+  return true;
+}
+} // namespace arrow_sql_router
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "arrow/flight/types.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace arrow_sql_router {
+struct replica_stats {
+  arrow::flight::Location location;
+  // Reads the router completed on the replica
+  uint64_t reads = 0;
+  // Reads the replica ran as the hedge of a slow one
+  uint64_t hedged_reads = 0;
+  std::chrono::microseconds mean_latency{0};
+  // Missed a write the rest of its group applied, and serves no reads until it is resynced
+  bool stale = false;
+};
+
+// Every node together with its replicas, copies of its tables that each write through the router
+// reaches. Reads go to the member with the fewest calls in flight, then the lowest recent latency,
+// and a read that outlasts the 95th percentile of the group's recent reads is hedged. Members that
+// missed a write are left out of reads until they are marked resynced.
+class replica_groups {
+public:
+  // replicas[i] serve the rows of nodes[i]; nodes without an entry have no replicas
+  replica_groups(
+      const std::vector<arrow::flight::Location>& nodes,
+      const std::vector<std::vector<arrow::flight::Location>>& replicas
+  );
+
+  replica_groups(const replica_groups&) = delete;
+
+  replica_groups& operator=(const replica_groups&) = delete;
+
+  bool replicated() const { return !groups.empty(); }
+
+  // The node itself first, then its replicas
+  std::vector<arrow::flight::Location> members(const arrow::flight::Location& node) const;
+
+  // The members that are not stale, least loaded first; all of them when every member is stale
+  std::vector<arrow::flight::Location> by_load(
+      const arrow::flight::Location& node,
+      const std::function<int64_t(const arrow::flight::Location&)>& in_flight
+  );
+
+  // How long a read of the group runs before it is hedged, nullopt while too few reads were timed
+  std::optional<std::chrono::microseconds> hedge_delay(const arrow::flight::Location& node);
+
+  void record_read(const arrow::flight::Location& replica, std::chrono::microseconds latency, bool hedge);
+
+  std::vector<replica_stats> stats();
+
+  void mark_stale(const arrow::flight::Location& member);
+
+  // False when the location is not a member of any group
+  bool mark_resynced(const arrow::flight::Location& member);
+
+private:
+  struct member_stats {
+    uint64_t reads = 0;
+    uint64_t hedged_reads = 0;
+    // Exponentially weighted, 0 until the first read
+    double mean_latency = 0;
+  };
+
+  // Keyed by the node's location
+  std::unordered_map<std::string, std::vector<arrow::flight::Location>> groups;
+  // Group of every member
+  std::unordered_map<std::string, std::string> group_of;
+
+  std::mutex mutex;
+  size_t rotation = 0;
+  std::unordered_map<std::string, member_stats> members_stats;
+  // Latencies of the most recent reads of every group
+  std::unordered_map<std::string, std::deque<int64_t>> recent;
+  std::unordered_set<std::string> stale;
+};
+} // namespace arrow_sql_router
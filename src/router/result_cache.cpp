@@ -0,0 +1,166 @@
+#include "result_cache.h"
+
+#include "../bridge/statement_cache.h"
+#include "arrow/util/byte_size.h"
+#include "sql_text.h"
+
+#include <algorithm>
+
+// Functions whose value can change between two runs over the same rows
+const std::vector<std::string> kVolatileFunctions{
+    "random", "randomblob", "changes", "total_changes", "last_insert_rowid",
+    "date", "time", "datetime", "julianday", "unixepoch", "strftime", "timediff"
+};
+const std::vector<std::string> kVolatileKeywords{"current_date", "current_time", "current_timestamp"};
+
+namespace arrow_sql_router {
+void result_cache::fill::add(std::shared_ptr<arrow::RecordBatch> batch) {
+  if (oversized) {
+    return;
+  }
+  bytes += arrow::util::TotalBufferSize(*batch);
+  if (bytes > owner->entry_capacity) {
+    oversized = true;
+    batches.clear();
+    return;
+  }
+  batches.push_back(std::move(batch));
+}
+
+void result_cache::fill::finish(std::shared_ptr<arrow::Schema> schema) {
+  if (!oversized) {
+    owner->store(*this, std::move(schema));
+  }
+}
+
+result_cache::result_cache(int64_t capacity, int64_t entry_capacity)
+    : capacity(std::max<int64_t>(capacity, 0))
+    , entry_capacity(std::min(entry_capacity, this->capacity)) {}
+
+std::optional<std::vector<std::string>> result_cache::cacheable_tables(const std::string& query) {
+  const auto words = scan_words(query);
+  if (statement_verb(query) != "select") {
+    return std::nullopt;
+  }
+  for (const auto& word : words) {
+    const size_t next = query.find_first_not_of(" \t\r\n", word.end);
+    const bool call = next != std::string::npos && query[next] == '(';
+    const bool function =
+        std::find(kVolatileFunctions.begin(), kVolatileFunctions.end(), word.text) != kVolatileFunctions.end();
+    const bool keyword =
+        std::find(kVolatileKeywords.begin(), kVolatileKeywords.end(), word.text) != kVolatileKeywords.end();
+    if ((function && call) || keyword) {
+      return std::nullopt;
+    }
+  }
+  auto tables = table_names(query);
+  if (tables.empty()) {
+    return std::nullopt;
+  }
+  return tables;
+}
+
+arrow::Result<std::shared_ptr<arrow::Table>> result_cache::find(const std::string& query) {
+  const std::string key = arrow_sql_bridge::normalize_sql(query);
+  std::shared_ptr<arrow::Schema> schema;
+  std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+  {
+    std::lock_guard lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+      misses++;
+      return std::shared_ptr<arrow::Table>();
+    }
+    hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    schema = it->second->schema;
+    batches = it->second->batches;
+  }
+  // The batches all carry the schema they were stored with
+  return arrow::Table::FromRecordBatches(std::move(schema), std::move(batches));
+}
+
+std::shared_ptr<result_cache::fill> result_cache::begin(const std::string& query, std::vector<std::string> tables) {
+  std::lock_guard lock(mutex);
+  return std::shared_ptr<fill>(new fill(this, arrow_sql_bridge::normalize_sql(query), std::move(tables), generation));
+}
+
+void result_cache::store(fill& result, std::shared_ptr<arrow::Schema> schema) {
+  for (auto& batch : result.batches) {
+    if (!batch->schema()->Equals(*schema)) {
+      batch = arrow::RecordBatch::Make(schema, batch->num_rows(), batch->columns());
+    }
+  }
+
+  std::lock_guard lock(mutex);
+  if (cleared_at > result.generation) {
+    return;
+  }
+  for (const auto& table : result.tables) {
+    auto written = written_at.find(table);
+    if (written != written_at.end() && written->second > result.generation) {
+      return;
+    }
+  }
+
+  if (auto it = index.find(result.key); it != index.end()) {
+    erase(it->second);
+  }
+  lru.push_front(entry{result.key, result.tables, std::move(schema), std::move(result.batches), result.bytes});
+  index[result.key] = lru.begin();
+  bytes += result.bytes;
+  while (bytes > capacity) {
+    erase(std::prev(lru.end()));
+    evictions++;
+  }
+}
+
+void result_cache::invalidate(const std::vector<std::string>& tables) {
+  std::lock_guard lock(mutex);
+  generation++;
+  for (const auto& table : tables) {
+    written_at[table] = generation;
+  }
+  for (auto it = lru.begin(); it != lru.end();) {
+    auto next = std::next(it);
+    const bool stale = std::any_of(it->tables.begin(), it->tables.end(), [&](const std::string& table) {
+      return std::find(tables.begin(), tables.end(), table) != tables.end();
+    });
+    if (stale) {
+      erase(it);
+      invalidations++;
+    }
+    it = next;
+  }
+}
+
+void result_cache::invalidate_after(const std::string& statement) {
+  const std::string verb = statement_verb(statement);
+  const auto tables = table_names(statement);
+  if ((verb == "insert" || verb == "replace" || verb == "update" || verb == "delete") && !tables.empty()) {
+    invalidate(tables);
+  } else {
+    clear();
+  }
+}
+
+void result_cache::clear() {
+  std::lock_guard lock(mutex);
+  cleared_at = ++generation;
+  invalidations += lru.size();
+  lru.clear();
+  index.clear();
+  bytes = 0;
+}
+
+result_cache_stats result_cache::stats() {
+  std::lock_guard lock(mutex);
+  return result_cache_stats{hits.load(), misses.load(), evictions.load(), invalidations.load(), lru.size(), bytes};
+}
+
+void result_cache::erase(lru_list::iterator it) {
+  bytes -= it->bytes;
+  index.erase(it->key);
+  lru.erase(it);
+}
+} // namespace arrow_sql_router
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "arrow/record_batch.h"
+#include "arrow/result.h"
+#include "arrow/table.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace arrow_sql_router {
+struct result_cache_stats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  // Entries dropped because a table they read was written
+  uint64_t invalidations = 0;
+  size_t entries = 0;
+  int64_t bytes = 0;
+
+  double hit_rate() const { return hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses); }
+};
+
+// Results of read queries kept on the router as record batches, keyed by normalized SQL and
+// evicted least recently used first once they outgrow a byte budget. Every entry remembers the
+// tables its query read and goes as soon as a statement through the router writes one of them.
+// Writes that reach the nodes any other way are not seen.
+class result_cache {
+public:
+  // A result captured while it is produced. It only enters the cache if no table it reads was
+  // written since the fill began, so a result that raced with a write is never kept.
+  class fill {
+  public:
+    // Batches past the entry limit make the result too big to keep, they are not held on to
+    void add(std::shared_ptr<arrow::RecordBatch> batch);
+
+    // Stores the result once all of it went by. The cache must still exist.
+    void finish(std::shared_ptr<arrow::Schema> schema);
+
+  private:
+    friend class result_cache;
+
+    result_cache* owner;
+    std::string key;
+    std::vector<std::string> tables;
+    uint64_t generation;
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+    int64_t bytes = 0;
+    bool oversized = false;
+
+    fill(result_cache* owner, std::string key, std::vector<std::string> tables, uint64_t generation)
+        : owner(owner)
+        , key(std::move(key))
+        , tables(std::move(tables))
+        , generation(generation) {}
+  };
+
+  // `capacity` bytes in total, no single result above `entry_capacity`; 0 disables caching
+  result_cache(int64_t capacity, int64_t entry_capacity);
+
+  result_cache(const result_cache&) = delete;
+
+  result_cache& operator=(const result_cache&) = delete;
+
+  bool enabled() const { return capacity > 0; }
+
+  // Tables a query reads if its result may be cached: a SELECT naming at least one table and
+  // calling nothing whose value changes without a write (random(), the current time, ...)
+  static std::optional<std::vector<std::string>> cacheable_tables(const std::string& query);
+
+  // Returns nullptr on a miss
+  arrow::Result<std::shared_ptr<arrow::Table>> find(const std::string& query);
+
+  std::shared_ptr<fill> begin(const std::string& query, std::vector<std::string> tables);
+
+  // Drops the results that read any of the tables, fills under way are not stored
+  void invalidate(const std::vector<std::string>& tables);
+
+  // Drops what a statement that ran through the router may have changed: the results reading the
+  // tables an INSERT, UPDATE or DELETE names, or all of them after any other statement
+  void invalidate_after(const std::string& statement);
+
+  void clear();
+
+  result_cache_stats stats();
+
+private:
+  struct entry {
+    std::string key;
+    std::vector<std::string> tables;
+    std::shared_ptr<arrow::Schema> schema;
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+    int64_t bytes;
+  };
+
+  using lru_list = std::list<entry>;
+
+  int64_t capacity;
+  int64_t entry_capacity;
+  std::mutex mutex;
+  lru_list lru; // most recently used first
+  std::unordered_map<std::string, lru_list::iterator> index;
+  int64_t bytes = 0;
+
+  // Bumped by every write, tables remember the last write to them
+  uint64_t generation = 0;
+  uint64_t cleared_at = 0;
+  std::unordered_map<std::string, uint64_t> written_at;
+
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> evictions{0};
+  std::atomic<uint64_t> invalidations{0};
+
+  void store(fill& result, std::shared_ptr<arrow::Schema> schema);
+
+  // Requires the mutex
+  void erase(lru_list::iterator it);
+};
+} // namespace arrow_sql_router
@@ -3,14 +3,20 @@
 namespace flight = arrow::flight;
 
 arrow::Result<std::shared_ptr<flight::sql::FlightSqlServerBase>>
-create_router(std::string hostname, int port, const std::list<arrow::flight::Location>& nodes, uint8_t receiver) {
+create_router(
+    std::string hostname,
+    int port,
+    const std::list<arrow::flight::Location>& nodes,
+    uint8_t receiver,
+    const arrow_sql_router::router_options& router_options
+) {
   ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(hostname, port));
 
   flight::FlightServerOptions options(location);
   options.auth_handler = std::make_unique<flight::NoOpAuthHandler>();
 
   std::shared_ptr<arrow_sql_router::flight_sql_router> sqlite_router;
-  ARROW_ASSIGN_OR_RAISE(sqlite_router, arrow_sql_router::flight_sql_router::make(nodes, receiver));
+  ARROW_ASSIGN_OR_RAISE(sqlite_router, arrow_sql_router::flight_sql_router::make(nodes, receiver, router_options));
 
   ARROW_CHECK_OK(sqlite_router->Init(options));
   ARROW_CHECK_OK(sqlite_router->SetShutdownOnSignals({SIGTERM}));
@@ -23,9 +29,10 @@ int run_flight_sql_router(
     const std::string& hostname,
     int port,
     const std::list<arrow::flight::Location>& nodes,
-    uint8_t receiver
+    uint8_t receiver,
+    const arrow_sql_router::router_options& router_options
 ) {
-  auto router = create_router(hostname, port, nodes, receiver);
+  auto router = create_router(hostname, port, nodes, receiver, router_options);
 
   if (router.ok()) {
     auto server = router.ValueOrDie();
@@ -7,11 +7,18 @@
 #include <iostream>
 
 arrow::Result<std::shared_ptr<arrow::flight::sql::FlightSqlServerBase>>
-create_router(std::string hostname, int port, const std::list<arrow::flight::Location>& nodes, uint8_t receiver);
+create_router(
+    std::string hostname,
+    int port,
+    const std::list<arrow::flight::Location>& nodes,
+    uint8_t receiver,
+    const arrow_sql_router::router_options& router_options = arrow_sql_router::router_options()
+);
 
 int run_flight_sql_router(
     const std::string& hostname,
     int port,
     const std::list<arrow::flight::Location>& nodes,
-    uint8_t receiver
+    uint8_t receiver,
+    const arrow_sql_router::router_options& router_options = arrow_sql_router::router_options()
 );
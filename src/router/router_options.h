@@ -0,0 +1,81 @@
+#pragma once
+
+#include "arrow/flight/types.h"
+#include "shard_catalog.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace arrow_sql_router {
+enum class execution_mode {
+  // Every query goes to the receiver node and its results are proxied through the router
+  single,
+  // Reads go to all nodes in parallel, clients pull each node's shard directly. Writes complete on
+  // the router: rows are written on the receiver only, schema changes on every node.
+  scatter,
+  // As scatter, except that statements on sharded tables which name their shard key only
+  // go to the owning nodes, and writes on sharded tables complete on the router
+  sharded,
+};
+
+struct router_options {
+  execution_mode mode = execution_mode::single;
+
+  // In single mode, hand out the receiver's own endpoints (its location and ticket) so clients
+  // fetch results straight from the node and the router stays off the data path.
+  bool direct_endpoints = false;
+
+  // In scatter and sharded mode, run simple COUNT/SUM/MIN/MAX/AVG queries as per-node partial
+  // aggregates and merge them on the router, so only the final result reaches the client.
+  bool aggregate_pushdown = true;
+
+  // In scatter and sharded mode, run inner equi-joins of two tables by streaming both sides from
+  // every node and joining them on the router, instead of joining each node's rows in isolation.
+  bool distributed_join = true;
+
+  // Build side bytes a join holds in memory before it partitions both sides to local disk.
+  int64_t join_memory_budget = 256 << 20;
+  size_t join_spill_partitions = 16;
+  // Where join partitions are spilled, the system temporary directory when empty.
+  std::string join_spill_directory;
+
+  // Result schemas of queries kept for GetSchema calls, keyed by normalized SQL. 0 disables caching.
+  size_t schema_cache_size = 1024;
+
+  // Bytes of query results kept on the router for repeated SELECTs, keyed by normalized SQL. Results
+  // are only captured where they pass through the router: proxied single-mode reads, aggregates,
+  // joins and ordered merges. While caching is on, every other statement completes on the router
+  // before it answers, as writes on sharded tables do, so that the results reading the tables it
+  // names are dropped after it took effect. 0 disables caching.
+  int64_t result_cache_bytes = 0;
+  // Larger results are passed on without being kept.
+  int64_t result_cache_entry_bytes = 16 << 20;
+
+  // Replicas of every node, in the order nodes were given, each holding a copy of the node's tables.
+  // Statements other than reads complete on the router and reach every replica before it answers;
+  // reads go to one member of the group, the least busy one. A member that fails a write the others
+  // applied serves no reads until flight_sql_router::mark_replica_resynced. Nodes added later have no replicas.
+  std::vector<std::vector<arrow::flight::Location>> replicas;
+  // Reads completed on the router that outlast the 95th percentile of their group's recent reads
+  // are sent to a second replica as well, and the first answer wins.
+  bool hedge_reads = true;
+
+  // How long a result computed on the router waits for its DoGet.
+  std::chrono::milliseconds result_ttl{30000};
+
+  // gRPC channels (connections) kept open to every node, calls go to the least busy one.
+  size_t channels_per_node = 4;
+
+  // Tables partitioned over the nodes in sharded mode, in the order nodes were given.
+  std::vector<sharded_table> sharded_tables;
+
+  // Points every node takes on the consistent-hash ring of the hash-partitioned tables.
+  size_t ring_vnodes = 64;
+
+  // Rows copied per batch when a new node takes over its ranges.
+  size_t rebalance_batch_rows = 10000;
+};
+} // namespace arrow_sql_router
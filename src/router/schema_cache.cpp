@@ -0,0 +1,55 @@
+#include "schema_cache.h"
+
+#include "../bridge/statement_cache.h"
+
+namespace arrow_sql_router {
+std::shared_ptr<arrow::Schema> schema_cache::find(const std::string& query) {
+  const std::string key = arrow_sql_bridge::normalize_sql(query);
+  std::lock_guard lock(mutex);
+  auto it = index.find(key);
+  if (it == index.end()) {
+    misses++;
+    return nullptr;
+  }
+
+  hits++;
+  lru.splice(lru.begin(), lru, it->second);
+  return it->second->second;
+}
+
+void schema_cache::put(const std::string& query, std::shared_ptr<arrow::Schema> schema) {
+  if (capacity == 0) {
+    return;
+  }
+
+  std::string key = arrow_sql_bridge::normalize_sql(query);
+  std::lock_guard lock(mutex);
+  auto it = index.find(key);
+  if (it != index.end()) {
+    it->second->second = std::move(schema);
+    lru.splice(lru.begin(), lru, it->second);
+    return;
+  }
+
+  lru.emplace_front(key, std::move(schema));
+  index[std::move(key)] = lru.begin();
+  while (lru.size() > capacity) {
+    index.erase(lru.back().first);
+    lru.pop_back();
+    evictions++;
+  }
+}
+
+void schema_cache::clear() {
+  std::lock_guard lock(mutex);
+  if (!lru.empty()) {
+    invalidations++;
+  }
+  lru.clear();
+  index.clear();
+}
+
+schema_cache_stats schema_cache::stats() const {
+  return schema_cache_stats{hits.load(), misses.load(), evictions.load(), invalidations.load()};
+}
+} // namespace arrow_sql_router
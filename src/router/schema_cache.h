@@ -0,0 +1,55 @@
+#pragma once
+
+#include "arrow/type.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace arrow_sql_router {
+struct schema_cache_stats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  uint64_t invalidations = 0;
+};
+
+// LRU cache of the result schemas of queries planned through the router, keyed by normalized
+// SQL, so repeated GetSchema calls cost no node round trip. Cleared as a whole whenever a
+// statement may change table definitions.
+class schema_cache {
+public:
+  explicit schema_cache(size_t capacity)
+      : capacity(capacity) {}
+
+  schema_cache(const schema_cache&) = delete;
+
+  schema_cache& operator=(const schema_cache&) = delete;
+
+  // Returns nullptr on a miss
+  std::shared_ptr<arrow::Schema> find(const std::string& query);
+
+  void put(const std::string& query, std::shared_ptr<arrow::Schema> schema);
+
+  void clear();
+
+  schema_cache_stats stats() const;
+
+private:
+  using lru_list = std::list<std::pair<std::string, std::shared_ptr<arrow::Schema>>>;
+
+  size_t capacity;
+  std::mutex mutex;
+  lru_list lru; // most recently used first
+  std::unordered_map<std::string, lru_list::iterator> index;
+
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> evictions{0};
+  std::atomic<uint64_t> invalidations{0};
+};
+} // namespace arrow_sql_router
@@ -0,0 +1,434 @@
+#include "shard_catalog.h"
+
+#include "../bridge/shard_hash.h"
+#include "sql_text.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <stdexcept>
+
+using routed_statements = std::optional<arrow_sql_router::shard_route>;
+
+// Integer and string literals only, anything computed is not known to the router
+std::optional<arrow_sql_router::shard_key> parse_key_literal(const std::string& text) {
+  const std::string literal = trim(text);
+  if (literal.size() >= 2 && literal.front() == '\'' && literal.back() == '\'') {
+    std::string value;
+    for (size_t i = 1; i + 1 < literal.size(); i++) {
+      value.push_back(literal[i]);
+      // Quotes inside the literal are doubled
+      if (literal[i] == '\'') {
+        i++;
+      }
+    }
+    return value;
+  }
+
+  size_t digits = literal.empty() || literal.front() != '-' ? 0 : 1;
+  if (digits == literal.size()) {
+    return std::nullopt;
+  }
+  for (size_t i = digits; i < literal.size(); i++) {
+    if (!std::isdigit(static_cast<unsigned char>(literal[i]))) {
+      return std::nullopt;
+    }
+  }
+  try {
+    return static_cast<int64_t>(std::stoll(literal));
+  } catch (const std::out_of_range&) {
+    return std::nullopt;
+  }
+}
+
+// "lhs = rhs" (or "==") at the top level of a conjunct
+std::optional<std::pair<std::string, std::string>> split_equality(const std::string& conjunct) {
+  int depth = 0;
+  for (size_t i = 0; i < conjunct.size(); i++) {
+    const char c = conjunct[i];
+    if (c == '\'' || c == '"' || c == '`' || c == '[') {
+      const size_t end = conjunct.find(c == '[' ? ']' : c, i + 1);
+      if (end == std::string::npos) {
+        return std::nullopt;
+      }
+      i = end;
+    } else if (c == '(') {
+      depth++;
+    } else if (c == ')') {
+      depth--;
+    } else if (c == '=' && depth == 0) {
+      if (i == 0 || std::string("<>!").find(conjunct[i - 1]) != std::string::npos) {
+        return std::nullopt;
+      }
+      const size_t rhs = i + 1 < conjunct.size() && conjunct[i + 1] == '=' ? i + 2 : i + 1;
+      return std::make_pair(trim(conjunct.substr(0, i)), trim(conjunct.substr(rhs)));
+    }
+  }
+  return std::nullopt;
+}
+
+// Index of the first depth-0 word at or after `from` that is one of `stops`
+size_t find_word(const std::vector<sql_word>& words, size_t from, std::initializer_list<std::string_view> stops) {
+  for (size_t i = from; i < words.size(); i++) {
+    if (words[i].depth == 0 && std::find(stops.begin(), stops.end(), words[i].text) != stops.end()) {
+      return i;
+    }
+  }
+  return words.size();
+}
+
+// The statement with its target table replaced by the staging table of a moving table
+std::string on_staging(const std::string& sql, std::pair<size_t, size_t> span, const std::string& table) {
+  return sql.substr(0, span.first) + quote_name(arrow_sql_router::shard_catalog::staging_table(table)) +
+         sql.substr(span.second);
+}
+
+void add_inserts(
+    std::vector<arrow_sql_router::shard_statement>& statements,
+    const std::string& prefix,
+    const std::map<size_t, std::vector<std::string>>& rows_by_node
+) {
+  for (const auto& [node, rows] : rows_by_node) {
+    std::string query = prefix;
+    for (size_t i = 0; i < rows.size(); i++) {
+      query += (i == 0 ? " " : ", ") + rows[i];
+    }
+    statements.push_back(arrow_sql_router::shard_statement{node, std::move(query)});
+  }
+}
+
+arrow::Result<routed_statements> route_insert(
+    const arrow_sql_router::shard_catalog& catalog,
+    const std::string& sql,
+    const std::vector<sql_word>& words
+) {
+  const size_t into = find_word(words, 1, {"into"});
+  if (into == words.size()) {
+    return std::nullopt;
+  }
+  const size_t body = find_word(words, into + 1, {"values", "select", "with", "default"});
+  const size_t body_begin = body == words.size() ? sql.size() : words[body].begin;
+  const size_t columns_begin = std::min(sql.find('(', words[into].end), body_begin);
+
+  const auto* table = catalog.find(identifier_name(sql.substr(words[into].end, columns_begin - words[into].end)));
+  if (table == nullptr) {
+    return std::nullopt;
+  }
+  if (body == words.size() || words[body].text != "values") {
+    return arrow::Status::NotImplemented("Only INSERT ... VALUES can be routed into sharded table ", table->name);
+  }
+  if (columns_begin == body_begin) {
+    return arrow::Status::Invalid("INSERT into sharded table ", table->name, " needs a column list");
+  }
+
+  const size_t columns_end = sql.rfind(')', body_begin);
+  const auto columns = split_top_level(sql.substr(columns_begin + 1, columns_end - columns_begin - 1));
+  size_t key_index = columns.size();
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (identifier_name(columns[i]) == table->key) {
+      key_index = i;
+    }
+  }
+  if (key_index == columns.size()) {
+    return arrow::Status::Invalid("INSERT into sharded table ", table->name, " has to set shard key ", table->key);
+  }
+
+  std::map<size_t, std::vector<std::string>> rows_by_node;
+  std::map<size_t, std::vector<std::string>> staged_rows_by_node;
+  for (const auto& row : split_top_level(sql.substr(words[body].end))) {
+    if (row.size() < 2 || row.front() != '(' || row.back() != ')') {
+      return arrow::Status::NotImplemented("Unsupported VALUES clause for sharded table ", table->name);
+    }
+    const auto values = split_top_level(row.substr(1, row.size() - 2));
+    if (values.size() != columns.size()) {
+      return arrow::Status::Invalid("VALUES row has ", values.size(), " values for ", columns.size(), " columns");
+    }
+    auto key = parse_key_literal(values[key_index]);
+    if (!key.has_value()) {
+      return arrow::Status::Invalid(
+          "Shard key ",
+          table->key,
+          " must be an integer or string literal, got ",
+          values[key_index]
+      );
+    }
+    ARROW_ASSIGN_OR_RAISE(auto node, catalog.owner(*table, *key));
+    rows_by_node[node].push_back(row);
+    if (auto receiver = catalog.receiver(*table, *key)) {
+      staged_rows_by_node[*receiver].push_back(row);
+    }
+  }
+
+  arrow_sql_router::shard_route route{true, {}};
+  const std::string prefix = sql.substr(0, words[body].end);
+  add_inserts(route.statements, prefix, rows_by_node);
+  add_inserts(
+      route.statements,
+      on_staging(prefix, identifier_span(sql, words[into].end), table->name),
+      staged_rows_by_node
+  );
+  return route;
+}
+
+arrow::Result<routed_statements> route_keyed(
+    const arrow_sql_router::shard_catalog& catalog,
+    const std::string& sql,
+    const std::vector<sql_word>& words
+) {
+  // Subqueries and compound selects may read other shards
+  for (size_t i = 1; i < words.size(); i++) {
+    if (words[i].text == "select" || words[i].text == "union" || words[i].text == "intersect" ||
+        words[i].text == "except") {
+      return std::nullopt;
+    }
+  }
+
+  const bool write = words.front().text != "select";
+  const size_t where = find_word(words, 1, {"where"});
+  size_t table_begin;
+  size_t table_end;
+  if (words.front().text == "update") {
+    // UPDATE [OR action] table SET ...
+    const size_t set = find_word(words, 1, {"set"});
+    if (set == words.size()) {
+      return std::nullopt;
+    }
+    table_begin = words.size() > 2 && words[1].text == "or" ? words[2].end : words.front().end;
+    table_end = words[set].begin;
+  } else {
+    const size_t from = find_word(words, 1, {"from"});
+    if (from == words.size()) {
+      return std::nullopt;
+    }
+    const size_t clause_end =
+        find_word(words, from + 1, {"where", "group", "order", "limit", "window", "returning"});
+    if (find_word(words, from + 1, {"join"}) < clause_end) {
+      return std::nullopt;
+    }
+    table_begin = words[from].end;
+    table_end = clause_end == words.size() ? sql.size() : words[clause_end].begin;
+  }
+
+  if (sql.substr(table_begin, table_end - table_begin).find(',') != std::string::npos) {
+    return std::nullopt;
+  }
+  // Anything after the name is an alias
+  const auto span = identifier_span(sql, table_begin);
+  const auto* table = catalog.find(identifier_name(sql.substr(span.first, span.second - span.first)));
+  if (table == nullptr) {
+    return std::nullopt;
+  }
+
+  std::optional<arrow_sql_router::shard_key> key;
+  std::optional<std::vector<std::string>> conjuncts;
+  if (where != words.size()) {
+    const size_t where_end = find_word(words, where + 1, {"group", "order", "limit", "window", "returning"});
+    const size_t where_end_pos = where_end == words.size() ? sql.size() : words[where_end].begin;
+    // An OR makes the key optional
+    conjuncts = split_conjuncts(sql.substr(words[where].end, where_end_pos - words[where].end));
+  }
+
+  for (const auto& conjunct : conjuncts.value_or(std::vector<std::string>())) {
+    auto equality = split_equality(conjunct);
+    if (!equality.has_value()) {
+      continue;
+    }
+    auto [column, literal] = *equality;
+    if (identifier_name(column) != table->key) {
+      std::swap(column, literal);
+    }
+    if (identifier_name(column) == table->key) {
+      key = parse_key_literal(literal);
+    }
+    if (key.has_value()) {
+      break;
+    }
+  }
+
+  arrow_sql_router::shard_route route{write, {}};
+  if (key.has_value()) {
+    ARROW_ASSIGN_OR_RAISE(auto node, catalog.owner(*table, *key));
+    route.statements.push_back(arrow_sql_router::shard_statement{node, sql});
+    if (auto receiver = catalog.receiver(*table, *key); receiver.has_value() && write) {
+      route.statements.push_back(arrow_sql_router::shard_statement{*receiver, on_staging(sql, span, table->name)});
+    }
+    return route;
+  }
+
+  // Reads without a key run like any other scatter query
+  if (!write) {
+    return std::nullopt;
+  }
+  for (size_t node = 0; node < catalog.get_node_count(); node++) {
+    route.statements.push_back(arrow_sql_router::shard_statement{node, sql});
+  }
+  for (size_t node : catalog.receivers(*table)) {
+    route.statements.push_back(arrow_sql_router::shard_statement{node, on_staging(sql, span, table->name)});
+  }
+  return route;
+}
+
+namespace arrow_sql_router {
+arrow::Result<shard_catalog>
+shard_catalog::make(const std::vector<sharded_table>& tables, const std::vector<std::string>& nodes, size_t vnodes) {
+  if (nodes.empty()) {
+    return arrow::Status::Invalid("Sharding needs at least one node");
+  }
+
+  auto ring = std::make_shared<const hash_ring>(nodes, vnodes);
+  std::unordered_map<std::string, placement> catalog;
+  for (const auto& table : tables) {
+    sharded_table entry = table;
+    entry.name = identifier_name(table.name);
+    entry.key = identifier_name(table.key);
+    if (entry.name.empty() || entry.key.empty()) {
+      return arrow::Status::Invalid("Sharded table needs a name and a shard key");
+    }
+    if (entry.kind == partitioning::range) {
+      if (entry.bounds.empty() || entry.bounds.size() + 1 > nodes.size()) {
+        return arrow::Status::Invalid(
+            "Range partitioning of ",
+            entry.name,
+            " over ",
+            nodes.size(),
+            " nodes needs between 1 and ",
+            nodes.size() - 1,
+            " bounds, got ",
+            entry.bounds.size()
+        );
+      }
+      if (std::adjacent_find(entry.bounds.begin(), entry.bounds.end(), std::greater_equal<>()) !=
+          entry.bounds.end()) {
+        return arrow::Status::Invalid("Range bounds of ", entry.name, " must be strictly increasing");
+      }
+    }
+    const std::string name = entry.name;
+    if (!catalog.emplace(name, placement{std::move(entry), ring, nullptr, {}}).second) {
+      return arrow::Status::Invalid("Table ", name, " is sharded twice");
+    }
+  }
+  return shard_catalog(std::move(catalog), nodes.size(), vnodes, std::move(ring));
+}
+
+const sharded_table* shard_catalog::find(const std::string& table) const {
+  auto it = tables.find(table);
+  return it == tables.end() ? nullptr : &it->second.table;
+}
+
+arrow::Result<size_t> shard_catalog::owner(const sharded_table& table, const shard_key& key) const {
+  if (table.kind == partitioning::hash) {
+    const uint64_t hash = std::visit([](const auto& value) { return arrow_sql_bridge::shard_hash(value); }, key);
+    return get_placement(table).ring->owner(hash);
+  }
+
+  if (!std::holds_alternative<int64_t>(key)) {
+    return arrow::Status::Invalid("Range-partitioned table ", table.name, " needs an integer shard key");
+  }
+  const int64_t value = std::get<int64_t>(key);
+  return static_cast<size_t>(std::upper_bound(table.bounds.begin(), table.bounds.end(), value) - table.bounds.begin());
+}
+
+std::optional<size_t> shard_catalog::receiver(const sharded_table& table, const shard_key& key) const {
+  const auto& entry = get_placement(table);
+  if (entry.target == nullptr) {
+    return std::nullopt;
+  }
+  const uint64_t hash = std::visit([](const auto& value) { return arrow_sql_bridge::shard_hash(value); }, key);
+  const size_t node = entry.target->owner(hash);
+  if (node == entry.ring->owner(hash)) {
+    return std::nullopt;
+  }
+  return node;
+}
+
+const std::vector<size_t>& shard_catalog::receivers(const sharded_table& table) const {
+  return get_placement(table).receivers;
+}
+
+size_t shard_catalog::get_node_count() const {
+  return node_count;
+}
+
+arrow::Result<std::optional<shard_route>> shard_catalog::route(const std::string& query) const {
+  if (tables.empty()) {
+    return std::nullopt;
+  }
+
+  const std::string sql = trim(query);
+  const auto words = scan_words(sql);
+  if (words.empty() || words.front().begin != 0) {
+    return std::nullopt;
+  }
+  if (words.front().text == "insert") {
+    return route_insert(*this, sql, words);
+  }
+  if (words.front().text == "select" || words.front().text == "update" || words.front().text == "delete") {
+    return route_keyed(*this, sql, words);
+  }
+  return std::nullopt;
+}
+
+shard_catalog shard_catalog::with_nodes(const std::vector<std::string>& nodes) const {
+  return shard_catalog(tables, nodes.size(), vnodes, std::make_shared<const hash_ring>(nodes, vnodes));
+}
+
+std::vector<std::string> shard_catalog::unbalanced_tables() const {
+  std::vector<std::string> names;
+  for (const auto& [name, entry] : tables) {
+    if (entry.table.kind == partitioning::hash && entry.ring != ring) {
+      names.push_back(name);
+    }
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+std::vector<hash_ring::range> shard_catalog::pending_moves(const std::string& table) const {
+  auto it = tables.find(table);
+  if (it == tables.end() || it->second.ring == ring) {
+    return {};
+  }
+  return hash_ring::moved_ranges(*it->second.ring, *ring);
+}
+
+shard_catalog shard_catalog::begin_move(const std::string& table) const {
+  shard_catalog moving = *this;
+  auto it = moving.tables.find(table);
+  if (it != moving.tables.end()) {
+    it->second.target = ring;
+    it->second.receivers.clear();
+    for (const auto& range : pending_moves(table)) {
+      if (std::find(it->second.receivers.begin(), it->second.receivers.end(), range.to) ==
+          it->second.receivers.end()) {
+        it->second.receivers.push_back(range.to);
+      }
+    }
+  }
+  return moving;
+}
+
+shard_catalog shard_catalog::end_move(const std::string& table, bool commit) const {
+  shard_catalog moved = *this;
+  auto it = moved.tables.find(table);
+  if (it != moved.tables.end() && it->second.target != nullptr) {
+    if (commit) {
+      it->second.ring = it->second.target;
+    }
+    it->second.target = nullptr;
+    it->second.receivers.clear();
+  }
+  return moved;
+}
+
+std::string shard_catalog::staging_table(const std::string& table) {
+  return "_rebalance_" + table;
+}
+
+std::string shard_catalog::batch_table(const std::string& table) {
+  return "_rebalance_batch:" + table;
+}
+
+const shard_catalog::placement& shard_catalog::get_placement(const sharded_table& table) const {
+  return tables.at(table.name);
+}
+} // namespace arrow_sql_router
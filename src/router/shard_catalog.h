@@ -0,0 +1,119 @@
+#pragma once
+
+#include "arrow/result.h"
+#include "hash_ring.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace arrow_sql_router {
+enum class partitioning { hash, range };
+
+// A table split across the nodes by the value of one column
+struct sharded_table {
+  std::string name;
+  std::string key;
+  partitioning kind = partitioning::hash;
+  // Range partitioning over integer keys: node i owns [bounds[i - 1], bounds[i]), the first
+  // node everything below bounds[0] and node bounds.size() everything from bounds.back() on
+  std::vector<int64_t> bounds;
+};
+
+using shard_key = std::variant<int64_t, std::string>;
+
+// A statement together with the node it has to run on
+struct shard_statement {
+  size_t node;
+  std::string query;
+};
+
+// Where a statement on a sharded table has to run
+struct shard_route {
+  // The statement modifies a sharded table, the router runs it to completion itself
+  bool write = false;
+  std::vector<shard_statement> statements;
+};
+
+// Placement of the sharded tables over the router's nodes. Hash-partitioned tables are
+// placed on a consistent-hash ring; statements that pin down the shard key go to the
+// owning nodes only, everything else has to run on every node.
+//
+// The catalog is an immutable value, every change of placement makes a new one. When
+// nodes are added the hash-partitioned tables are moved to the ring of the new node list
+// one at a time: while a table moves, its rows stay readable on the old owners and every
+// write on it is also applied to the staging table of the new owner.
+class shard_catalog {
+public:
+  static arrow::Result<shard_catalog>
+  make(const std::vector<sharded_table>& tables, const std::vector<std::string>& nodes, size_t vnodes);
+
+  const sharded_table* find(const std::string& table) const;
+
+  arrow::Result<size_t> owner(const sharded_table& table, const shard_key& key) const;
+
+  // While the table moves: the key's owner on the new ring when that is another node
+  std::optional<size_t> receiver(const sharded_table& table, const shard_key& key) const;
+
+  // While the table moves: the nodes collecting its rows in their staging table
+  const std::vector<size_t>& receivers(const sharded_table& table) const;
+
+  size_t get_node_count() const;
+
+  // An INSERT ... VALUES is split into one INSERT per owning node; a SELECT, UPDATE or DELETE
+  // with `key = literal` in its WHERE conjunction runs on the owner alone and other UPDATEs and
+  // DELETEs on every node. Returns nullopt for statements that do not touch a sharded table
+  // and for reads that have to run on every node.
+  arrow::Result<std::optional<shard_route>> route(const std::string& query) const;
+
+  // The same tables over a longer node list, nothing has moved yet
+  shard_catalog with_nodes(const std::vector<std::string>& nodes) const;
+
+  // Hash-partitioned tables that are not placed on the ring of the current node list
+  std::vector<std::string> unbalanced_tables() const;
+
+  // Ranges of the table that change owner between its placement and the current ring
+  std::vector<hash_ring::range> pending_moves(const std::string& table) const;
+
+  // Starts or ends moving a table; an aborted move keeps the old placement
+  shard_catalog begin_move(const std::string& table) const;
+  shard_catalog end_move(const std::string& table, bool commit) const;
+
+  // Where the rows of a moving table are collected on their new owner
+  static std::string staging_table(const std::string& table);
+
+  // Where a batch of copied rows waits on the new owner until it is known that no write changed them
+  static std::string batch_table(const std::string& table);
+
+private:
+  struct placement {
+    sharded_table table;
+    std::shared_ptr<const hash_ring> ring;
+    // Set while the table moves to the current ring, with the nodes that receive rows
+    std::shared_ptr<const hash_ring> target;
+    std::vector<size_t> receivers;
+  };
+
+  std::unordered_map<std::string, placement> tables;
+  size_t node_count;
+  size_t vnodes;
+  std::shared_ptr<const hash_ring> ring;
+
+  shard_catalog(
+      std::unordered_map<std::string, placement> tables,
+      size_t node_count,
+      size_t vnodes,
+      std::shared_ptr<const hash_ring> ring
+  )
+      : tables(std::move(tables))
+      , node_count(node_count)
+      , vnodes(vnodes)
+      , ring(std::move(ring)) {}
+
+  const placement& get_placement(const sharded_table& table) const;
+};
+} // namespace arrow_sql_router
@@ -0,0 +1,266 @@
+#include "sql_text.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+bool is_word_char(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+std::string to_lower(std::string text) {
+  for (char& c : text) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return text;
+}
+
+std::string trim(const std::string& text) {
+  size_t begin = 0;
+  size_t end = text.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) {
+    begin++;
+  }
+  while (end > begin && (std::isspace(static_cast<unsigned char>(text[end - 1])) || text[end - 1] == ';')) {
+    end--;
+  }
+  return text.substr(begin, end - begin);
+}
+
+std::vector<sql_word> scan_words(const std::string& sql) {
+  std::vector<sql_word> words;
+  int depth = 0;
+  for (size_t i = 0; i < sql.size();) {
+    const char c = sql[i];
+    if (c == '\'' || c == '"' || c == '`' || c == '[') {
+      const char close = c == '[' ? ']' : c;
+      i = sql.find(close, i + 1);
+      i = i == std::string::npos ? sql.size() : i + 1;
+    } else if (c == '(') {
+      depth++;
+      i++;
+    } else if (c == ')') {
+      depth--;
+      i++;
+    } else if (is_word_char(c)) {
+      size_t end = i;
+      while (end < sql.size() && is_word_char(sql[end])) {
+        end++;
+      }
+      words.push_back(sql_word{to_lower(sql.substr(i, end - i)), i, end, depth});
+      i = end;
+    } else {
+      i++;
+    }
+  }
+  return words;
+}
+
+std::vector<std::string> split_top_level(const std::string& text) {
+  std::vector<std::string> parts;
+  int depth = 0;
+  size_t begin = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    const char c = text[i];
+    if (c == '\'' || c == '"' || c == '`' || c == '[') {
+      const char close = c == '[' ? ']' : c;
+      const size_t end = text.find(close, i + 1);
+      i = end == std::string::npos ? text.size() - 1 : end;
+    } else if (c == '(') {
+      depth++;
+    } else if (c == ')') {
+      depth--;
+    } else if (c == ',' && depth == 0) {
+      parts.push_back(trim(text.substr(begin, i - begin)));
+      begin = i + 1;
+    }
+  }
+  parts.push_back(trim(text.substr(begin)));
+  return parts;
+}
+
+std::string canonical(const std::string& expression) {
+  std::string result;
+  char quote = 0;
+  for (char c : expression) {
+    if (quote != 0) {
+      result.push_back(c);
+      quote = c == quote ? 0 : quote;
+      continue;
+    }
+    if (c == '\'' || c == '"' || c == '`') {
+      quote = c;
+    } else if (c == '[') {
+      quote = ']';
+    }
+    if (!std::isspace(static_cast<unsigned char>(c))) {
+      result.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+  }
+  return result;
+}
+
+std::pair<std::string, std::string> split_alias(const std::string& item) {
+  const auto words = scan_words(item);
+  for (size_t i = words.size(); i-- > 0;) {
+    if (words[i].depth == 0 && words[i].text == "as") {
+      std::string alias = trim(item.substr(words[i].end));
+      if (alias.size() >= 2 && (alias.front() == '"' || alias.front() == '`' || alias.front() == '[')) {
+        alias = alias.substr(1, alias.size() - 2);
+      }
+      return {trim(item.substr(0, words[i].begin)), alias};
+    }
+  }
+  return {item, ""};
+}
+
+std::optional<std::vector<std::string>> split_conjuncts(const std::string& condition) {
+  std::vector<std::string> conjuncts;
+  size_t begin = 0;
+  // BETWEEN x AND y is one conjunct
+  bool between = false;
+  for (const auto& word : scan_words(condition)) {
+    if (word.depth != 0) {
+      continue;
+    }
+    if (word.text == "or") {
+      return std::nullopt;
+    }
+    if (word.text == "between") {
+      between = true;
+    } else if (word.text == "and" && between) {
+      between = false;
+    } else if (word.text == "and") {
+      conjuncts.push_back(trim(condition.substr(begin, word.begin - begin)));
+      begin = word.end;
+    }
+  }
+  conjuncts.push_back(trim(condition.substr(begin)));
+  return conjuncts;
+}
+
+std::pair<size_t, size_t> identifier_span(const std::string& sql, size_t begin) {
+  begin = std::min(sql.find_first_not_of(" \t\r\n", begin), sql.size());
+  char quote = 0;
+  size_t end = begin;
+  for (; end < sql.size(); end++) {
+    const char c = sql[end];
+    if (quote != 0) {
+      quote = c == quote ? 0 : quote;
+    } else if (c == '"' || c == '`') {
+      quote = c;
+    } else if (c == '[') {
+      quote = ']';
+    } else if (std::isspace(static_cast<unsigned char>(c)) || c == '(' || c == ')' || c == ',' || c == ';') {
+      break;
+    }
+  }
+  return {begin, end};
+}
+
+std::string identifier_name(const std::string& identifier) {
+  std::string name = trim(identifier);
+  // The last dot outside quotes separates the schema
+  char quote = 0;
+  size_t last_dot = std::string::npos;
+  for (size_t i = 0; i < name.size(); i++) {
+    const char c = name[i];
+    if (quote != 0) {
+      quote = c == quote ? 0 : quote;
+    } else if (c == '"' || c == '`') {
+      quote = c;
+    } else if (c == '[') {
+      quote = ']';
+    } else if (c == '.') {
+      last_dot = i;
+    }
+  }
+  if (last_dot != std::string::npos) {
+    name = name.substr(last_dot + 1);
+  }
+  if (name.size() >= 2 && (name.front() == '"' || name.front() == '`' || name.front() == '[')) {
+    name = name.substr(1, name.size() - 2);
+  }
+  return to_lower(name);
+}
+
+std::string statement_verb(const std::string& sql) {
+  const auto words = scan_words(sql);
+  if (words.empty()) {
+    return "";
+  }
+  if (words.front().text != "with") {
+    return words.front().text;
+  }
+  for (const auto& word : words) {
+    if (word.depth == 0 && (word.text == "select" || word.text == "values" || word.text == "insert" ||
+                            word.text == "replace" || word.text == "update" || word.text == "delete")) {
+      return word.text;
+    }
+  }
+  return "";
+}
+
+bool writes_data(const std::string& sql) {
+  const std::string verb = statement_verb(sql);
+  return verb != "select" && verb != "values" && verb != "explain";
+}
+
+std::vector<std::string> table_names(const std::string& sql) {
+  static const std::vector<std::string_view> clause_ends{
+      "where", "group", "order", "limit", "having", "window", "union", "except", "intersect", "join", "inner",
+      "left", "right", "full", "cross", "natural", "on", "using", "returning", "set", "select", "values", "default"
+  };
+
+  const auto words = scan_words(sql);
+  std::vector<std::string> names;
+  auto add = [&](const std::string& text, size_t begin) {
+    const auto [name_begin, name_end] = identifier_span(text, begin);
+    // Subqueries are scanned on their own
+    if (name_begin < name_end && text[name_begin] != '(') {
+      names.push_back(identifier_name(text.substr(name_begin, name_end - name_begin)));
+    }
+  };
+  for (size_t i = 0; i < words.size(); i++) {
+    const auto& word = words[i];
+    if (word.text == "update") {
+      // UPDATE OR REPLACE t ...
+      const bool conflict = i + 2 < words.size() && words[i + 1].text == "or";
+      add(sql, conflict ? words[i + 2].end : word.end);
+    } else if (word.text == "into" || word.text == "join") {
+      add(sql, word.end);
+    } else if (word.text == "from") {
+      // A comma list runs to the next clause on its level, or out of the enclosing parentheses
+      size_t end = sql.size();
+      for (size_t j = i + 1; j < words.size(); j++) {
+        const bool clause_end = std::find(clause_ends.begin(), clause_ends.end(), words[j].text) != clause_ends.end();
+        if (words[j].depth < word.depth || (words[j].depth == word.depth && clause_end)) {
+          end = words[j].begin;
+          break;
+        }
+      }
+      for (const auto& item : split_top_level(sql.substr(word.end, end - word.end))) {
+        add(item, 0);
+      }
+    }
+  }
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  return names;
+}
+
+std::string quote_name(const std::string& name) {
+  std::string quoted = "\"";
+  for (char c : name) {
+    quoted += c == '"' ? "\"\"" : std::string(1, c);
+  }
+  return quoted + "\"";
+}
+
+std::string quote_literal(const std::string& text) {
+  std::string quoted = "'";
+  for (char c : text) {
+    quoted += c == '\'' ? "''" : std::string(1, c);
+  }
+  return quoted + "'";
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough SQL lexing for the router to recognize the statements it rewrites or routes.
+// Quoted identifiers and string literals are skipped, nesting depth counts parentheses.
+
+struct sql_word {
+  std::string text;
+  size_t begin;
+  size_t end;
+  int depth;
+};
+
+std::string to_lower(std::string text);
+
+// Strips surrounding whitespace and trailing semicolons
+std::string trim(const std::string& text);
+
+// Lower-cased unquoted words with their nesting depth; quoted identifiers and literals are skipped
+std::vector<sql_word> scan_words(const std::string& sql);
+
+// Splits on commas outside parentheses and quotes
+std::vector<std::string> split_top_level(const std::string& text);
+
+// Whitespace- and case-insensitive form of an expression, used to match select items against GROUP BY keys
+std::string canonical(const std::string& expression);
+
+// Splits "expr AS alias" into its parts, the alias is empty when there is none
+std::pair<std::string, std::string> split_alias(const std::string& item);
+
+// Parts of an AND chain outside parentheses; nullopt when an OR joins them
+std::optional<std::vector<std::string>> split_conjuncts(const std::string& condition);
+
+// [begin, end) of the possibly quoted identifier that starts at or after `begin`
+std::pair<size_t, size_t> identifier_span(const std::string& sql, size_t begin);
+
+// Lower-cased name of a possibly quoted identifier, with any schema qualifier dropped
+std::string identifier_name(const std::string& identifier);
+
+// First word of a statement, or the verb of its main statement after a WITH clause
+std::string statement_verb(const std::string& sql);
+
+// Anything but SELECT, VALUES and EXPLAIN
+bool writes_data(const std::string& sql);
+
+// Lower-cased names of the tables a statement reads or writes: FROM lists, JOIN, INSERT INTO and
+// UPDATE targets, at any nesting depth. Common table expressions are reported like tables.
+std::vector<std::string> table_names(const std::string& sql);
+
+// Double-quoted identifier, embedded quotes doubled
+std::string quote_name(const std::string& name);
+
+// Single-quoted string literal, embedded quotes doubled
+std::string quote_literal(const std::string& text);
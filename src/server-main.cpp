@@ -9,7 +9,19 @@ int main(int argc, char** argv) {
       ("help", "produce help message")
       ("hostname,H", po::value<std::string>()->default_value(""), "Server hostname (env: SQLFLITE_HOSTNAME)")
       ("port,R", po::value<int>()->default_value(DEFAULT_FLIGHT_PORT), "Server port")
-      ("database-filename,D", po::value<std::string>()->default_value(""), "Path to database file");
+      ("database-filename,D", po::value<std::string>()->default_value(""), "Path to database file")
+      ("pool-size,P", po::value<size_t>()->default_value(arrow_sql_bridge::server_options().pool_size), "Number of pooled SQLite connections")
+      ("prefetch-depth", po::value<size_t>()->default_value(arrow_sql_bridge::server_options().prefetch_depth), "Result batches read ahead of the client, 0 disables prefetching")
+      ("batch-max-rows", po::value<int64_t>()->default_value(arrow_sql_bridge::batch_limits().max_rows), "Rows per result batch")
+      ("batch-target-bytes", po::value<int64_t>()->default_value(arrow_sql_bridge::batch_limits().target_bytes), "Bytes of values per result batch")
+      ("batch-first-rows", po::value<int64_t>()->default_value(arrow_sql_bridge::batch_limits().first_batch_rows), "Rows of the first result batch, 0 cuts it like the others")
+      ("memory-pool", po::value<std::string>()->default_value(""), "Allocator for query results: system, jemalloc or mimalloc")
+      ("query-memory-limit", po::value<int64_t>()->default_value(0), "Bytes one query may hold, 0 is unlimited")
+      ("connection-memory-limit", po::value<int64_t>()->default_value(0), "Bytes the queries of one client connection may hold, 0 is unlimited")
+      ("server-memory-limit", po::value<int64_t>()->default_value(0), "Bytes all queries may hold, 0 is unlimited")
+      ("memory-wait", po::value<int64_t>()->default_value(arrow_sql_bridge::server_options().memory_wait.count()), "Milliseconds a query over the server's memory limit waits for memory to be freed")
+      ("type-narrowing", po::value<std::string>()->default_value("none"), "Result column types: none, declared or sampled")
+      ("type-sample-rows", po::value<size_t>()->default_value(arrow_sql_bridge::type_inference().sample_rows), "Rows sampled for dictionary encoding");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -24,5 +36,28 @@ int main(int argc, char** argv) {
   std::string hostname = vm["hostname"].as<std::string>();
   int port = vm["port"].as<int>();
 
-  return run_flight_sql_server(database_filename, hostname, port);
+  arrow_sql_bridge::server_options server_options;
+  server_options.pool_size = vm["pool-size"].as<size_t>();
+  server_options.prefetch_depth = vm["prefetch-depth"].as<size_t>();
+  server_options.batch.max_rows = vm["batch-max-rows"].as<int64_t>();
+  server_options.batch.target_bytes = vm["batch-target-bytes"].as<int64_t>();
+  server_options.batch.first_batch_rows = vm["batch-first-rows"].as<int64_t>();
+  server_options.memory_pool = vm["memory-pool"].as<std::string>();
+  server_options.query_memory_limit = vm["query-memory-limit"].as<int64_t>();
+  server_options.connection_memory_limit = vm["connection-memory-limit"].as<int64_t>();
+  server_options.server_memory_limit = vm["server-memory-limit"].as<int64_t>();
+  server_options.memory_wait = std::chrono::milliseconds(vm["memory-wait"].as<int64_t>());
+  server_options.types.sample_rows = vm["type-sample-rows"].as<size_t>();
+
+  const std::string narrowing = vm["type-narrowing"].as<std::string>();
+  if (narrowing == "declared") {
+    server_options.types.narrowing = arrow_sql_bridge::type_narrowing::declared;
+  } else if (narrowing == "sampled") {
+    server_options.types.narrowing = arrow_sql_bridge::type_narrowing::sampled;
+  } else if (narrowing != "none") {
+    std::cerr << "Unknown type narrowing " << narrowing << ", expected none, declared or sampled" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return run_flight_sql_server(database_filename, hostname, port, server_options);
 }
@@ -9,7 +9,12 @@ std::string get_env_or_default(const std::string& var_name, const std::string& d
 }
 
 arrow::Result<std::shared_ptr<flight::sql::FlightSqlServerBase>>
-build_server(const fs::path& database_filename, const std::string& hostname, int port) {
+build_server(
+    const fs::path& database_filename,
+    const std::string& hostname,
+    int port,
+    const arrow_sql_bridge::server_options& server_options
+) {
   ARROW_ASSIGN_OR_RAISE(auto location, flight::Location::ForGrpcTcp(hostname, port));
 
   std::cout << "Apache Arrow version: " << ARROW_VERSION_STRING << std::endl;
@@ -18,9 +23,10 @@ build_server(const fs::path& database_filename, const std::string& hostname, int
   options.auth_handler = std::make_unique<flight::NoOpAuthHandler>();
 
   std::shared_ptr<arrow_sql_bridge::flight_sql_server> sqlite_server;
-  ARROW_ASSIGN_OR_RAISE(sqlite_server, arrow_sql_bridge::flight_sql_server::make(database_filename));
+  ARROW_ASSIGN_OR_RAISE(sqlite_server, arrow_sql_bridge::flight_sql_server::make(database_filename, server_options));
 
   std::cout << "Using database file: " << database_filename << std::endl;
+  std::cout << "Connection pool size: " << server_options.pool_size << std::endl;
 
   ARROW_CHECK_OK(sqlite_server->Init(options));
   ARROW_CHECK_OK(sqlite_server->SetShutdownOnSignals({SIGTERM}));
@@ -31,7 +37,12 @@ build_server(const fs::path& database_filename, const std::string& hostname, int
 }
 
 arrow::Result<std::shared_ptr<flight::sql::FlightSqlServerBase>>
-create_server(fs::path& database_filename, std::string hostname, int port) {
+create_server(
+    fs::path& database_filename,
+    std::string hostname,
+    int port,
+    const arrow_sql_bridge::server_options& server_options
+) {
   if (database_filename.empty()) {
     return arrow::Status::Invalid("The database filename was not provided!");
   }
@@ -41,11 +52,16 @@ create_server(fs::path& database_filename, std::string hostname, int port) {
     hostname = get_env_or_default(ENV_HOSTNAME_VAR, DEFAULT_HOSTNAME);
   }
 
-  return build_server(database_filename, hostname, port);
+  return build_server(database_filename, hostname, port, server_options);
 }
 
-int run_server(fs::path& database_filename, std::string hostname, int port) {
-  auto server_result = create_server(database_filename, hostname, port);
+int run_server(
+    fs::path& database_filename,
+    std::string hostname,
+    int port,
+    const arrow_sql_bridge::server_options& server_options
+) {
+  auto server_result = create_server(database_filename, hostname, port, server_options);
 
   if (server_result.ok()) {
     auto server = server_result.ValueOrDie();
@@ -58,7 +74,12 @@ int run_server(fs::path& database_filename, std::string hostname, int port) {
   }
 }
 
-int run_flight_sql_server(const std::string& db_filename, const std::string& hostname, int port) {
+int run_flight_sql_server(
+    const std::string& db_filename,
+    const std::string& hostname,
+    int port,
+    const arrow_sql_bridge::server_options& server_options
+) {
   fs::path database_filename = db_filename;
-  return run_server(database_filename, hostname, port);
+  return run_server(database_filename, hostname, port, server_options);
 }
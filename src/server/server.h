@@ -14,6 +14,16 @@ const std::string DEFAULT_HOSTNAME = "0.0.0.0";
 const std::string ENV_HOSTNAME_VAR = "HOSTNAME";
 
 arrow::Result<std::shared_ptr<arrow::flight::sql::FlightSqlServerBase>>
-create_server(std::filesystem::path& database_filename, std::string hostname, int port);
+create_server(
+    std::filesystem::path& database_filename,
+    std::string hostname,
+    int port,
+    const arrow_sql_bridge::server_options& server_options = arrow_sql_bridge::server_options()
+);
 
-int run_flight_sql_server(const std::string& db_filename, const std::string& hostname, int port);
\ No newline at end of file
+int run_flight_sql_server(
+    const std::string& db_filename,
+    const std::string& hostname,
+    int port,
+    const arrow_sql_bridge::server_options& server_options = arrow_sql_bridge::server_options()
+);
@@ -1,12 +1,16 @@
 #include "../src/client/client.h"
+#include "../src/client/result_stream_reader.h"
 #include "../src/router/router.h"
 #include "../src/server/server.h"
 #include "test_ultis.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdio>
 #include <iostream>
+#include <map>
+#include <set>
 #include <thread>
 
 namespace fs = std::filesystem;
@@ -49,13 +53,13 @@ protected:
     }
   }
 
-  void setup_router(uint8_t receiver) {
+  void setup_router(uint8_t receiver, const arrow_sql_router::router_options& options = {}) {
     std::list<arrow::flight::Location> nodes{
         flight::Location::ForGrpcTcp(hostname, port_n1).ValueOrDie(),
         flight::Location::ForGrpcTcp(hostname, port_n2).ValueOrDie()
     };
 
-    auto proxy = create_router(hostname, port_router, nodes, receiver);
+    auto proxy = create_router(hostname, port_router, nodes, receiver, options);
 
     if (!proxy.ok()) {
       std::cerr << "Failed to create test proxy: " << proxy.status().ToString() << std::endl;
@@ -146,3 +150,633 @@ TEST_F(RouterTest, RoutingResults) {
   verify_column<int64_t>(table, 0, {1, 2});
   verify_string_column(table, 1, {"M3132", "M3435"});
 }
+
+TEST_F(RouterTest, ProxiedResults) {
+  setup_router(1);
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3435');", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto result = execute("select * from Groups;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+
+  auto table = result.ValueOrDie();
+  ASSERT_EQ(table->num_rows(), 2);
+  verify_column<int64_t>(table, 0, {1, 2});
+  verify_string_column(table, 1, {"M3132", "M3435"});
+}
+
+TEST_F(RouterTest, DirectEndpoints) {
+  arrow_sql_router::router_options options;
+  options.direct_endpoints = true;
+  setup_router(1, options);
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3435');", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  auto info = client.Execute(flight::FlightCallOptions(), "select * from Groups;");
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  const auto node = flight::Location::ForGrpcTcp(hostname, port_n2).ValueOrDie();
+  for (const auto& endpoint : info.ValueOrDie()->endpoints()) {
+    ASSERT_EQ(endpoint.locations, std::vector<flight::Location>{node}) << "Results should be fetched from the node";
+  }
+
+  auto result = execute("select * from Groups;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {1, 2});
+  verify_string_column(result.ValueOrDie(), 1, {"M3132", "M3435"});
+}
+
+TEST_F(RouterTest, SchemaPassthrough) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  setup_router(0, options);
+  auto sql_router = std::dynamic_pointer_cast<arrow_sql_router::flight_sql_router>(router);
+  ASSERT_NE(sql_router, nullptr);
+
+  for (int port : {port_n1, port_n2}) {
+    auto status = execute("create table Students (id int, name char(10), score int);", port);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  }
+
+  const std::string query = "select name, score from Students order by score desc limit 3;";
+  for (int i = 0; i < 2; i++) {
+    auto schema = get_sql_query_schema(hostname, port_router, query);
+    ASSERT_TRUE(schema.ok()) << "Schema request failed: " << schema.status().ToString();
+    ASSERT_EQ(schema.ValueOrDie()->num_fields(), 2);
+    ASSERT_EQ(schema.ValueOrDie()->field(0)->name(), "name");
+    ASSERT_EQ(schema.ValueOrDie()->field(1)->type()->id(), arrow::Type::INT64);
+  }
+  auto stats = sql_router->get_schema_cache_stats();
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.hits, 1);
+
+  // The schema matches what the query returns
+  auto info_schema = execute(query, port_router);
+  ASSERT_TRUE(info_schema.ok()) << "Query execution failed: " << info_schema.status().ToString();
+  ASSERT_TRUE(info_schema.ValueOrDie()->schema()->Equals(*get_sql_query_schema(hostname, port_router, query)));
+
+  auto schema = get_sql_query_schema(hostname, port_router, "select * from Students;");
+  ASSERT_TRUE(schema.ok()) << "Schema request failed: " << schema.status().ToString();
+  ASSERT_EQ(schema.ValueOrDie()->num_fields(), 3);
+
+  // Table definitions changed through the router drop the cached schemas
+  auto status = execute("alter table Students add column grade int;", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  schema = get_sql_query_schema(hostname, port_router, "select * from Students;");
+  ASSERT_TRUE(schema.ok()) << "Schema request failed: " << schema.status().ToString();
+  ASSERT_EQ(schema.ValueOrDie()->num_fields(), 4);
+  ASSERT_EQ(sql_router->get_schema_cache_stats().invalidations, 1);
+}
+
+TEST_F(RouterTest, ResultCache) {
+  arrow_sql_router::router_options options;
+  options.result_cache_bytes = 1 << 20;
+  setup_router(1, options);
+  auto sql_router = std::dynamic_pointer_cast<arrow_sql_router::flight_sql_router>(router);
+  ASSERT_NE(sql_router, nullptr);
+
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3435');", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  for (int i = 0; i < 2; i++) {
+    auto result = execute("select * from Groups order by group_id;", port_router);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    verify_column<int64_t>(result.ValueOrDie(), 0, {1, 2});
+    verify_string_column(result.ValueOrDie(), 1, {"M3132", "M3435"});
+  }
+  auto stats = sql_router->get_result_cache_stats();
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.entries, 1);
+  ASSERT_GT(stats.bytes, 0);
+
+  // A write through the router drops the results that read its table
+  status = execute("insert into Groups values (3, 'M3236');", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  ASSERT_EQ(sql_router->get_result_cache_stats().invalidations, 1);
+
+  auto result = execute("select * from Groups order by group_id;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {1, 2, 3});
+  ASSERT_EQ(sql_router->get_result_cache_stats().misses, 2);
+
+  // Queries whose result changes without a write are never cached
+  for (int i = 0; i < 2; i++) {
+    result = execute("select group_id, random() from Groups;", port_router);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  }
+  ASSERT_EQ(sql_router->get_result_cache_stats().hits, 1);
+}
+
+TEST_F(RouterTest, ReplicaGroups) {
+  std::atomic<bool> running_n3(false);
+  std::thread n3_thread;
+  std::shared_ptr<flight::sql::FlightSqlServerBase> n3;
+  const int port_n3 = 31340;
+  const fs::path db_path3 = "test.db_path3";
+  setup_node(db_path3, port_n3, n3, n3_thread, running_n3);
+
+  arrow_sql_router::router_options options;
+  options.replicas = {{}, {flight::Location::ForGrpcTcp(hostname, port_n3).ValueOrDie()}};
+  setup_router(1, options);
+
+  // Writes through the router reach the node and its replica
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3435');", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  for (int port : {port_n2, port_n3}) {
+    auto result = execute("select * from Groups order by group_id;", port);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    verify_column<int64_t>(result.ValueOrDie(), 0, {1, 2});
+  }
+
+  // A row only the replica has shows which member answered a read
+  status = execute("insert into Groups values (3, 'M3236');", port_n3);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  std::set<int64_t> row_counts;
+  for (int i = 0; i < 8; i++) {
+    auto result = execute("select * from Groups;", port_router);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    row_counts.insert(result.ValueOrDie()->num_rows());
+  }
+  ASSERT_EQ(row_counts, (std::set<int64_t>{2, 3})) << "Reads should be spread over the replica group";
+
+  // A write only the node applies leaves the replica out of reads until it is resynced
+  status = execute("create unique index Groups_id on Groups (group_id);", port_n3);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (3, 'M3237'), (4, 'M3238');", port_router);
+  ASSERT_FALSE(status.ok());
+  ASSERT_NE(status.status().message().find("applied on"), std::string::npos) << status.status().ToString();
+  auto sql_router = std::dynamic_pointer_cast<arrow_sql_router::flight_sql_router>(router);
+  auto replica = flight::Location::ForGrpcTcp(hostname, port_n3).ValueOrDie();
+  for (const auto& stats : sql_router->get_replica_stats()) {
+    ASSERT_EQ(stats.stale, stats.location == replica);
+  }
+  row_counts.clear();
+  for (int i = 0; i < 8; i++) {
+    auto result = execute("select * from Groups;", port_router);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    row_counts.insert(result.ValueOrDie()->num_rows());
+  }
+  ASSERT_EQ(row_counts, (std::set<int64_t>{4})) << "Reads should skip the stale replica";
+
+  ASSERT_TRUE(sql_router->mark_replica_resynced(replica).ok());
+  row_counts.clear();
+  for (int i = 0; i < 8; i++) {
+    auto result = execute("select * from Groups;", port_router);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    row_counts.insert(result.ValueOrDie()->num_rows());
+  }
+  ASSERT_EQ(row_counts, (std::set<int64_t>{3, 4}));
+
+  teardown_node(db_path3, n3, n3_thread, running_n3);
+}
+
+TEST_F(RouterTest, ScatterGatherResults) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  setup_router(0, options);
+
+  for (int port : {port_n1, port_n2}) {
+    auto status = execute("create table Groups (group_id int, group_no char(6));", port);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  }
+  auto status = execute("insert into Groups values (1, 'M3132');", port_n1);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (2, 'M3435'), (3, 'M3436');", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  auto info = client.Execute(flight::FlightCallOptions(), "select * from Groups;");
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  ASSERT_EQ(info.ValueOrDie()->endpoints().size(), 2);
+  for (const auto& endpoint : info.ValueOrDie()->endpoints()) {
+    ASSERT_EQ(endpoint.locations.size(), 1) << "Every shard should point at its node";
+  }
+
+  auto result = execute("select * from Groups;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  auto table = result.ValueOrDie()->CombineChunks().ValueOrDie();
+  ASSERT_EQ(table->num_rows(), 3);
+
+  // Shards are fetched concurrently and the result is unordered
+  auto ids = std::static_pointer_cast<arrow::Int64Array>(table->column(0)->chunk(0));
+  std::vector<int64_t> sorted_ids(ids->raw_values(), ids->raw_values() + ids->length());
+  std::sort(sorted_ids.begin(), sorted_ids.end());
+  ASSERT_EQ(sorted_ids, std::vector<int64_t>({1, 2, 3}));
+}
+
+// The scatter result of two shards, the first much longer than the second, remade with the given
+// endpoints and order
+class ScatterFetchTest : public RouterTest {
+protected:
+  std::shared_ptr<client_pool> pool;
+  flight::Location router_location;
+  std::shared_ptr<flight::sql::FlightSqlClient> client;
+
+  void SetUp() override {
+    RouterTest::SetUp();
+    arrow_sql_router::router_options options;
+    options.mode = arrow_sql_router::execution_mode::scatter;
+    setup_router(0, options);
+
+    for (int port : {port_n1, port_n2}) {
+      auto status = execute("create table Numbers (n int);", port);
+      ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+    }
+    auto status = execute(
+        "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 20000) "
+        "insert into Numbers select x from seq;",
+        port_n1
+    );
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+    status = execute("insert into Numbers values (100001), (100002), (100003);", port_n2);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+    pool = client_pool::make().ValueOrDie();
+    router_location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+    client = pool->get(router_location).ValueOrDie();
+  }
+
+  arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> fetch(
+      std::vector<flight::FlightEndpoint> extra_endpoints,
+      bool ordered,
+      const client_options& options
+  ) {
+    ARROW_ASSIGN_OR_RAISE(auto info, client->Execute(flight::FlightCallOptions(), "select n from Numbers order by n;"));
+    ARROW_ASSIGN_OR_RAISE(auto schema, info->GetSchema(nullptr));
+    auto endpoints = info->endpoints();
+    endpoints.insert(endpoints.end(), extra_endpoints.begin(), extra_endpoints.end());
+    ARROW_ASSIGN_OR_RAISE(
+        auto remade,
+        flight::FlightInfo::Make(*schema, info->descriptor(), endpoints, -1, -1, ordered)
+    );
+    auto clients = std::make_unique<endpoint_clients>(pool, router_location, client);
+    return result_stream_reader::make(
+        std::move(clients),
+        std::make_unique<flight::FlightInfo>(std::move(remade)),
+        options
+    );
+  }
+};
+
+TEST_F(ScatterFetchTest, OrderedEndpointsKeepTheirOrder) {
+  client_options options;
+  options.max_parallel_fetches = 2;
+  options.batch_max_rows = 500;
+  auto reader = fetch({}, true, options);
+  ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+
+  // The short second shard is done long before the first, its rows still come last
+  std::vector<int64_t> values;
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    auto status = reader.ValueOrDie()->ReadNext(&batch);
+    ASSERT_TRUE(status.ok()) << status.ToString();
+    if (!batch) {
+      break;
+    }
+    auto numbers = std::static_pointer_cast<arrow::Int64Array>(batch->column(0));
+    values.insert(values.end(), numbers->raw_values(), numbers->raw_values() + numbers->length());
+  }
+  ASSERT_EQ(values.size(), 20003);
+  ASSERT_TRUE(std::is_sorted(values.begin(), values.end())) << "Batches should keep endpoint order";
+}
+
+TEST_F(ScatterFetchTest, FailingEndpointStopsTheFetch) {
+  client_options options;
+  options.max_parallel_fetches = 2;
+  options.max_buffered_batches = 1;
+  options.batch_max_rows = 100;
+  flight::FlightEndpoint broken{
+      flight::Ticket{"no such ticket"},
+      {flight::Location::ForGrpcTcp(hostname, port_n2).ValueOrDie()},
+      std::nullopt,
+      ""
+  };
+  for (bool ordered : {false, true}) {
+    auto reader = fetch({broken}, ordered, options);
+    ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+
+    // The first shard fills its queue and waits, the broken endpoint has to end the read
+    auto table = reader.ValueOrDie()->ToTable();
+    ASSERT_FALSE(table.ok()) << "A failed endpoint should fail the result, not leave it partial";
+    ASSERT_TRUE(reader.ValueOrDie()->Close().ok());
+  }
+
+  // The pooled clients are still usable
+  auto result = execute_sql_query(pool, router_location, "select n from Numbers where n > 100000;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 3);
+}
+
+TEST_F(RouterTest, ScatterGatherSchemaMismatch) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  setup_router(0, options);
+
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_n1);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("create table Groups (group_id int, group_size int);", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto result = execute("select * from Groups;", port_router);
+  ASSERT_FALSE(result.ok()) << "Inconsistent shard schemas should be rejected";
+}
+
+TEST_F(RouterTest, ScatterWritesRunOnce) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  setup_router(0, options);
+
+  // The table is created on every node, its rows land on the receiver only
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3435');", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto result = execute("select count(*) from Groups;", port_n1);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {2});
+  result = execute("select count(*) from Groups;", port_n2);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {0});
+
+  result = execute("select * from Groups;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 2) << "Every inserted row should be read back once";
+}
+
+TEST_F(RouterTest, AggregatePushdown) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  setup_router(0, options);
+
+  for (int port : {port_n1, port_n2}) {
+    auto status = execute("create table Students (id int, group_no char(6), score int);", port);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  }
+  auto status = execute("insert into Students values (1, 'M3132', 4), (2, 'M3435', 5), (3, 'M3132', 3);", port_n1);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Students values (4, 'M3132', 5), (5, 'M3435', 2);", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  auto info = client.Execute(flight::FlightCallOptions(), "select count(*), sum(score), max(id) from Students;");
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  ASSERT_EQ(info.ValueOrDie()->endpoints().size(), 1) << "Merged result should be served by the router";
+  ASSERT_TRUE(info.ValueOrDie()->endpoints()[0].locations.empty());
+
+  auto result = execute("select count(*), sum(score), max(id) from Students;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {5});
+  verify_column<int64_t>(result.ValueOrDie(), 1, {19});
+  verify_column<int64_t>(result.ValueOrDie(), 2, {5});
+
+  result = execute("select group_no, avg(score) as average from Students group by group_no;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  auto table = result.ValueOrDie()->CombineChunks().ValueOrDie();
+  ASSERT_EQ(table->num_rows(), 2);
+  ASSERT_EQ(table->schema()->field(1)->name(), "average");
+
+  auto groups = std::static_pointer_cast<arrow::StringArray>(table->column(0)->chunk(0));
+  auto averages = std::static_pointer_cast<arrow::DoubleArray>(table->column(1)->chunk(0));
+  for (int64_t i = 0; i < table->num_rows(); i++) {
+    const double expected = groups->GetString(i) == "M3132" ? 4.0 : 3.5;
+    ASSERT_DOUBLE_EQ(averages->Value(i), expected) << "Wrong average for " << groups->GetString(i);
+  }
+}
+
+TEST_F(RouterTest, OrderedLimitMerge) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  setup_router(0, options);
+
+  for (int port : {port_n1, port_n2}) {
+    auto status = execute("create table Students (id int, name char(10), score int);", port);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  }
+  auto status = execute(
+      "insert into Students values (1, 'Ann', 70), (2, 'Bob', 95), (3, 'Cid', 80), (4, 'Dan', 60);",
+      port_n1
+  );
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Students values (5, 'Eve', 90), (6, 'Fay', 80), (7, 'Gus', 85);", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  const std::string query = "select name from Students order by score desc, id limit 4;";
+  auto location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  auto info = client.Execute(flight::FlightCallOptions(), query);
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  ASSERT_EQ(info.ValueOrDie()->endpoints().size(), 1) << "Merged result should be served by the router";
+  ASSERT_TRUE(info.ValueOrDie()->ordered());
+
+  auto result = execute(query, port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  // The sort key is not selected, it travels as a hidden column and is dropped
+  ASSERT_EQ(result.ValueOrDie()->num_columns(), 1);
+  verify_string_column(result.ValueOrDie(), 0, {"Bob", "Eve", "Gus", "Cid"});
+
+  result = execute("select id, score from Students order by 2, id limit 2 offset 2;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {3, 6});
+}
+
+TEST_F(RouterTest, DistributedJoin) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::scatter;
+  // Every build batch exceeds the budget, so the join goes through the spill partitions
+  options.join_memory_budget = 0;
+  options.join_spill_partitions = 3;
+  setup_router(0, options);
+
+  for (int port : {port_n1, port_n2}) {
+    auto status = execute("create table Students (id int, group_id int, name char(10));", port);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+    status = execute("create table Groups (group_id int, group_no char(6));", port);
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  }
+  // Most students live on another node than their group
+  auto status = execute("insert into Students values (1, 1, 'Ann'), (2, 2, 'Bob'), (3, 3, 'Cid');", port_n1);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Students values (4, 1, 'Dan'), (5, 3, 'Eve');", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132');", port_n1);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (2, 'M3435'), (3, 'M3436');", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  const std::string query = "select s.id, g.group_no as grp from Students s join Groups g on s.group_id = g.group_id "
+                            "where s.id > 1;";
+  auto location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  auto info = client.Execute(flight::FlightCallOptions(), query);
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  ASSERT_EQ(info.ValueOrDie()->endpoints().size(), 1) << "Joined result should be served by the router";
+
+  auto result = execute(query, port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  auto table = result.ValueOrDie()->CombineChunks().ValueOrDie();
+  ASSERT_EQ(table->num_rows(), 4);
+  ASSERT_EQ(table->schema()->field(1)->name(), "grp");
+
+  auto ids = std::static_pointer_cast<arrow::Int64Array>(table->column(0)->chunk(0));
+  auto groups = std::static_pointer_cast<arrow::StringArray>(table->column(1)->chunk(0));
+  std::map<int64_t, std::string> rows;
+  for (int64_t i = 0; i < table->num_rows(); i++) {
+    rows[ids->Value(i)] = groups->GetString(i);
+  }
+  ASSERT_EQ(rows, (std::map<int64_t, std::string>{{2, "M3435"}, {3, "M3436"}, {4, "M3132"}, {5, "M3436"}}));
+}
+
+TEST_F(RouterTest, ConcurrentProxiedQueries) {
+  arrow_sql_router::router_options options;
+  options.channels_per_node = 2;
+  setup_router(1, options);
+
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3435');", port_n2);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  std::vector<std::thread> threads;
+  std::atomic<int> failures = 0;
+  for (int i = 0; i < 16; i++) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 25; j++) {
+        auto result = execute("select * from Groups;", port_router);
+        if (!result.ok() || result.ValueOrDie()->num_rows() != 2) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(failures, 0);
+}
+
+TEST_F(RouterTest, ShardedRouting) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::sharded;
+  options.sharded_tables = {{"Groups", "group_id", arrow_sql_router::partitioning::hash, {}}};
+  setup_router(0, options);
+
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  std::string insert = "insert into Groups (group_id, group_no) values ";
+  for (int i = 1; i <= 20; i++) {
+    insert += (i == 1 ? "(" : ", (") + std::to_string(i) + ", 'M" + std::to_string(3100 + i) + "')";
+  }
+  status = execute(insert + ";", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  // Every row lives on exactly one node
+  int64_t total = 0;
+  for (int port : {port_n1, port_n2}) {
+    auto result = execute("select count(*) from Groups;", port);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    auto count = result.ValueOrDie()->column(0)->chunk(0)->GetScalar(0).ValueOrDie();
+    const int64_t rows = std::stoll(count->ToString());
+    ASSERT_GT(rows, 0) << "Rows should be spread over both nodes";
+    total += rows;
+  }
+  ASSERT_EQ(total, 20);
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port_router).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  auto info = client.Execute(flight::FlightCallOptions(), "select * from Groups where group_id = 7;");
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  ASSERT_EQ(info.ValueOrDie()->endpoints().size(), 1) << "Key lookup should go to the owning node only";
+
+  auto result = execute("select * from Groups where group_id = 7;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {7});
+  verify_string_column(result.ValueOrDie(), 1, {"M3107"});
+
+  result = execute("select * from Groups;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 20);
+}
+
+TEST_F(RouterTest, RebalanceOnNewNode) {
+  arrow_sql_router::router_options options;
+  options.mode = arrow_sql_router::execution_mode::sharded;
+  options.sharded_tables = {{"Groups", "group_id", arrow_sql_router::partitioning::hash, {}}};
+  options.rebalance_batch_rows = 16;
+  setup_router(0, options);
+
+  auto status = execute("create table Groups (group_id int, group_no char(6));", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  std::string insert = "insert into Groups (group_id, group_no) values ";
+  for (int i = 1; i <= 200; i++) {
+    insert += (i == 1 ? "(" : ", (") + std::to_string(i) + ", 'M" + std::to_string(3000 + i) + "')";
+  }
+  status = execute(insert + ";", port_router);
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  std::thread n3_thread;
+  std::shared_ptr<flight::sql::FlightSqlServerBase> n3;
+  std::atomic<bool> running_n3(false);
+  const int port_n3 = 31340;
+  const fs::path db_path3 = "test.db_path3";
+  setup_node(db_path3, port_n3, n3, n3_thread, running_n3);
+
+  auto sharded_router = std::dynamic_pointer_cast<arrow_sql_router::flight_sql_router>(router);
+  ASSERT_NE(sharded_router, nullptr);
+  auto added = sharded_router->add_node(flight::Location::ForGrpcTcp(hostname, port_n3).ValueOrDie());
+  ASSERT_TRUE(added.ok()) << added.ToString();
+
+  // Writes keep flowing while rows move
+  for (int i = 201; i <= 300; i++) {
+    status = execute(
+        "insert into Groups (group_id, group_no) values (" + std::to_string(i) + ", 'M" + std::to_string(3000 + i) +
+            "');",
+        port_router
+    );
+    ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  }
+
+  auto rebalanced = sharded_router->wait_for_rebalance();
+  ASSERT_TRUE(rebalanced.ok()) << rebalanced.ToString();
+  auto progress = sharded_router->get_rebalance_progress();
+  ASSERT_FALSE(progress.running);
+  ASSERT_EQ(progress.tables_done, 1);
+  ASSERT_EQ(progress.ranges_done, progress.ranges_total);
+  ASSERT_GT(progress.rows_moved, 0);
+
+  auto result = execute("select count(*) from Groups;", port_n3);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_GT(std::stoll(result.ValueOrDie()->column(0)->chunk(0)->GetScalar(0).ValueOrDie()->ToString()), 0);
+
+  // No row is lost or left behind twice
+  result = execute("select count(*) from Groups;", port_router);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {300});
+  for (int i = 10; i <= 300; i += 10) {
+    result = execute("select * from Groups where group_id = " + std::to_string(i) + ";", port_router);
+    ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+    ASSERT_EQ(result.ValueOrDie()->num_rows(), 1) << "Key " << i << " should be found on its new owner";
+  }
+
+  // The staging and batch tables are dropped once the move commits
+  result = execute("select count(*) from sqlite_master where name like '\\_rebalance\\_%' escape '\\';", port_n3);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {0});
+
+  teardown_node(db_path3, n3, n3_thread, running_n3);
+}
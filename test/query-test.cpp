@@ -1,3 +1,4 @@
+#include "../src/bridge/counting_pool.h"
 #include "../src/client/client.h"
 #include "../src/server/server.h"
 #include "test_ultis.h"
@@ -21,9 +22,10 @@ protected:
   std::string hostname = "localhost";
   int port = 31337;
   fs::path db_path = "test.db_path";
+  arrow_sql_bridge::server_options server_config;
 
   void SetUp() override {
-    auto server = create_server(db_path, hostname, port);
+    auto server = create_server(db_path, hostname, port, server_config);
     if (!server.ok()) {
       std::cerr << "Failed to create test server: " << server.status().ToString() << std::endl;
       return;
@@ -186,3 +188,738 @@ TEST_F(FlightSQLTest, SelectWithJoinValueTest) {
   verify_string_column(table, 0, {"Oleg", "Alexey"});
   verify_string_column(table, 1, {"Multiplexer", "Phone"});
 }
+
+TEST_F(FlightSQLTest, TicketIsSingleUseTest) {
+  auto status = execute("create table Groups (group_id int, group_no char(6));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  flight::FlightCallOptions call_options;
+
+  auto info = client.Execute(call_options, "select * from Groups;");
+  ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+  const auto& ticket = info.ValueOrDie()->endpoints()[0].ticket;
+  ASSERT_EQ(ticket.ticket.find("Groups"), std::string::npos) << "Ticket should not carry the SQL text";
+
+  auto stream = client.DoGet(call_options, ticket);
+  ASSERT_TRUE(stream.ok()) << "DoGet failed: " << stream.status().ToString();
+  ASSERT_TRUE(stream.ValueOrDie()->ToTable().ok());
+
+  auto replay = client.DoGet(call_options, ticket);
+  ASSERT_FALSE(replay.ok() && replay.ValueOrDie()->ToTable().ok()) << "Consumed ticket should not be accepted again";
+}
+
+TEST_F(FlightSQLTest, OutstandingTicketsTest) {
+  auto status = execute("create table Groups (group_id int, group_no char(6));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132');");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  flight::FlightCallOptions call_options;
+
+  // More tickets than pooled connections, none of them redeemed yet
+  std::vector<flight::Ticket> tickets;
+  const size_t outstanding = arrow_sql_bridge::server_options().pool_size + 1;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < outstanding; i++) {
+    auto info = client.Execute(call_options, "select group_no from Groups where group_id = " + std::to_string(i + 1));
+    ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+    tickets.push_back(info.ValueOrDie()->endpoints()[0].ticket);
+  }
+  ASSERT_LT(std::chrono::steady_clock::now() - start, arrow_sql_bridge::server_options().acquire_timeout)
+      << "Planning a query should not wait for the tickets before it";
+
+  for (size_t i = outstanding; i > 0; i--) {
+    auto stream = client.DoGet(call_options, tickets[i - 1]);
+    ASSERT_TRUE(stream.ok()) << "DoGet failed: " << stream.status().ToString();
+    auto table = stream.ValueOrDie()->ToTable();
+    ASSERT_TRUE(table.ok()) << table.status().ToString();
+    ASSERT_EQ(table.ValueOrDie()->num_rows(), i == 1 ? 1 : 0);
+  }
+}
+
+TEST_F(FlightSQLTest, StatementCacheReuseTest) {
+  auto status = execute("create table Groups (group_id int, group_no char(6));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto sqlite_server = std::dynamic_pointer_cast<arrow_sql_bridge::flight_sql_server>(server_ptr);
+  ASSERT_NE(sqlite_server, nullptr);
+  auto before = sqlite_server->get_statement_cache_stats();
+
+  status = execute("select * from Groups;");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("select *   from Groups");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto after = sqlite_server->get_statement_cache_stats();
+  ASSERT_EQ(after.misses - before.misses, 1) << "First execution should prepare the statement";
+  ASSERT_EQ(after.hits - before.hits, 1) << "Normalized repeat should reuse the prepared statement";
+}
+
+TEST_F(FlightSQLTest, OnePreparePerQueryTest) {
+  auto status = execute("create table Groups (group_id int, group_no char(6));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3133'), (3, 'M3134');");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto sqlite_server = std::dynamic_pointer_cast<arrow_sql_bridge::flight_sql_server>(server_ptr);
+  ASSERT_NE(sqlite_server, nullptr);
+  auto location = flight::Location::ForGrpcTcp(hostname, port).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  flight::FlightCallOptions call_options;
+
+  // All tickets are outstanding at once, so every query is planned on a connection of its own
+  const size_t queries = 3;
+  ASSERT_GT(server_config.pool_size, queries);
+  auto before = sqlite_server->get_statement_cache_stats();
+  std::vector<flight::Ticket> tickets;
+  for (size_t i = 0; i < queries; i++) {
+    auto info = client.Execute(call_options, "select group_no from Groups where group_id = " + std::to_string(i + 1));
+    ASSERT_TRUE(info.ok()) << "Query execution failed: " << info.status().ToString();
+    tickets.push_back(info.ValueOrDie()->endpoints()[0].ticket);
+  }
+
+  for (size_t i = queries; i > 0; i--) {
+    auto stream = client.DoGet(call_options, tickets[i - 1]);
+    ASSERT_TRUE(stream.ok()) << "DoGet failed: " << stream.status().ToString();
+    auto table = stream.ValueOrDie()->ToTable();
+    ASSERT_TRUE(table.ok()) << table.status().ToString();
+    ASSERT_EQ(table.ValueOrDie()->num_rows(), 1);
+  }
+
+  auto after = sqlite_server->get_statement_cache_stats();
+  ASSERT_EQ(after.misses - before.misses, queries) << "Every query should be prepared exactly once";
+  ASSERT_EQ(after.hits - before.hits, 0) << "DoGet should run the statement GetFlightInfo prepared";
+}
+
+TEST_F(FlightSQLTest, StatementCacheCommentTest) {
+  auto status = execute("create table Groups (group_id int, group_no char(6));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute("insert into Groups values (1, 'M3132'), (2, 'M3133');");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  // The comment ends at the line break, the condition after it still applies
+  auto result = execute("select group_no -- the group\nfrom Groups /* only one */ where group_id = 2;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 1);
+
+  // A comment running to the end takes the condition with it
+  result = execute("select group_no from Groups -- where group_id = 2;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 2);
+
+  ASSERT_EQ(arrow_sql_bridge::normalize_sql("select 1 -- one\n, 2 /* two */;"), "select 1 , 2");
+}
+
+TEST_F(FlightSQLTest, StatementSchemaTest) {
+  auto status = execute("create table Groups (group_id int, group_no char(6));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto schema = get_sql_query_schema(hostname, port, "select group_no, group_id from Groups;");
+  ASSERT_TRUE(schema.ok()) << "Schema request failed: " << schema.status().ToString();
+  ASSERT_EQ(schema.ValueOrDie()->num_fields(), 2);
+  ASSERT_EQ(schema.ValueOrDie()->field(0)->name(), "group_no");
+  ASSERT_EQ(schema.ValueOrDie()->field(0)->type()->id(), arrow::Type::STRING);
+  ASSERT_EQ(schema.ValueOrDie()->field(1)->type()->id(), arrow::Type::INT64);
+
+  // Planning a statement must not run it
+  schema = get_sql_query_schema(hostname, port, "insert into Groups values (1, 'M3132');");
+  ASSERT_TRUE(schema.ok()) << "Schema request failed: " << schema.status().ToString();
+  auto result = execute("select * from Groups;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 0);
+}
+
+TEST_F(FlightSQLTest, PreparedStatementParametersTest) {
+  auto status = execute("create table Employees (id int, name char(20));");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto location = flight::Location::ForGrpcTcp(hostname, port).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  flight::FlightCallOptions call_options;
+
+  auto insert = client.Prepare(call_options, "insert into Employees values (?, ?);");
+  ASSERT_TRUE(insert.ok()) << "Prepare failed: " << insert.status().ToString();
+  ASSERT_EQ(insert.ValueOrDie()->parameter_schema()->num_fields(), 2);
+
+  arrow::Int64Builder ids;
+  arrow::StringBuilder names;
+  ASSERT_TRUE(ids.AppendValues({1, 2, 3}).ok());
+  ASSERT_TRUE(names.AppendValues({"Oleg", "Alexey", "Ivan"}).ok());
+  auto parameters = arrow::RecordBatch::Make(
+      arrow::schema({arrow::field("id", arrow::int64()), arrow::field("name", arrow::utf8())}),
+      3,
+      {ids.Finish().ValueOrDie(), names.Finish().ValueOrDie()}
+  );
+  ASSERT_TRUE(insert.ValueOrDie()->SetParameters(parameters).ok());
+
+  auto inserted = insert.ValueOrDie()->ExecuteUpdate(call_options);
+  ASSERT_TRUE(inserted.ok()) << "Prepared update failed: " << inserted.status().ToString();
+  ASSERT_EQ(inserted.ValueOrDie(), 3);
+  ASSERT_TRUE(insert.ValueOrDie()->Close(call_options).ok());
+
+  auto select = client.Prepare(call_options, "select name from Employees where id = ?;");
+  ASSERT_TRUE(select.ok()) << "Prepare failed: " << select.status().ToString();
+
+  arrow::Int64Builder keys;
+  ASSERT_TRUE(keys.AppendValues({3, 1}).ok());
+  auto lookups =
+      arrow::RecordBatch::Make(arrow::schema({arrow::field("id", arrow::int64())}), 2, {keys.Finish().ValueOrDie()});
+  ASSERT_TRUE(select.ValueOrDie()->SetParameters(lookups).ok());
+
+  auto info = select.ValueOrDie()->Execute(call_options);
+  ASSERT_TRUE(info.ok()) << "Prepared query failed: " << info.status().ToString();
+  auto stream = client.DoGet(call_options, info.ValueOrDie()->endpoints()[0].ticket);
+  ASSERT_TRUE(stream.ok()) << "DoGet failed: " << stream.status().ToString();
+  auto table = stream.ValueOrDie()->ToTable();
+  ASSERT_TRUE(table.ok()) << "Reading results failed: " << table.status().ToString();
+
+  verify_string_column(table.ValueOrDie(), 0, {"Ivan", "Oleg"});
+  ASSERT_TRUE(select.ValueOrDie()->Close(call_options).ok());
+
+  // uint64 values past the range of SQLite integers fail the update instead of wrapping around
+  insert = client.Prepare(call_options, "insert into Employees (id) values (?);");
+  ASSERT_TRUE(insert.ok()) << "Prepare failed: " << insert.status().ToString();
+  arrow::UInt64Builder large_ids;
+  ASSERT_TRUE(large_ids.AppendValues({4, std::numeric_limits<uint64_t>::max()}).ok());
+  parameters = arrow::RecordBatch::Make(
+      arrow::schema({arrow::field("id", arrow::uint64())}),
+      2,
+      {large_ids.Finish().ValueOrDie()}
+  );
+  ASSERT_TRUE(insert.ValueOrDie()->SetParameters(parameters).ok());
+  ASSERT_FALSE(insert.ValueOrDie()->ExecuteUpdate(call_options).ok());
+  ASSERT_TRUE(insert.ValueOrDie()->Close(call_options).ok());
+
+  auto result = execute("select count(*) from Employees;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {3});
+}
+
+TEST_F(FlightSQLTest, BulkIngestTest) {
+  auto location = flight::Location::ForGrpcTcp(hostname, port).ValueOrDie();
+  flight::sql::FlightSqlClient client(flight::FlightClient::Connect(location).ValueOrDie());
+  flight::FlightCallOptions call_options;
+
+  arrow::Int64Builder ids;
+  arrow::StringBuilder names;
+  ASSERT_TRUE(ids.AppendValues({1, 2, 3}).ok());
+  ASSERT_TRUE(names.AppendValues({"Oleg", "Alexey", "Ivan"}).ok());
+  auto batch = arrow::RecordBatch::Make(
+      arrow::schema({arrow::field("id", arrow::int64()), arrow::field("name", arrow::utf8())}),
+      3,
+      {ids.Finish().ValueOrDie(), names.Finish().ValueOrDie()}
+  );
+
+  flight::sql::TableDefinitionOptions create;
+  create.if_not_exist = flight::sql::TableDefinitionOptionsTableNotExistOption::kCreate;
+  create.if_exists = flight::sql::TableDefinitionOptionsTableExistsOption::kFail;
+  auto reader = arrow::RecordBatchReader::Make({batch, batch}).ValueOrDie();
+  auto ingested = client.ExecuteIngest(call_options, reader, create, "Employees");
+  ASSERT_TRUE(ingested.ok()) << "Ingest failed: " << ingested.status().ToString();
+  ASSERT_EQ(ingested.ValueOrDie(), 6);
+
+  reader = arrow::RecordBatchReader::Make({batch}).ValueOrDie();
+  ASSERT_FALSE(client.ExecuteIngest(call_options, reader, create, "Employees").ok())
+      << "Existing table should be rejected with kFail";
+
+  flight::sql::TableDefinitionOptions append;
+  append.if_exists = flight::sql::TableDefinitionOptionsTableExistsOption::kAppend;
+  reader = arrow::RecordBatchReader::Make({batch}).ValueOrDie();
+  ingested = client.ExecuteIngest(call_options, reader, append, "Employees");
+  ASSERT_TRUE(ingested.ok()) << "Ingest failed: " << ingested.status().ToString();
+
+  // Appended data that does not match the table's columns is rejected before any row is written
+  arrow::Int64Builder ages;
+  ASSERT_TRUE(ages.AppendValues({40, 41, 42}).ok());
+  auto renamed = arrow::RecordBatch::Make(
+      arrow::schema({arrow::field("id", arrow::int64()), arrow::field("age", arrow::int64())}),
+      3,
+      {batch->column(0), ages.Finish().ValueOrDie()}
+  );
+  auto widened = batch->AddColumn(2, "age", renamed->column(1)).ValueOrDie();
+  for (const auto& mismatched : {renamed, widened, batch->RemoveColumn(1).ValueOrDie()}) {
+    reader = arrow::RecordBatchReader::Make({mismatched}).ValueOrDie();
+    ASSERT_FALSE(client.ExecuteIngest(call_options, reader, append, "Employees").ok())
+        << "Columns " << mismatched->schema()->ToString() << " should be rejected";
+  }
+
+  auto result = execute("select id, name from Employees where name = 'Ivan';");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  verify_column<int64_t>(result.ValueOrDie(), 0, {3, 3, 3});
+  verify_string_column(result.ValueOrDie(), 1, {"Ivan", "Ivan", "Ivan"});
+}
+
+TEST_F(FlightSQLTest, StreamingQueryTest) {
+  auto status = execute("create table Numbers (n int);");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute(
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 50000) "
+      "insert into Numbers select x from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  client_options options;
+  options.max_buffered_batches = 1;
+  auto reader = execute_sql_query_stream(hostname, port, "select n from Numbers;", options);
+  ASSERT_TRUE(reader.ok()) << "Query execution failed: " << reader.status().ToString();
+  ASSERT_EQ(reader.ValueOrDie()->schema()->num_fields(), 1);
+
+  int64_t rows = 0;
+  int64_t batches = 0;
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ASSERT_TRUE(reader.ValueOrDie()->ReadNext(&batch).ok());
+    if (!batch) {
+      break;
+    }
+    rows += batch->num_rows();
+    batches++;
+  }
+  ASSERT_EQ(rows, 50000);
+  ASSERT_GT(batches, 1) << "Result should arrive in several batches";
+}
+
+TEST_F(FlightSQLTest, BatchLimitsTest) {
+  auto status = execute("create table Documents (id int, body text);");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute(
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 5000) "
+      "insert into Documents select x, printf('%.1000c', 'a') from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  client_options options;
+  options.batch_target_bytes = 256 << 10;
+  auto wide = execute_sql_query(hostname, port, "select id, body from Documents;", false, options);
+  ASSERT_TRUE(wide.ok()) << "Query execution failed: " << wide.status().ToString();
+  ASSERT_EQ(wide.ValueOrDie()->num_rows(), 5000);
+  const auto& bodies = wide.ValueOrDie()->column(1);
+  ASSERT_GT(bodies->num_chunks(), 5) << "Wide rows should be cut by bytes";
+  for (const auto& chunk : bodies->chunks()) {
+    ASSERT_LE(chunk->length(), 1024) << "Neither the first nor any later batch should outgrow the limits";
+  }
+
+  options = client_options();
+  options.batch_max_rows = 700;
+  auto narrow = execute_sql_query(hostname, port, "select id from Documents;", false, options);
+  ASSERT_TRUE(narrow.ok()) << "Query execution failed: " << narrow.status().ToString();
+  const auto& ids = narrow.ValueOrDie()->column(0);
+  ASSERT_EQ(ids->num_chunks(), 8);
+  ASSERT_EQ(ids->chunk(0)->length(), 700);
+  ASSERT_EQ(ids->chunk(7)->length(), 100);
+
+  auto defaults = execute("select id from Documents;");
+  ASSERT_TRUE(defaults.ok()) << "Query execution failed: " << defaults.status().ToString();
+  ASSERT_EQ(defaults.ValueOrDie()->column(0)->num_chunks(), 2) << "Only the first batch should be kept short";
+  ASSERT_EQ(defaults.ValueOrDie()->column(0)->chunk(0)->length(), arrow_sql_bridge::batch_limits().first_batch_rows);
+}
+
+TEST_F(FlightSQLTest, PrefetchStatsTest) {
+  auto status = execute("create table Numbers (n int);");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute(
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 50000) "
+      "insert into Numbers select x from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto sqlite_server = std::dynamic_pointer_cast<arrow_sql_bridge::flight_sql_server>(server_ptr);
+  ASSERT_NE(sqlite_server, nullptr);
+  auto before = sqlite_server->get_prefetch_stats();
+
+  auto result = execute("select n from Numbers;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 50000);
+
+  auto after = sqlite_server->get_prefetch_stats();
+  ASSERT_EQ(after.streams - before.streams, 1);
+  ASSERT_EQ(after.batches - before.batches, result.ValueOrDie()->column(0)->num_chunks())
+      << "Every batch of the result should go through the queue";
+  ASSERT_LE(after.peak_occupancy, arrow_sql_bridge::server_options().prefetch_depth);
+}
+
+TEST(PrefetchingReaderTest, SlowConsumerStallsProducer) {
+  auto schema = arrow::schema({arrow::field("n", arrow::int64())});
+  std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+  for (int64_t i = 0; i < 8; i++) {
+    arrow::Int64Builder builder;
+    ASSERT_TRUE(builder.AppendValues({i, i, i}).ok());
+    auto array = builder.Finish();
+    ASSERT_TRUE(array.ok());
+    batches.push_back(arrow::RecordBatch::Make(schema, 3, {array.ValueOrDie()}));
+  }
+  auto source = arrow::RecordBatchReader::Make(batches, schema);
+  ASSERT_TRUE(source.ok());
+
+  auto counters = std::make_shared<arrow_sql_bridge::prefetch_counters>();
+  auto reader = arrow_sql_bridge::prefetching_reader::make(source.ValueOrDie(), 2, counters);
+  ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+
+  int64_t rows = 0;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ASSERT_TRUE(reader.ValueOrDie()->ReadNext(&batch).ok());
+    if (!batch) {
+      break;
+    }
+    rows += batch->num_rows();
+  }
+
+  auto stats = counters->stats();
+  ASSERT_EQ(rows, 24);
+  ASSERT_EQ(stats.batches, 8);
+  ASSERT_LE(stats.peak_occupancy, 2) << "The worker should not read past the queue depth";
+  ASSERT_GT(stats.producer_stall.count(), 0) << "A slow consumer should hold the worker back";
+}
+
+TEST_F(FlightSQLTest, MemoryStatsTest) {
+  auto status = execute("create table Numbers (n int);");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  status = execute(
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 50000) "
+      "insert into Numbers select x from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  auto sqlite_server = std::dynamic_pointer_cast<arrow_sql_bridge::flight_sql_server>(server_ptr);
+  ASSERT_NE(sqlite_server, nullptr);
+  auto before = sqlite_server->get_memory_stats();
+
+  auto result = execute("select n from Numbers;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+
+  auto after = sqlite_server->get_memory_stats();
+  ASSERT_GE(after.total_bytes - before.total_bytes, 50000 * 8) << "The result should be built in the tracked pool";
+  ASSERT_GE(after.peak_query_bytes, 48976 * 8);
+  ASSERT_FALSE(after.connection_bytes.empty());
+  ASSERT_EQ(after.rejections, 0);
+}
+
+TEST(MemoryTrackerTest, BudgetsRejectAndThrottle) {
+  arrow_sql_bridge::server_options options;
+  options.query_memory_limit = 1 << 20;
+  options.server_memory_limit = 2 << 20;
+  options.memory_wait = std::chrono::milliseconds(5000);
+  auto tracker = arrow_sql_bridge::memory_tracker::make(options);
+  ASSERT_TRUE(tracker.ok()) << tracker.status().ToString();
+
+  auto query = tracker.ValueOrDie()->open("peer");
+  auto small = arrow::AllocateBuffer(512 << 10, query.get());
+  ASSERT_TRUE(small.ok());
+  auto large = arrow::AllocateBuffer(768 << 10, query.get());
+  ASSERT_TRUE(large.status().IsOutOfMemory()) << "A query should not go over its own budget";
+  ASSERT_EQ(tracker.ValueOrDie()->stats().rejections, 1);
+
+  // Three queries holding the server budget: the fourth allocation waits until one of them frees
+  std::vector<std::unique_ptr<arrow::Buffer>> held;
+  auto first = tracker.ValueOrDie()->open("peer");
+  auto second = tracker.ValueOrDie()->open("other");
+  held.push_back(arrow::AllocateBuffer(768 << 10, first.get()).ValueOrDie());
+  held.push_back(arrow::AllocateBuffer(768 << 10, second.get()).ValueOrDie());
+  std::thread release([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    held.clear();
+  });
+  auto start = std::chrono::steady_clock::now();
+  auto waited = arrow::AllocateBuffer(512 << 10, tracker.ValueOrDie()->open("peer").get());
+  release.join();
+  ASSERT_TRUE(waited.ok()) << waited.status().ToString();
+  ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+
+  auto stats = tracker.ValueOrDie()->stats();
+  ASSERT_EQ(stats.bytes, 1 << 20);
+  ASSERT_EQ(stats.peak_bytes, 2 << 20);
+  ASSERT_EQ(stats.connection_bytes["peer"], 1 << 20);
+}
+
+TEST(TypeInferenceTest, DeclaredAndSampledNarrowing) {
+  const std::string create =
+      "create table Events (kind tinyint, code int, flag boolean, day date, at datetime, tag varchar(8), "
+      "note text, amount numeric);"
+      "with recursive seq(x) as (select 0 union all select x + 1 from seq where x < 99) "
+      "insert into Events select x % 5, x * 1000, x % 2, '2024-01-' || printf('%02d', x % 28 + 1), "
+      "case when x = 0 then 86400 else '2024-03-04 05:06:07.5' end, 't' || (x % 3), 'n' || x, x from seq;";
+  auto read = [&](arrow_sql_bridge::type_narrowing narrowing) -> arrow::Result<std::shared_ptr<arrow::RecordBatch>> {
+    arrow_sql_bridge::type_inference types;
+    types.narrowing = narrowing;
+    ARROW_ASSIGN_OR_RAISE(auto conn, arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE, 0, types));
+    ARROW_RETURN_NOT_OK(conn->exec(create));
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(std::move(conn), "select * from Events;"));
+    ARROW_ASSIGN_OR_RAISE(auto reader, arrow_sql_bridge::statement_batch_reader::make(statement));
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ARROW_RETURN_NOT_OK(reader->ReadNext(&batch));
+    return batch;
+  };
+
+  // Without narrowing integers stay int64 and dates stay text
+  auto plain = read(arrow_sql_bridge::type_narrowing::none);
+  ASSERT_TRUE(plain.ok()) << plain.status().ToString();
+  auto schema = plain.ValueOrDie()->schema();
+  ASSERT_EQ(schema->field(0)->type()->id(), arrow::Type::INT64);
+  ASSERT_EQ(schema->field(2)->type()->id(), arrow::Type::INT64);
+  ASSERT_EQ(schema->field(3)->type()->id(), arrow::Type::STRING);
+  ASSERT_EQ(schema->field(5)->type()->id(), arrow::Type::STRING);
+  ASSERT_EQ(schema->field(7)->type()->id(), arrow::Type::DENSE_UNION);
+
+  auto declared = read(arrow_sql_bridge::type_narrowing::declared);
+  ASSERT_TRUE(declared.ok()) << declared.status().ToString();
+  auto batch = declared.ValueOrDie();
+  ASSERT_TRUE(batch->schema()->field(0)->type()->Equals(arrow::int8()));
+  ASSERT_TRUE(batch->schema()->field(1)->type()->Equals(arrow::int64()));
+  ASSERT_TRUE(batch->schema()->field(2)->type()->Equals(arrow::boolean()));
+  ASSERT_TRUE(batch->schema()->field(3)->type()->Equals(arrow::date32()));
+  ASSERT_TRUE(batch->schema()->field(4)->type()->Equals(arrow::timestamp(arrow::TimeUnit::MICRO)));
+  ASSERT_EQ(batch->schema()->field(5)->type()->id(), arrow::Type::STRING);
+  ASSERT_EQ(batch->num_rows(), 100);
+  ASSERT_EQ(std::static_pointer_cast<arrow::Int64Array>(batch->column(1))->Value(3), 3000);
+  ASSERT_TRUE(std::static_pointer_cast<arrow::BooleanArray>(batch->column(2))->Value(1));
+  // 2024-01-02 and 2024-03-04 05:06:07.5 since the epoch, and a timestamp stored as unix seconds
+  ASSERT_EQ(std::static_pointer_cast<arrow::Date32Array>(batch->column(3))->Value(1), 19724);
+  ASSERT_EQ(std::static_pointer_cast<arrow::TimestampArray>(batch->column(4))->Value(0), 86400000000);
+  ASSERT_EQ(std::static_pointer_cast<arrow::TimestampArray>(batch->column(4))->Value(1), 1709528767500000);
+
+  // Only the text column repeating a few values is dictionary encoded
+  auto sampled = read(arrow_sql_bridge::type_narrowing::sampled);
+  ASSERT_TRUE(sampled.ok()) << sampled.status().ToString();
+  batch = sampled.ValueOrDie();
+  ASSERT_TRUE(batch->schema()->field(5)->type()->Equals(arrow::dictionary(arrow::int32(), arrow::utf8())));
+  ASSERT_EQ(batch->schema()->field(6)->type()->id(), arrow::Type::STRING);
+  ASSERT_EQ(batch->num_rows(), 100);
+  auto tags = std::static_pointer_cast<arrow::DictionaryArray>(batch->column(5));
+  ASSERT_EQ(tags->dictionary()->length(), 3);
+  ASSERT_EQ(tags->GetValueIndex(4), tags->GetValueIndex(1));
+
+  // Capped by the router, the same connection only narrows by declared types
+  arrow_sql_bridge::type_inference sampling;
+  sampling.narrowing = arrow_sql_bridge::type_narrowing::sampled;
+  auto capped_conn = arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE, 0, sampling);
+  ASSERT_TRUE(capped_conn.ok());
+  ASSERT_TRUE(capped_conn.ValueOrDie()->exec(create).ok());
+  auto capped = arrow_sql_bridge::statement::make(std::move(capped_conn.ValueOrDie()), "select * from Events;");
+  ASSERT_TRUE(capped.ok());
+  capped.ValueOrDie()->cap_type_narrowing(arrow_sql_bridge::type_narrowing::declared);
+  auto capped_schema = capped.ValueOrDie()->get_schema();
+  ASSERT_TRUE(capped_schema.ok());
+  ASSERT_EQ(capped_schema.ValueOrDie()->field(5)->type()->id(), arrow::Type::STRING);
+  ASSERT_TRUE(capped_schema.ValueOrDie()->field(0)->type()->Equals(arrow::int8()));
+
+  // SQLite does not enforce the declared type, values that do not fit fail the query instead of
+  // wrapping around. Plain INT columns are not narrowed and keep 64-bit values.
+  arrow_sql_bridge::type_inference types;
+  types.narrowing = arrow_sql_bridge::type_narrowing::declared;
+  auto conn = arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE, 0, types);
+  ASSERT_TRUE(conn.ok());
+  std::shared_ptr<arrow_sql_bridge::connection> shared_conn = std::move(conn.ValueOrDie());
+  auto created = shared_conn->exec(
+      "create table Sizes (tiny tinyint, small smallint, plain int, medium mediumint);"
+      "insert into Sizes values (1, 2, 3, 4), (1000, 2, 5000000000, 6000000000), (1, 40000, 3, 4);"
+  );
+  ASSERT_TRUE(created.ok()) << created.ToString();
+  auto read_sizes = [&](const std::string& query) -> arrow::Result<std::shared_ptr<arrow::RecordBatch>> {
+    ARROW_ASSIGN_OR_RAISE(auto statement, arrow_sql_bridge::statement::make(shared_conn, query));
+    ARROW_ASSIGN_OR_RAISE(auto reader, arrow_sql_bridge::statement_batch_reader::make(statement));
+    std::shared_ptr<arrow::RecordBatch> sizes;
+    ARROW_RETURN_NOT_OK(reader->ReadNext(&sizes));
+    return sizes;
+  };
+  ASSERT_TRUE(read_sizes("select tiny from Sizes;").status().IsInvalid());
+  ASSERT_TRUE(read_sizes("select small from Sizes;").status().IsInvalid());
+  auto wide = read_sizes("select plain, medium from Sizes;");
+  ASSERT_TRUE(wide.ok()) << wide.status().ToString();
+  ASSERT_TRUE(wide.ValueOrDie()->schema()->field(0)->type()->Equals(arrow::int64()));
+  ASSERT_TRUE(wide.ValueOrDie()->schema()->field(1)->type()->Equals(arrow::int64()));
+  ASSERT_EQ(std::static_pointer_cast<arrow::Int64Array>(wide.ValueOrDie()->column(0))->Value(1), 5000000000);
+  ASSERT_EQ(std::static_pointer_cast<arrow::Int64Array>(wide.ValueOrDie()->column(1))->Value(1), 6000000000);
+}
+
+TEST(TypeInferenceTest, DictionaryValuesCountTowardsBatchBytes) {
+  arrow_sql_bridge::type_inference types;
+  types.narrowing = arrow_sql_bridge::type_narrowing::sampled;
+  auto conn = arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE, 0, types);
+  ASSERT_TRUE(conn.ok());
+  // 256 distinct values of about 1000 bytes, repeated often enough to be dictionary encoded
+  auto status = conn.ValueOrDie()->exec(
+      "create table Notes (body text);"
+      "with recursive seq(x) as (select 0 union all select x + 1 from seq where x < 2047) "
+      "insert into Notes select (x % 256) || printf('%.1000c', 'a') from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << status.ToString();
+
+  auto statement = arrow_sql_bridge::statement::make(std::move(conn.ValueOrDie()), "select body from Notes;");
+  ASSERT_TRUE(statement.ok());
+  arrow_sql_bridge::batch_limits limits;
+  limits.target_bytes = 64 << 10;
+  auto reader = arrow_sql_bridge::statement_batch_reader::make(statement.ValueOrDie(), limits);
+  ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+  ASSERT_EQ(reader.ValueOrDie()->schema()->field(0)->type()->id(), arrow::Type::DICTIONARY);
+
+  int64_t rows = 0;
+  int64_t dictionary_length = 0;
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ASSERT_TRUE(reader.ValueOrDie()->ReadNext(&batch).ok());
+    if (!batch) {
+      break;
+    }
+    // The dictionary grows over the scan, a batch counts the values it adds
+    auto dictionary = std::static_pointer_cast<arrow::DictionaryArray>(batch->column(0))->dictionary();
+    ASSERT_LE(dictionary->length() - dictionary_length, 70)
+        << "The dictionary values should end the batch near the byte target";
+    dictionary_length = dictionary->length();
+    rows += batch->num_rows();
+  }
+  ASSERT_EQ(rows, 2048);
+  ASSERT_EQ(dictionary_length, 256);
+}
+
+TEST(TypeInferenceTest, BooleansCountTowardsBatchBytes) {
+  arrow_sql_bridge::type_inference types;
+  types.narrowing = arrow_sql_bridge::type_narrowing::declared;
+  auto conn = arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE, 0, types);
+  ASSERT_TRUE(conn.ok());
+  auto status = conn.ValueOrDie()->exec(
+      "create table Flags (flag boolean);"
+      "with recursive seq(x) as (select 0 union all select x + 1 from seq where x < 4999) "
+      "insert into Flags select x % 2 from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << status.ToString();
+
+  auto statement = arrow_sql_bridge::statement::make(std::move(conn.ValueOrDie()), "select flag from Flags;");
+  ASSERT_TRUE(statement.ok());
+  arrow_sql_bridge::batch_limits limits;
+  limits.target_bytes = 1000;
+  limits.first_batch_rows = 0;
+  auto reader = arrow_sql_bridge::statement_batch_reader::make(statement.ValueOrDie(), limits);
+  ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+  ASSERT_EQ(reader.ValueOrDie()->schema()->field(0)->type()->id(), arrow::Type::BOOL);
+
+  int64_t rows = 0;
+  while (true) {
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ASSERT_TRUE(reader.ValueOrDie()->ReadNext(&batch).ok());
+    if (!batch) {
+      break;
+    }
+    ASSERT_LE(batch->num_rows(), 1000) << "A boolean column should still be cut by the byte target";
+    rows += batch->num_rows();
+  }
+  ASSERT_EQ(rows, 5000);
+}
+
+TEST(BatchReaderTest, BuffersDoNotGrowAfterFirstBatch) {
+  std::shared_ptr<arrow_sql_bridge::connection> conn =
+      arrow_sql_bridge::connection::make("", SQLITE_OPEN_READWRITE).ValueOrDie();
+  // Steady is one width throughout, the notes of Widening get a byte longer every 2000 rows
+  auto status = conn->exec(
+      "create table Steady (id int, name text, payload blob);"
+      "create table Widening (id int, note text);"
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 50000) "
+      "insert into Steady select x, printf('name-%08d', x), randomblob(24) from seq;"
+      "with recursive seq(x) as (select 1 union all select x + 1 from seq where x < 50000) "
+      "insert into Widening select x, printf('%.*c', 10 + x / 2000, 'n') from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << status.ToString();
+
+  for (const std::string table : {"Steady", "Widening"}) {
+    auto statement = arrow_sql_bridge::statement::make(conn, "select * from " + table + ";");
+    ASSERT_TRUE(statement.ok()) << statement.status().ToString();
+    auto pool = std::make_shared<arrow_sql_bridge::counting_pool>();
+    arrow_sql_bridge::batch_limits limits;
+    limits.target_bytes = 64 * 1024;
+    limits.first_batch_rows = 0;
+    auto reader = arrow_sql_bridge::statement_batch_reader::make(statement.ValueOrDie(), limits, pool);
+    ASSERT_TRUE(reader.ok()) << reader.status().ToString();
+
+    // The first batch has nothing to size its buffers by
+    std::shared_ptr<arrow::RecordBatch> batch;
+    ASSERT_TRUE(reader.ValueOrDie()->ReadNext(&batch).ok());
+    ASSERT_NE(batch, nullptr);
+    const int64_t grows = pool->grows;
+    int64_t batches = 1;
+    while (true) {
+      ASSERT_TRUE(reader.ValueOrDie()->ReadNext(&batch).ok());
+      if (!batch) {
+        break;
+      }
+      batches++;
+    }
+    ASSERT_GT(batches, 10) << table;
+    ASSERT_EQ(pool->grows - grows, 0) << table << ": buffers reserved for a batch should hold all of it";
+  }
+}
+
+class SampledTypesTest : public FlightSQLTest {
+protected:
+  SampledTypesTest() {
+    server_config.types.narrowing = arrow_sql_bridge::type_narrowing::sampled;
+  }
+};
+
+TEST_F(SampledTypesTest, DictionaryChangesAcrossBatches) {
+  auto status = execute("create table Shifts (id int, team text);");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+  // The first batch only sees teams t0 to t2, every later one adds teams to the dictionary
+  status = execute(
+      "with recursive seq(x) as (select 0 union all select x + 1 from seq where x < 4999) "
+      "insert into Shifts select x, 't' || (x / 500) from seq;"
+  );
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  client_options options;
+  options.batch_max_rows = 700;
+  auto result = execute_sql_query(hostname, port, "select id, team from Shifts order by id;", false, options);
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  auto table = result.ValueOrDie();
+  ASSERT_EQ(table->num_rows(), 5000);
+  ASSERT_TRUE(table->schema()->field(1)->type()->Equals(arrow::dictionary(arrow::int32(), arrow::utf8())));
+  ASSERT_GT(table->column(1)->num_chunks(), 1) << "Result should arrive in several batches";
+
+  int64_t row = 0;
+  for (const auto& chunk : table->column(1)->chunks()) {
+    const auto& teams = static_cast<const arrow::DictionaryArray&>(*chunk);
+    const auto& names = static_cast<const arrow::StringArray&>(*teams.dictionary());
+    for (int64_t i = 0; i < teams.length(); i++, row++) {
+      ASSERT_EQ(names.GetString(teams.GetValueIndex(i)), "t" + std::to_string(row / 500)) << "Row " << row;
+    }
+  }
+  ASSERT_EQ(row, 5000);
+}
+
+TEST_F(FlightSQLTest, ClientPoolReuseTest) {
+  auto pool = client_pool::make();
+  ASSERT_TRUE(pool.ok()) << pool.status().ToString();
+  auto location = arrow::flight::Location::ForGrpcTcp(hostname, port);
+  ASSERT_TRUE(location.ok());
+
+  auto status = execute_sql_query(*pool, *location, "create table Items (id int);");
+  ASSERT_TRUE(status.ok()) << "Query execution failed: " << status.status().ToString();
+
+  std::vector<std::thread> threads;
+  std::atomic<int> failures = 0;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&, i] {
+      for (int j = 0; j < 10; j++) {
+        auto result = execute_sql_query(*pool, *location, "insert into Items values (" + std::to_string(i) + ");");
+        if (!result.ok()) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(failures, 0);
+
+  auto result = execute_sql_query(*pool, *location, "select count(*) from Items;");
+  ASSERT_TRUE(result.ok()) << "Query execution failed: " << result.status().ToString();
+  auto count = result.ValueOrDie()->column(0)->chunk(0)->GetScalar(0);
+  ASSERT_TRUE(count.ok());
+  ASSERT_EQ(count.ValueOrDie()->ToString(), "80");
+  ASSERT_EQ(pool.ValueOrDie()->size(), 1) << "All queries should share one client";
+}